@@ -0,0 +1,863 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+/*
+ * Random station additions and removals through wmediumd_dynamic: every
+ * link must keep the value set for its two addresses, in the writers'
+ * and the published copy, while indices stay dense.  Bulk adds and
+ * deletes go through the wserver encoding and back.  A link update batch
+ * must leave the same links as its records applied one at a time.  An
+ * async wserver connection must apply updates with acks and errors only.
+ * A request replayed from a trace must be recorded in the trace written
+ * by the replay, as one that came in on a connection is.  Then times adding stations one by one and in one bulk request.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../wmediumd/wmediumd.h"
+#include "../wmediumd/wmediumd_dynamic.h"
+#include "../wmediumd/wserver_messages.h"
+#include "../wmediumd/wserver.h"
+#include "../wmediumd/trace.h"
+#include "../wmediumd/fake_hwsim.h"
+#include "../wmediumd/replay.h"
+
+#define MAX_STAS 200
+#define STEPS 4000
+#define BULK_STAS 300
+#define BENCH_STAS 2000
+
+static struct wmediumd ctx;
+static struct shard shard;
+
+int w_flogf(struct wmediumd *ctx, u8 level, FILE *stream, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+    return 0;
+}
+
+int w_logf(struct wmediumd *ctx, u8 level, const char *format, ...)
+{
+    return 0;
+}
+
+bool timespec_before(struct timespec *t1, struct timespec *t2)
+{
+    return t1->tv_sec < t2->tv_sec ||
+           (t1->tv_sec == t2->tv_sec && t1->tv_nsec < t2->tv_nsec);
+}
+
+u64 timespec_to_ns(const struct timespec *t)
+{
+    return (u64)t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+void ns_to_timespec(u64 ns, struct timespec *t)
+{
+    t->tv_sec = ns / 1000000000ULL;
+    t->tv_nsec = ns % 1000000000ULL;
+}
+
+/* the replay only sees its requests in order, without frames or time */
+void vtime_run(struct wmediumd *ctx, struct frame_source *src,
+               const struct timespec *start)
+{
+    struct timespec when;
+
+    while (src->next(src, &when))
+        src->inject(src, ctx);
+}
+
+int vtime_queue_frame(struct wmediumd *ctx, const u8 *data, int data_len,
+                      unsigned int flags, const struct hwsim_tx_rate *tx_rates,
+                      int tx_rates_count, u64 cookie, u32 freq)
+{
+    return -ENOENT;
+}
+
+void fake_hwsim_attach(struct fake_hwsim *fh)
+{
+}
+
+void shard_move_station(struct station *station, struct shard *from,
+                        struct shard *to)
+{
+}
+
+void station_init_queues(struct station *station)
+{
+    int ac;
+
+    for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+        INIT_LIST_HEAD(&station->queues[ac].frames);
+        station->queues[ac].sched_idx = -1;
+    }
+}
+
+void station_table_update(struct wmediumd *ctx, struct station *station)
+{
+    sta_table_set(&ctx->sta_table, station);
+}
+
+struct station *get_station_by_addr(struct wmediumd *ctx, const u8 *addr)
+{
+    return addr_index_lookup(&ctx->sta_by_addr, addr);
+}
+
+int station_index_add(struct wmediumd *ctx, struct station *station)
+{
+    return addr_index_insert(&ctx->sta_by_addr, station);
+}
+
+void station_index_del(struct wmediumd *ctx, struct station *station)
+{
+    addr_index_remove(&ctx->sta_by_addr, station);
+}
+
+static int addr_id(const u8 *addr)
+{
+    return addr[4] << 8 | addr[5];
+}
+
+static int link_snr(const u8 *a, const u8 *b)
+{
+    int x = addr_id(a), y = addr_id(b);
+
+    return (x * y + x + y) % 97 - 40;
+}
+
+static void make_addr(u8 *addr, int id)
+{
+    u8 tmpl[ETH_ALEN] = { 0x02, 0, 0, 0, id >> 8, id & 0xff };
+
+    memcpy(addr, tmpl, ETH_ALEN);
+}
+
+/* set the links of the station at index to link_snr() */
+static void set_links(int index)
+{
+    const u8 *addr = ctx.sta_array[index]->addr;
+    int i;
+
+    links_write_begin(&ctx);
+    for (i = 0; i < ctx.num_stas; i++) {
+        int snr = link_snr(addr, ctx.sta_array[i]->addr);
+
+        ctx.snr_matrix[index * ctx.link_stride + i] = snr;
+        ctx.snr_matrix[i * ctx.link_stride + index] = snr;
+    }
+    links_touch_station(&ctx, index);
+    links_write_end(&ctx);
+}
+
+static int add(int id)
+{
+    u8 addr[ETH_ALEN];
+    int index;
+
+    make_addr(addr, id);
+    index = add_station(&ctx, addr);
+    if (index >= 0)
+        set_links(index);
+    return index;
+}
+
+static int check(void)
+{
+    struct link_matrices *m = links_current(&ctx.links);
+    int i, j, members = 0;
+
+    for (i = 0; i < ctx.mediums.num; i++)
+        members += ctx.mediums.mediums[i]->num_members;
+    if (members != ctx.num_stas)
+        return -1;
+
+    for (i = 0; i < ctx.num_stas; i++) {
+        struct station *sta = ctx.sta_array[i];
+
+        if (sta->index != i || get_station_by_addr(&ctx, sta->addr) != sta ||
+            ctx.sta_table.medium_id[i] != sta->medium_id)
+            return -1;
+        for (j = 0; j < ctx.num_stas; j++) {
+            int expected = link_snr(sta->addr, ctx.sta_array[j]->addr);
+            int k = i * ctx.link_stride + j;
+
+            if (i != j && (ctx.snr_matrix[k] != expected ||
+                           m->snr_matrix[k] != expected))
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Add BULK_STAS new stations plus two duplicates, then delete a third of
+ * the stations plus a missing one, both through a socketpair.
+ */
+static int bulk(int *next_id)
+{
+    u8 (*addrs)[ETH_ALEN], (*recv_addrs)[ETH_ALEN];
+    int count = BULK_STAS + 2, first = ctx.num_stas, fds[2], i, n;
+    station_bulk_request request;
+    station_bulk_response response;
+    station_bulk_add_entry *added;
+    station_bulk_del_entry *deleted;
+    i32 ids[BULK_STAS + 2];
+    int results[BULK_STAS + 2];
+    wserver_msg base;
+    int type;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        return -1;
+    addrs = calloc(count, ETH_ALEN);
+
+    for (i = 0; i < BULK_STAS; i++)
+        make_addr(addrs[i], (*next_id)++);
+    memcpy(addrs[BULK_STAS], ctx.sta_array[0]->addr, ETH_ALEN);
+    memcpy(addrs[BULK_STAS + 1], addrs[0], ETH_ALEN);
+
+    if (send_station_bulk_request(fds[0], WSERVER_BULK_ADD_REQUEST_TYPE,
+                                  (const u8 (*)[ETH_ALEN]) addrs, count) ||
+        wserver_recv_msg_base(fds[1], &base, &type) ||
+        type != WSERVER_BULK_ADD_REQUEST_TYPE ||
+        recv_station_bulk_request(fds[1], &request, &recv_addrs) ||
+        request.count != (u32) count ||
+        memcmp(recv_addrs, addrs, count * ETH_ALEN))
+        return -1;
+    free(recv_addrs);
+
+    if (add_stations(&ctx, (const u8 (*)[ETH_ALEN]) addrs, count, ids))
+        return -1;
+    for (i = 0; i < BULK_STAS; i++) {
+        if (ids[i] != first + i)
+            return -1;
+        set_links(ids[i]);
+    }
+    if (ids[BULK_STAS] != -EEXIST || ids[BULK_STAS + 1] != -EEXIST ||
+        check())
+        return -1;
+
+    added = calloc(count, sizeof(*added));
+    for (i = 0; i < count; i++) {
+        memcpy(added[i].addr, addrs[i], ETH_ALEN);
+        added[i].created_id = ids[i] < 0 ? 0 : ids[i];
+        added[i].update_result = ids[i] < 0;
+    }
+    if (send_station_bulk_add_response(fds[1], added, count) ||
+        wserver_recv_msg_base(fds[0], &base, &type) ||
+        type != WSERVER_BULK_ADD_RESPONSE_TYPE)
+        return -1;
+    free(added);
+    if (recv_station_bulk_add_response(fds[0], &response, &added) ||
+        response.count != (u32) count || added[1].created_id != first + 1 ||
+        added[BULK_STAS].update_result != 1)
+        return -1;
+    free(added);
+
+    n = ctx.num_stas / 3;
+    for (i = 0; i < n; i++)
+        memcpy(addrs[i], ctx.sta_array[i * 3]->addr, ETH_ALEN);
+    make_addr(addrs[n], 0);
+    if (del_stations_by_mac(&ctx, (const u8 (*)[ETH_ALEN]) addrs, n + 1,
+                            results) ||
+        results[n] != -ENODEV || check())
+        return -1;
+    for (i = 0; i < n; i++) {
+        if (results[i] || get_station_by_addr(&ctx, addrs[i]))
+            return -1;
+    }
+
+    deleted = calloc(n + 1, sizeof(*deleted));
+    for (i = 0; i <= n; i++) {
+        memcpy(deleted[i].addr, addrs[i], ETH_ALEN);
+        deleted[i].update_result = results[i] ? 1 : 0;
+    }
+    if (send_station_bulk_del_response(fds[1], deleted, n + 1) ||
+        wserver_recv_msg_base(fds[0], &base, &type) ||
+        type != WSERVER_BULK_DEL_RESPONSE_TYPE)
+        return -1;
+    free(deleted);
+    if (recv_station_bulk_del_response(fds[0], &response, &deleted) ||
+        response.count != (u32) n + 1 || deleted[n].update_result != 1 ||
+        memcmp(deleted[n].addr, addrs[n], ETH_ALEN))
+        return -1;
+    free(deleted);
+
+    free(addrs);
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}
+
+static int test_path_loss(void *param, struct station *a, struct station *b)
+{
+    return (int) (fabs(a->x - b->x) + fabs(a->y - b->y) + fabs(a->z - b->z));
+}
+
+static link_update_record position(const u8 *addr, double x)
+{
+    link_update_record r = { .kind = WLINK_POSITION };
+
+    memcpy(r.from_addr, addr, ETH_ALEN);
+    r.value.pos[0] = x;
+    r.value.pos[1] = x / 2;
+    r.value.pos[2] = 1;
+    return r;
+}
+
+/* snr matrix rows, restored between the batched and the stepwise run */
+static int *save_links(void)
+{
+    int *saved = malloc(sizeof(int) * ctx.num_stas * ctx.num_stas);
+    int i;
+
+    for (i = 0; i < ctx.num_stas; i++)
+        memcpy(saved + i * ctx.num_stas, ctx.snr_matrix + i * ctx.link_stride,
+               sizeof(int) * ctx.num_stas);
+    return saved;
+}
+
+static int cmp_links(const int *saved)
+{
+    struct link_matrices *m = links_current(&ctx.links);
+    int i;
+
+    for (i = 0; i < ctx.num_stas; i++) {
+        if (memcmp(saved + i * ctx.num_stas, ctx.snr_matrix + i * ctx.link_stride,
+                   sizeof(int) * ctx.num_stas) ||
+            memcmp(saved + i * ctx.num_stas, m->snr_matrix + i * ctx.link_stride,
+                   sizeof(int) * ctx.num_stas))
+            return -1;
+    }
+    return 0;
+}
+
+static void restore(const int *saved, const double *x)
+{
+    int i;
+
+    links_write_begin(&ctx);
+    for (i = 0; i < ctx.num_stas; i++) {
+        memcpy(ctx.snr_matrix + i * ctx.link_stride, saved + i * ctx.num_stas,
+               sizeof(int) * ctx.num_stas);
+        ctx.sta_array[i]->x = x[i];
+        ctx.sta_array[i]->y = x[i] / 2;
+        ctx.sta_array[i]->z = 1;
+        station_table_update(&ctx, ctx.sta_array[i]);
+    }
+    links_touch_all(&ctx);
+    links_write_end(&ctx);
+}
+
+/*
+ * Apply records as one batch, through the wserver encoding, and one by
+ * one from the same start; both must leave the same links.
+ */
+static int batch_vs_stepwise(const link_update_record *records, int count,
+                             link_update_batch_response *response)
+{
+    link_update_batch_request request;
+    link_update_batch_response one;
+    link_update_record *recv_records;
+    int *start, *batched, fds[2], type, i, ret;
+    double *x = malloc(sizeof(*x) * ctx.num_stas);
+    wserver_msg base;
+
+    for (i = 0; i < ctx.num_stas; i++)
+        x[i] = ctx.sta_array[i]->x;
+    start = save_links();
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) ||
+        send_link_update_batch_request(fds[0], records, count) ||
+        wserver_recv_msg_base(fds[1], &base, &type) ||
+        type != WSERVER_LINK_BATCH_REQUEST_TYPE ||
+        recv_link_update_batch_request(fds[1], &request, &recv_records) ||
+        request.count != (u32) count ||
+        memcmp(recv_records, records, sizeof(*records) * count) ||
+        update_links(&ctx, recv_records, request.count, response) ||
+        send_link_update_batch_response(fds[1], response) ||
+        wserver_recv_msg_base(fds[0], &base, &type) ||
+        type != WSERVER_LINK_BATCH_RESPONSE_TYPE ||
+        recv_link_update_batch_response(fds[0], &one) ||
+        memcmp(&one, response, sizeof(one)))
+        return -1;
+    free(recv_records);
+    close(fds[0]);
+    close(fds[1]);
+    batched = save_links();
+
+    restore(start, x);
+    for (i = 0; i < count; i++)
+        update_links(&ctx, &records[i], 1, &one);
+    ret = cmp_links(batched);
+
+    free(start);
+    free(batched);
+    free(x);
+    return ret;
+}
+
+static int link_batch(void)
+{
+    link_update_record *records = calloc(ctx.num_stas + 64, sizeof(*records));
+    link_update_batch_response response;
+    u8 missing[ETH_ALEN];
+    int i, n = 0;
+
+    ctx.calc_path_loss = test_path_loss;
+
+    /* everyone moves: one full recompute */
+    for (i = 0; i < ctx.num_stas; i++)
+        records[n++] = position(ctx.sta_array[i]->addr, lrand48() % 1000);
+    if (batch_vs_stepwise(records, n, &response) ||
+        response.applied != (u32) n)
+        return -1;
+
+    /* a few stations move, some twice, with SNR updates in between */
+    n = 0;
+    for (i = 0; i < 40; i++) {
+        const u8 *a = ctx.sta_array[lrand48() % 10]->addr;
+        const u8 *b = ctx.sta_array[lrand48() % ctx.num_stas]->addr;
+
+        if (i % 8 == 7) {
+            records[n] = (link_update_record){ .kind = WLINK_SNR };
+            memcpy(records[n].from_addr, a, ETH_ALEN);
+            memcpy(records[n].to_addr, b, ETH_ALEN);
+            records[n++].value.snr = 99;
+        } else {
+            records[n++] = position(a, lrand48() % 1000);
+        }
+    }
+    make_addr(missing, 0);
+    records[n++] = position(missing, 1);
+    records[n] = (link_update_record){ .kind = WLINK_ERRPROB };
+    memcpy(records[n].from_addr, ctx.sta_array[0]->addr, ETH_ALEN);
+    memcpy(records[n++].to_addr, ctx.sta_array[1]->addr, ETH_ALEN);
+    records[n++] = (link_update_record){ .kind = 42 };
+    if (batch_vs_stepwise(records, n, &response) ||
+        response.count != (u32) n || response.applied != 40 ||
+        response.not_found != 1 || response.wrong_mode != 1 ||
+        response.invalid != 1)
+        return -1;
+
+    ctx.calc_path_loss = NULL;
+    free(records);
+    return 0;
+}
+
+static int snr_request(int sock, const u8 *from, const u8 *to, int snr)
+{
+    snr_update_request request;
+
+    memcpy(request.from_addr, from, ETH_ALEN);
+    memcpy(request.to_addr, to, ETH_ALEN);
+    request.snr = snr;
+    return wserver_send_msg(sock, &request, snr_update_request);
+}
+
+static int mode_request(int sock, int enable, u32 first_seq, u32 ack_interval)
+{
+    async_mode_request request = {
+        .enable = enable,
+        .first_seq = first_seq,
+        .ack_interval = ack_interval,
+    };
+
+    return wserver_send_msg(sock, &request, async_mode_request);
+}
+
+/* receive a message of @type into @elem, 0 if that is what came */
+#define expect(sock, elem, elemtype, typeint) ({ \
+    wserver_msg base; \
+    int type; \
+    wserver_recv_msg_base(sock, &base, &type) || type != (typeint) || \
+        wserver_recv_msg(sock, elem, elemtype); \
+})
+
+static int expect_ack(int sock, u32 seq)
+{
+    async_ack ack;
+
+    return expect(sock, &ack, async_ack, WSERVER_ASYNC_ACK_TYPE) || ack.seq != seq;
+}
+
+/*
+ * Ten SNR updates streamed at a server with an ack interval of four, one
+ * of them for an unknown station: only an error and cumulative acks come
+ * back.  Then an add, which still answers, the switch back and a
+ * request that arrives in two reads.
+ */
+static int async_mode(void)
+{
+    struct request_ctx rctx = { .ctx = &ctx, .async = false };
+    async_mode_response mode;
+    station_add_request add;
+    station_add_response added;
+    snr_update_response response;
+    async_error error;
+    u8 missing[ETH_ALEN];
+    u8 bytes[sizeof(snr_update_request)];
+    int fds[2], wire[2], i;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        return -1;
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    rctx.sock_fd = fds[1];
+    make_addr(missing, 0);
+
+    if (mode_request(fds[0], 1, 100, 4) ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE ||
+        expect(fds[0], &mode, async_mode_response, WSERVER_ASYNC_MODE_RESPONSE_TYPE) ||
+        mode.update_result != WUPDATE_SUCCESS || !rctx.async)
+        return -1;
+
+    for (i = 0; i < 10; i++) {
+        if (snr_request(fds[0], ctx.sta_array[i]->addr,
+                        i == 2 ? missing : ctx.sta_array[i + 1]->addr, 50 + i))
+            return -1;
+    }
+    if (receive_handle_requests(&rctx) != WACTION_CONTINUE)
+        return -1;
+    if (expect(fds[0], &error, async_error, WSERVER_ASYNC_ERROR_TYPE) ||
+        error.seq != 102 || error.request_type != WSERVER_SNR_UPDATE_REQUEST_TYPE ||
+        error.update_result != WUPDATE_INTF_NOTFOUND ||
+        expect_ack(fds[0], 103) || expect_ack(fds[0], 107) ||
+        expect_ack(fds[0], 109))
+        return -1;
+    for (i = 0; i < 10; i++) {
+        if (i != 2 && ctx.snr_matrix[i * ctx.link_stride + i + 1] != 50 + i)
+            return -1;
+    }
+
+    make_addr(add.addr, 0xfff0);
+    if (wserver_send_msg(fds[0], &add, station_add_request) ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE ||
+        expect(fds[0], &added, station_add_response, WSERVER_ADD_RESPONSE_TYPE) ||
+        added.update_result != WUPDATE_SUCCESS || expect_ack(fds[0], 110))
+        return -1;
+
+    if (mode_request(fds[0], 0, 0, 0) ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE ||
+        expect_ack(fds[0], 111) ||
+        expect(fds[0], &mode, async_mode_response, WSERVER_ASYNC_MODE_RESPONSE_TYPE) ||
+        rctx.async)
+        return -1;
+
+    /* a request split across reads waits in the buffer for its rest */
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, wire) ||
+        snr_request(wire[0], ctx.sta_array[0]->addr, ctx.sta_array[1]->addr, 7) ||
+        read(wire[1], bytes, sizeof(bytes)) != sizeof(bytes) ||
+        write(fds[0], bytes, 5) != 5 ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE || rctx.rlen != 5 ||
+        write(fds[0], bytes + 5, sizeof(bytes) - 5) != sizeof(bytes) - 5 ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE || rctx.rlen ||
+        expect(fds[0], &response, snr_update_response, WSERVER_SNR_UPDATE_RESPONSE_TYPE) ||
+        response.update_result != WUPDATE_SUCCESS ||
+        ctx.snr_matrix[1] != 7)
+        return -1;
+
+    /* nothing more to read is no reason to block */
+    if (receive_handle_requests(&rctx) != WACTION_CONTINUE)
+        return -1;
+    close(fds[0]);
+    if (receive_handle_requests(&rctx) != WACTION_DISCONNECTED)
+        return -1;
+
+    close(fds[1]);
+    close(wire[0]);
+    close(wire[1]);
+    free(rctx.rbuf);
+    return 0;
+}
+
+/*
+ * The histograms come back summed over the shards and are cleared by a
+ * request with reset set.  The updates above all waited for snr_lock.
+ */
+static int latency(void)
+{
+    struct request_ctx rctx = { .ctx = &ctx };
+    latency_request request = { .reset = 1 };
+    latency_response response;
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        return -1;
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    rctx.sock_fd = fds[1];
+    lat_record(&shard.lat.delivery, 1000);
+    lat_record(&shard.lat.delivery, 3000);
+
+    if (wserver_send_msg(fds[0], &request, latency_request) ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE ||
+        expect(fds[0], &response, latency_response, WSERVER_LATENCY_RESPONSE_TYPE) ||
+        response.stages[WLAT_DELIVERY].count != 2 ||
+        response.stages[WLAT_DELIVERY].mean_ns != 2000 ||
+        response.stages[WLAT_DELIVERY].max_ns != 3000 ||
+        response.stages[WLAT_DELIVERY].p50_ns < 1000 ||
+        response.stages[WLAT_DELIVERY].p50_ns > 1000 + 1000 / LAT_SUB ||
+        !response.stages[WLAT_SNR_LOCK_CONTROL].count ||
+        response.stages[WLAT_INGEST].count)
+        return -1;
+
+    request.reset = 0;
+    if (wserver_send_msg(fds[0], &request, latency_request) ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE ||
+        expect(fds[0], &response, latency_response, WSERVER_LATENCY_RESPONSE_TYPE) ||
+        response.stages[WLAT_DELIVERY].count ||
+        response.stages[WLAT_DELIVERY].max_ns)
+        return -1;
+
+    close(fds[0]);
+    close(fds[1]);
+    free(rctx.rbuf);
+    return 0;
+}
+
+/* what wmediumd -w records of a request */
+static void record_request(struct wmediumd *ctx, const u8 *buf, size_t len)
+{
+    struct trace_record *rec;
+    struct timespec now;
+    uint64_t n;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    n = trace_claim(ctx->trace, 1 + trace_data_records(len));
+    trace_put_data(ctx->trace, n + 1, buf, len);
+
+    rec = trace_slot(ctx->trace, n);
+    memset(rec, 0, sizeof(*rec));
+    rec->type = TRACE_CONTROL;
+    rec->time_ns = timespec_to_ns(&now);
+    rec->data_len = len;
+    trace_commit(rec, n);
+}
+
+/* whether @trace has exactly one record, a control record of @request */
+static int recorded(const struct trace *trace, const void *request, size_t len)
+{
+    struct trace_record rec;
+    u8 data[64];
+    uint64_t n = trace_first(trace);
+
+    if (!trace_read(trace, n, &rec) || rec.type != TRACE_CONTROL ||
+        rec.data_len != len || len > sizeof(data) ||
+        !trace_get_data(trace, n + 1, data, len) ||
+        memcmp(data, request, len) ||
+        trace_end(trace) != n + 1 + trace_data_records(len))
+        return -1;
+    return 0;
+}
+
+/*
+ * Records a request that came in on a connection, replays the trace and
+ * checks that the replay applied the request and recorded it again.
+ */
+static int replay_requests(void)
+{
+    char in_path[] = "/tmp/dynamic_test.XXXXXX";
+    char out_path[] = "/tmp/dynamic_test.XXXXXX";
+    struct request_ctx rctx = { .ctx = &ctx };
+    struct trace in, out;
+    struct replay rp;
+    struct fake_hwsim fh;
+    snr_update_response response;
+    u8 bytes[sizeof(snr_update_request)];
+    int fds[2], fd, ret = -1;
+    int *snr = &ctx.snr_matrix[0 * ctx.link_stride + 1];
+
+    fd = mkstemp(in_path);
+    if (fd < 0)
+        return -1;
+    close(fd);
+    fd = mkstemp(out_path);
+    if (fd < 0)
+        goto out_in_path;
+    close(fd);
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        goto out_path;
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    rctx.sock_fd = fds[1];
+
+    if (trace_open(&in, in_path, 64, 1))
+        goto out_sock;
+    ctx.trace = &in;
+    ctx.record_request = record_request;
+    if (snr_request(fds[0], ctx.sta_array[0]->addr, ctx.sta_array[1]->addr, 33) ||
+        receive_handle_requests(&rctx) != WACTION_CONTINUE ||
+        expect(fds[0], &response, snr_update_response, WSERVER_SNR_UPDATE_RESPONSE_TYPE) ||
+        *snr != 33) {
+        trace_close(&in);
+        goto out_record;
+    }
+    trace_close(&in);
+
+    /* what the request looks like on the wire */
+    if (snr_request(fds[0], ctx.sta_array[0]->addr, ctx.sta_array[1]->addr, 33) ||
+        recv(fds[1], bytes, sizeof(bytes), MSG_WAITALL) != sizeof(bytes))
+        goto out_record;
+
+    *snr = 0;
+    if (trace_open(&out, out_path, 64, 1))
+        goto out_record;
+    ctx.trace = &out;
+    memset(&fh, 0, sizeof(fh));
+    if (replay_open(&rp, in_path, false) == 0) {
+        if (recorded(&rp.trace, bytes, sizeof(bytes)) == 0 &&
+            replay_run(&rp, &ctx, &fh) == 0 && rp.requests == 1 &&
+            *snr == 33 && recorded(&out, bytes, sizeof(bytes)) == 0)
+            ret = 0;
+        replay_free(&rp);
+    }
+    trace_close(&out);
+out_record:
+    ctx.trace = NULL;
+    ctx.record_request = NULL;
+out_sock:
+    close(fds[0]);
+    close(fds[1]);
+    free(rctx.rbuf);
+    free(rctx.wbuf);
+out_path:
+    unlink(out_path);
+out_in_path:
+    unlink(in_path);
+    return ret;
+}
+
+static double now_ms(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+int main(void)
+{
+    u8 (*addrs)[ETH_ALEN] = calloc(BENCH_STAS, ETH_ALEN);
+    i32 *ids = calloc(BENCH_STAS, sizeof(*ids));
+    int step, next_id = 1, failed = 0;
+    double start;
+
+    memset(&ctx, 0, sizeof(ctx));
+    INIT_LIST_HEAD(&ctx.stations);
+    shard.ctx = &ctx;
+    sched_init(&shard.sched);
+    frame_pool_init(&shard.frame_pool);
+    ctx.shards = &shard;
+    ctx.num_shards = 1;
+    sta_table_init(&ctx.sta_table);
+    medium_table_init(&ctx.mediums);
+    addr_index_init(&ctx.sta_by_addr, offsetof(struct station, addr));
+    ctx.sta_array = malloc(0);
+    ctx.snr_matrix = malloc(0);
+    if (links_init(&ctx))
+        return EXIT_FAILURE;
+
+    srand48(1);
+    for (step = 0; step < STEPS && !failed; step++) {
+        int ret;
+
+        if (ctx.num_stas == 0 ||
+            (ctx.num_stas < MAX_STAS && lrand48() % 3)) {
+            ret = add(next_id++);
+        } else {
+            struct station *sta = ctx.sta_array[lrand48() % ctx.num_stas];
+
+            if (step & 1)
+                ret = del_station_by_id(&ctx, sta->index);
+            else
+                ret = del_station_by_mac(&ctx, sta->addr);
+        }
+        if (ret < 0 || check()) {
+            fprintf(stderr, "step %d: %s\n", step,
+                    ret < 0 ? strerror(-ret) : "links or indices wrong");
+            failed = 1;
+        }
+    }
+    if (!failed && del_station_by_id(&ctx, ctx.num_stas) != -ENODEV) {
+        fprintf(stderr, "deleting a missing id did not fail\n");
+        failed = 1;
+    }
+    printf("%d steps, %d stations, stride %d: %s\n", step, ctx.num_stas,
+           ctx.link_stride, failed ? "FAILED" : "ok");
+
+    if (!failed) {
+        failed = bulk(&next_id) != 0;
+        printf("bulk add and delete, %d stations: %s\n", ctx.num_stas,
+               failed ? "FAILED" : "ok");
+    }
+    if (!failed) {
+        failed = link_batch() != 0;
+        printf("link update batches: %s\n", failed ? "FAILED" : "ok");
+    }
+    if (!failed) {
+        failed = async_mode() != 0;
+        printf("async wserver connection: %s\n", failed ? "FAILED" : "ok");
+    }
+    if (!failed) {
+        failed = latency() != 0;
+        printf("latency histograms: %s\n", failed ? "FAILED" : "ok");
+    }
+    if (!failed) {
+        failed = replay_requests() != 0;
+        printf("replayed requests recorded: %s\n", failed ? "FAILED" : "ok");
+    }
+
+    /* both runs start empty with the stride already grown */
+    for (step = 0; step < BENCH_STAS; step++)
+        make_addr(addrs[step], step);
+    add_stations(&ctx, (const u8 (*)[ETH_ALEN]) addrs, BENCH_STAS, ids);
+    while (ctx.num_stas)
+        del_station_by_id(&ctx, 0);
+
+    start = now_ms();
+    for (step = 0; step < BENCH_STAS; step++)
+        add_station(&ctx, addrs[step]);
+    printf("%d stations added one by one: %.1f ms\n", BENCH_STAS,
+           now_ms() - start);
+    while (ctx.num_stas)
+        del_station_by_id(&ctx, 0);
+
+    start = now_ms();
+    add_stations(&ctx, (const u8 (*)[ETH_ALEN]) addrs, BENCH_STAS, ids);
+    printf("%d stations added in one bulk request: %.1f ms\n", BENCH_STAS,
+           now_ms() - start);
+
+    free(addrs);
+    free(ids);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+/*
+ * Latency histograms: every value lands in the bucket whose bounds hold
+ * it, buckets are no wider than 1/LAT_SUB of their values, and
+ * percentiles come out within a bucket of the exact ones.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../wmediumd/latency.h"
+
+#define VALUES 100000
+
+static int check_bucket(uint64_t ns)
+{
+    unsigned int idx = lat_bucket(ns);
+
+    if (idx >= LAT_BUCKETS || ns < lat_bucket_low(idx) ||
+        ns > lat_bucket_high(idx)) {
+        fprintf(stderr, "%llu in bucket %u of %llu..%llu\n",
+                (unsigned long long)ns, idx,
+                (unsigned long long)lat_bucket_low(idx),
+                (unsigned long long)lat_bucket_high(idx));
+        return -1;
+    }
+    if (ns >= LAT_SUB &&
+        lat_bucket_high(idx) - lat_bucket_low(idx) >= lat_bucket_low(idx) / LAT_SUB) {
+        fprintf(stderr, "bucket %u too wide\n", idx);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_percentile(const struct lat_hist *h, double q, uint64_t exact)
+{
+    uint64_t got = lat_hist_percentile(h, q);
+
+    if (got < exact || got > exact + exact / LAT_SUB) {
+        fprintf(stderr, "p%g is %llu, expected about %llu\n", q * 100,
+                (unsigned long long)got, (unsigned long long)exact);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct lat_hist *h, *sum;
+    uint64_t ns;
+    unsigned int i;
+    int ret = EXIT_FAILURE;
+
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        if (lat_bucket(lat_bucket_low(i)) != i) {
+            fprintf(stderr, "bucket %u does not start at %llu\n", i,
+                    (unsigned long long)lat_bucket_low(i));
+            return EXIT_FAILURE;
+        }
+    }
+    for (ns = 0; ns < 100000; ns++) {
+        if (check_bucket(ns))
+            return EXIT_FAILURE;
+    }
+    for (ns = 1; ns < UINT64_MAX / 3; ns = ns * 3 + 1) {
+        if (check_bucket(ns) || check_bucket(ns - 1))
+            return EXIT_FAILURE;
+    }
+    if (check_bucket(UINT64_MAX))
+        return EXIT_FAILURE;
+
+    h = calloc(1, sizeof(*h));
+    sum = calloc(1, sizeof(*sum));
+    if (!h || !sum)
+        goto out;
+
+    /* 1000, 2000, ... 100000000 ns */
+    for (i = 1; i <= VALUES; i++)
+        lat_record(h, i * 1000ULL);
+    if (h->count != VALUES || h->max_ns != VALUES * 1000ULL ||
+        h->sum_ns != 1000ULL * VALUES * (VALUES + 1) / 2) {
+        fprintf(stderr, "wrong count, sum or max\n");
+        goto out;
+    }
+    if (check_percentile(h, 0.5, VALUES / 2 * 1000ULL) ||
+        check_percentile(h, 0.99, VALUES / 100 * 99 * 1000ULL) ||
+        check_percentile(h, 1.0, VALUES * 1000ULL) ||
+        lat_hist_percentile(h, 0.0) != lat_bucket_high(lat_bucket(1000)))
+        goto out;
+
+    lat_hist_snapshot(sum, h);
+    lat_hist_snapshot(sum, h);
+    if (sum->count != 2 * VALUES || sum->max_ns != h->max_ns ||
+        check_percentile(sum, 0.5, VALUES / 2 * 1000ULL))
+        goto out;
+
+    lat_hist_reset(h);
+    if (h->count || h->max_ns || lat_hist_percentile(h, 0.5)) {
+        fprintf(stderr, "reset left values behind\n");
+        goto out;
+    }
+
+    printf("latency_test: %u buckets, %d values\n", LAT_BUCKETS, VALUES);
+    ret = EXIT_SUCCESS;
+out:
+    free(h);
+    free(sum);
+    return ret;
+}
@@ -0,0 +1,203 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+/*
+ * Reader threads check published link matrices while a writer updates
+ * pairs, whole stations and everything: every snapshot must stay
+ * symmetric and its per-link arrays alive, and after the last update
+ * both copies must match the writer's reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "../wmediumd/wmediumd.h"
+
+#define NUM_STAS 48
+#define NUM_READERS 3
+#define STEPS 20000
+#define SPEC_LEN 4
+
+static struct wmediumd ctx;
+static int reference[NUM_STAS * NUM_STAS];
+static int done;
+static int failed;
+
+int w_flogf(struct wmediumd *ctx, u8 level, FILE *stream, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+    return 0;
+}
+
+static double *spec_new(int v)
+{
+    double *spec = malloc(SPEC_LEN * sizeof(*spec));
+    int i;
+
+    for (i = 0; i < SPEC_LEN; i++)
+        spec[i] = v;
+    return spec;
+}
+
+static void *reader(void *arg)
+{
+    unsigned short seed[3] = { (unsigned short)(long)arg, 1, 2 };
+    uint64_t last = 0;
+    long checks = 0;
+
+    while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+        struct link_matrices *m;
+        int i, a, b;
+
+        links_read_lock(&ctx.links);
+        m = links_current(&ctx.links);
+        if (m->version < last) {
+            fprintf(stderr, "version went back %llu -> %llu\n",
+                    (unsigned long long)last,
+                    (unsigned long long)m->version);
+            __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+        }
+        last = m->version;
+        for (i = 0; i < 64; i++) {
+            double *spec;
+
+            a = nrand48(seed) % NUM_STAS;
+            b = nrand48(seed) % NUM_STAS;
+            if (m->snr_matrix[a * NUM_STAS + b] !=
+                m->snr_matrix[b * NUM_STAS + a]) {
+                fprintf(stderr, "v%llu: link %d-%d asymmetric\n",
+                        (unsigned long long)m->version, a, b);
+                __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+            }
+            spec = m->station_err_matrix[a * NUM_STAS + b];
+            if (spec[0] != spec[SPEC_LEN - 1]) {
+                fprintf(stderr, "v%llu: link %d-%d freed early\n",
+                        (unsigned long long)m->version, a, b);
+                __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+            }
+            checks++;
+        }
+        links_read_unlock(&ctx.links);
+        /* like the data path, don't hog the CPU between sections */
+        if (checks % 1024 == 0)
+            sched_yield();
+    }
+    return (void *)checks;
+}
+
+static void set_link(int a, int b, int v)
+{
+    int i = a * NUM_STAS + b;
+
+    reference[i] = reference[b * NUM_STAS + a] = v;
+    ctx.snr_matrix[i] = ctx.snr_matrix[b * NUM_STAS + a] = v;
+    links_retire(&ctx, ctx.station_err_matrix[i]);
+    ctx.station_err_matrix[i] = spec_new(v);
+}
+
+static void write_step(int step)
+{
+    int a = lrand48() % NUM_STAS, b = lrand48() % NUM_STAS, k;
+
+    links_write_begin(&ctx);
+    switch (step % 8) {
+    case 0:
+        /* a station moved: its row and column */
+        for (k = 0; k < NUM_STAS; k++)
+            set_link(a, k, step);
+        links_touch_station(&ctx, a);
+        break;
+    case 1:
+        if (step % 64 == 1) {
+            for (k = 0; k < NUM_STAS * NUM_STAS; k++)
+                reference[k] = ctx.snr_matrix[k] = step;
+            links_touch_all(&ctx);
+            break;
+        }
+        /* fall through */
+    default:
+        set_link(a, b, step);
+        links_touch_pair(&ctx, a, b);
+        break;
+    }
+    links_write_end(&ctx);
+}
+
+int main(void)
+{
+    pthread_t threads[NUM_READERS];
+    struct link_matrices *m;
+    long checks = 0;
+    int i, step;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.num_stas = NUM_STAS;
+    ctx.link_stride = NUM_STAS;
+    ctx.snr_matrix = calloc(NUM_STAS * NUM_STAS, sizeof(int));
+    ctx.station_err_matrix = calloc(NUM_STAS * NUM_STAS, sizeof(double *));
+    if (!ctx.snr_matrix || !ctx.station_err_matrix)
+        return EXIT_FAILURE;
+    for (i = 0; i < NUM_STAS * NUM_STAS; i++)
+        ctx.station_err_matrix[i] = spec_new(0);
+    if (links_init(&ctx))
+        return EXIT_FAILURE;
+
+    for (i = 0; i < NUM_READERS; i++)
+        pthread_create(&threads[i], NULL, reader, (void *)(long)i);
+    for (step = 1; step <= STEPS; step++)
+        write_step(step);
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < NUM_READERS; i++) {
+        void *ret;
+
+        pthread_join(threads[i], &ret);
+        checks += (long)ret;
+    }
+
+    /* both copies must have caught up */
+    m = links_current(&ctx.links);
+    if (memcmp(m->snr_matrix, reference, sizeof(reference)) ||
+        memcmp(ctx.snr_matrix, reference, sizeof(reference)) ||
+        memcmp(m->station_err_matrix, ctx.station_err_matrix,
+               NUM_STAS * NUM_STAS * sizeof(double *))) {
+        fprintf(stderr, "copies differ after the last update\n");
+        failed = 1;
+    }
+
+    printf("%d updates, version %llu, %ld reader checks: %s\n", STEPS,
+           (unsigned long long)m->version, checks, failed ? "FAILED" : "ok");
+
+    for (i = 0; i < NUM_STAS * NUM_STAS; i++)
+        free(ctx.station_err_matrix[i]);
+    free(ctx.snr_matrix);
+    free(ctx.station_err_matrix);
+    links_free(&ctx);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+/*
+ * Per-medium member lists and expiry summaries against the full station
+ * scans they replace, under random medium changes, queued frames and
+ * deliveries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "../wmediumd/wmediumd.h"
+
+#define NUM_STAS 64
+#define NUM_MEDIUMS 5
+#define STEPS 200000
+
+int w_flogf(struct wmediumd *ctx, u8 level, FILE *stream, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+    return 0;
+}
+
+void shard_move_station(struct station *station, struct shard *from,
+                        struct shard *to)
+{
+}
+
+bool timespec_before(struct timespec *t1, struct timespec *t2)
+{
+    return t1->tv_sec < t2->tv_sec ||
+           (t1->tv_sec == t2->tv_sec && t1->tv_nsec < t2->tv_nsec);
+}
+
+static void add_usec(struct timespec *t, long usec)
+{
+    t->tv_nsec += usec * 1000;
+    while (t->tv_nsec >= 1000000000) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+/* the contention start of queue_frame() before per-medium summaries */
+static struct timespec scan_target(struct wmediumd *ctx, struct station *station,
+                                   int ac, struct timespec now)
+{
+    struct station *tmpsta;
+    struct frame *tail;
+    int i;
+
+    list_for_each_entry(tmpsta, &ctx->stations, list) {
+        if (station->medium_id != tmpsta->medium_id)
+            continue;
+        for (i = 0; i <= ac; i++) {
+            tail = list_last_entry_or_null(&tmpsta->queues[i].frames,
+                                           struct frame, list);
+            if (tail && timespec_before(&now, &tail->expires))
+                now = tail->expires;
+        }
+    }
+    return now;
+}
+
+static struct timespec summary_target(struct station *station, int ac,
+                                      struct timespec now)
+{
+    int i;
+
+    for (i = 0; i <= ac; i++) {
+        if (timespec_before(&now, &station->medium->last_expires[i]))
+            now = station->medium->last_expires[i];
+    }
+    return now;
+}
+
+static int check_members(struct wmediumd *ctx)
+{
+    int m, k, n = 0;
+
+    for (m = 0; m < ctx->mediums.num; m++) {
+        struct medium *medium = ctx->mediums.mediums[m];
+
+        for (k = 0; k < medium->num_members; k++) {
+            struct station *sta = ctx->sta_array[medium->members[k]];
+
+            if (sta->medium != medium || sta->medium_id != medium->id ||
+                (k && medium->members[k - 1] >= medium->members[k]))
+                return -1;
+            n++;
+        }
+    }
+    return n == ctx->num_stas ? 0 : -1;
+}
+
+/* deliver every frame that expired before @now, as the timer would */
+static void deliver(struct wmediumd *ctx, struct timespec *now)
+{
+    struct station *sta;
+    struct frame *frame, *tmp;
+    int ac;
+
+    list_for_each_entry(sta, &ctx->stations, list) {
+        for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+            list_for_each_entry_safe(frame, tmp, &sta->queues[ac].frames, list) {
+                if (!timespec_before(&frame->expires, now))
+                    break;
+                list_del(&frame->list);
+                free(frame);
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    struct timespec now = {1, 0}, expected, got;
+    struct wmediumd ctx;
+    struct shard shard = { .ctx = &ctx };
+    struct station *sta;
+    struct frame *frame;
+    int i, ac, step, failed = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    INIT_LIST_HEAD(&ctx.stations);
+    ctx.shards = &shard;
+    ctx.num_shards = 1;
+    sta_table_init(&ctx.sta_table);
+    if (sta_table_reserve(&ctx.sta_table, NUM_STAS)) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    medium_table_init(&ctx.mediums);
+    ctx.num_stas = NUM_STAS;
+    ctx.sta_array = calloc(NUM_STAS, sizeof(*ctx.sta_array));
+    if (!ctx.sta_array) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < NUM_STAS; i++) {
+        sta = calloc(1, sizeof(*sta));
+        if (!sta) {
+            perror("calloc");
+            return EXIT_FAILURE;
+        }
+        sta->index = i;
+        sta->medium_id = i % NUM_MEDIUMS;
+        for (ac = 0; ac < IEEE80211_NUM_ACS; ac++)
+            INIT_LIST_HEAD(&sta->queues[ac].frames);
+        list_add_tail(&sta->list, &ctx.stations);
+        ctx.sta_array[i] = sta;
+    }
+    if (medium_rebuild(&ctx) || check_members(&ctx)) {
+        fprintf(stderr, "initial member lists wrong\n");
+        return EXIT_FAILURE;
+    }
+
+    srand48(5);
+    for (step = 0; step < STEPS && !failed; step++) {
+        sta = ctx.sta_array[lrand48() % NUM_STAS];
+        switch (lrand48() % 16) {
+        case 0:
+            /* AP-style mediums are negative, as detect_mediums() sets */
+            if (station_set_medium(&ctx, sta, (int)(lrand48() % (2 * NUM_MEDIUMS)) -
+                                   NUM_MEDIUMS) || check_members(&ctx)) {
+                fprintf(stderr, "step %d: member lists wrong\n", step);
+                failed = 1;
+            }
+            break;
+        case 1:
+            add_usec(&now, lrand48() % 3000);
+            deliver(&ctx, &now);
+            break;
+        default:
+            ac = lrand48() % IEEE80211_NUM_ACS;
+            expected = scan_target(&ctx, sta, ac, now);
+            got = summary_target(sta, ac, now);
+            if (expected.tv_sec != got.tv_sec || expected.tv_nsec != got.tv_nsec) {
+                fprintf(stderr, "step %d: contention start differs\n", step);
+                failed = 1;
+                break;
+            }
+            frame = calloc(1, sizeof(*frame));
+            if (!frame) {
+                perror("calloc");
+                return EXIT_FAILURE;
+            }
+            frame->expires = got;
+            add_usec(&frame->expires, 50 + lrand48() % 500);
+            list_add_tail(&frame->list, &sta->queues[ac].frames);
+            medium_frame_queued(sta->medium, ac, &frame->expires);
+            break;
+        }
+    }
+
+    printf("%d steps, %d mediums: %s\n", step, ctx.mediums.num,
+           failed ? "FAILED" : "ok");
+    medium_table_free(&ctx.mediums);
+    sta_table_free(&ctx.sta_table);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+/*
+ * Write-lock hold time of a single-station position update: the old
+ * full N^2 calc_signal() against recalc_path_loss_station(), and a
+ * check that both leave the same SNR matrix behind.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../wmediumd/wmediumd.h"
+#include "../wmediumd/path_loss.h"
+
+#define NUM_STAS 1000
+#define UPDATES 20
+
+static double elapsed_ms(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/* calc_signal() as wserver.c had it: every ordered pair, both directions */
+static void calc_signal_full(struct wmediumd *ctx)
+{
+    int txpower, path_loss, gains, signal, from, to;
+
+    for (from = 0; from < ctx->num_stas; from++) {
+        for (to = 0; to < ctx->num_stas; to++) {
+            if (from == to)
+                continue;
+            txpower = ctx->sta_array[from]->tx_power;
+            if (ctx->sta_array[to]->isap == 1)
+                txpower = ctx->sta_array[to]->tx_power;
+            path_loss = ctx->calc_path_loss(ctx->path_loss_param,
+                                            ctx->sta_array[to], ctx->sta_array[from]);
+            gains = txpower + ctx->sta_array[from]->gain + ctx->sta_array[to]->gain;
+            signal = gains - path_loss - ctx->noise_threshold;
+            ctx->snr_matrix[ctx->num_stas * to + from] = signal;
+            ctx->snr_matrix[ctx->num_stas * from + to] = signal;
+        }
+    }
+}
+
+static void setup(struct wmediumd *ctx, struct log_distance_model_param *param)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->num_stas = NUM_STAS;
+    ctx->link_stride = NUM_STAS;
+    ctx->sta_array = calloc(NUM_STAS, sizeof(*ctx->sta_array));
+    ctx->snr_matrix = calloc(NUM_STAS * NUM_STAS, sizeof(int));
+    if (!ctx->sta_array || !ctx->snr_matrix) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    param->path_loss_exponent = 3.5;
+    param->Xg = 0;
+    ctx->path_loss_param = param;
+    ctx->calc_path_loss = calc_path_loss_log_distance;
+    ctx->noise_threshold = -91;
+
+    srand48(1);
+    for (i = 0; i < NUM_STAS; i++) {
+        struct station *sta = calloc(1, sizeof(*sta));
+
+        if (!sta) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+        sta->index = i;
+        sta->x = drand48() * 500;
+        sta->y = drand48() * 500;
+        sta->z = drand48() * 10;
+        sta->tx_power = 10 + lrand48() % 10;
+        sta->gain = lrand48() % 5;
+        sta->isap = lrand48() % 10 == 0;
+        sta->freq = 2412;
+        ctx->sta_array[i] = sta;
+    }
+
+    if (sta_table_reserve(&ctx->sta_table, NUM_STAS)) {
+        perror("sta_table_reserve");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < NUM_STAS; i++)
+        sta_table_set(&ctx->sta_table, ctx->sta_array[i]);
+}
+
+static void move(struct station *sta)
+{
+    sta->x += drand48() * 20 - 10;
+    sta->y += drand48() * 20 - 10;
+}
+
+int main(void)
+{
+    struct log_distance_model_param param;
+    struct timespec start, end;
+    struct wmediumd ctx;
+    struct station *sta;
+    int *expected;
+    double full = 0, incr = 0;
+    int i;
+
+    setup(&ctx, &param);
+    expected = malloc(NUM_STAS * NUM_STAS * sizeof(int));
+    if (!expected) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    recalc_path_loss(&ctx);
+
+    for (i = 0; i < UPDATES; i++) {
+        sta = ctx.sta_array[lrand48() % NUM_STAS];
+        move(sta);
+        sta_table_set(&ctx.sta_table, sta);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        recalc_path_loss_station(&ctx, sta);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        incr += elapsed_ms(&start, &end);
+        memcpy(expected, ctx.snr_matrix, NUM_STAS * NUM_STAS * sizeof(int));
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        calc_signal_full(&ctx);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        full += elapsed_ms(&start, &end);
+
+        if (memcmp(expected, ctx.snr_matrix, NUM_STAS * NUM_STAS * sizeof(int))) {
+            fprintf(stderr, "incremental update differs from full recalculation\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    recalc_path_loss(&ctx);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (memcmp(expected, ctx.snr_matrix, NUM_STAS * NUM_STAS * sizeof(int))) {
+        fprintf(stderr, "recalc_path_loss differs from full recalculation\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d stations, lock hold per position update:\n", NUM_STAS);
+    printf("  full calc_signal()           %10.3f ms\n", full / UPDATES);
+    printf("  recalc_path_loss() (a > b)   %10.3f ms\n", elapsed_ms(&start, &end));
+    printf("  recalc_path_loss_station()   %10.3f ms\n", incr / UPDATES);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+/*
+ * Parity of the bulk path loss kernels: for every distance kernel the
+ * CPU supports and every path loss model, the SNR matrices built by
+ * recalc_path_loss() and recalc_path_loss_station() must equal the
+ * per-pair calc_path_loss() results, and the distances themselves must
+ * be bit-identical to the scalar computation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../wmediumd/wmediumd.h"
+#include "../wmediumd/path_loss.h"
+
+#define NUM_STAS 301
+
+static const char *isa_names[] = {"auto", "scalar", "sse2", "avx"};
+
+/* per-pair reference, as calc_signal() in wserver.c used to do it */
+static void reference(struct wmediumd *ctx, int *snr)
+{
+    int txpower, path_loss, gains, from, to;
+
+    for (from = 0; from < ctx->num_stas; from++) {
+        for (to = 0; to < ctx->num_stas; to++) {
+            if (from == to)
+                continue;
+            txpower = ctx->sta_array[from]->tx_power;
+            if (ctx->sta_array[to]->isap == 1)
+                txpower = ctx->sta_array[to]->tx_power;
+            path_loss = ctx->calc_path_loss(ctx->path_loss_param,
+                                            ctx->sta_array[to], ctx->sta_array[from]);
+            gains = txpower + ctx->sta_array[from]->gain + ctx->sta_array[to]->gain;
+            snr[ctx->num_stas * to + from] = gains - path_loss - ctx->noise_threshold;
+            snr[ctx->num_stas * from + to] = gains - path_loss - ctx->noise_threshold;
+        }
+    }
+}
+
+static void setup(struct wmediumd *ctx)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->num_stas = NUM_STAS;
+    ctx->link_stride = NUM_STAS;
+    ctx->sta_array = calloc(NUM_STAS, sizeof(*ctx->sta_array));
+    ctx->snr_matrix = calloc(NUM_STAS * NUM_STAS, sizeof(int));
+    if (!ctx->sta_array || !ctx->snr_matrix) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    path_loss_soa_init(&ctx->path_loss_soa);
+    ctx->noise_threshold = -91;
+
+    srand48(7);
+    for (i = 0; i < NUM_STAS; i++) {
+        struct station *sta = calloc(1, sizeof(*sta));
+
+        if (!sta) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+        sta->index = i;
+        /* positions spread over several magnitudes */
+        sta->x = (drand48() - 0.5) * pow(10, lrand48() % 5);
+        sta->y = (drand48() - 0.5) * pow(10, lrand48() % 5);
+        sta->z = drand48() * 30;
+        sta->tx_power = 5 + lrand48() % 20;
+        sta->gain = lrand48() % 6;
+        sta->gRandom = lrand48() % 8;
+        sta->isap = lrand48() % 8 == 0;
+        sta->freq = lrand48() % 3 ? 2412 : 5180;
+        ctx->sta_array[i] = sta;
+    }
+
+    if (sta_table_reserve(&ctx->sta_table, NUM_STAS)) {
+        perror("sta_table_reserve");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < NUM_STAS; i++)
+        sta_table_set(&ctx->sta_table, ctx->sta_array[i]);
+}
+
+static int check_distances(struct wmediumd *ctx)
+{
+    double x[NUM_STAS], y[NUM_STAS], z[NUM_STAS], d[NUM_STAS];
+    struct station *s = ctx->sta_array[0], *o;
+    int i;
+
+    for (i = 0; i < NUM_STAS; i++) {
+        x[i] = ctx->sta_array[i]->x;
+        y[i] = ctx->sta_array[i]->y;
+        z[i] = ctx->sta_array[i]->z;
+    }
+    path_loss_distances(x, y, z, NUM_STAS, s->x, s->y, s->z, d);
+    for (i = 0; i < NUM_STAS; i++) {
+        o = ctx->sta_array[i];
+        if (d[i] != sqrt((s->x - o->x) * (s->x - o->x) +
+                         (s->y - o->y) * (s->y - o->y) +
+                         (s->z - o->z) * (s->z - o->z))) {
+            fprintf(stderr, "distance %d differs\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct log_distance_model_param log_distance = {3.5, 2.0};
+    struct log_normal_shadowing_model_param shadowing = {3, 4.0};
+    struct free_space_model_param free_space = {1};
+    struct itu_model_param itu = {1, 4, 0};
+    struct two_ray_ground_model_param two_ray = {1};
+    struct {
+        const char *name;
+        int (*calc)(void *, struct station *, struct station *);
+        void *param;
+    } models[] = {
+        {"free_space", calc_path_loss_free_space, &free_space},
+        {"log_distance", calc_path_loss_log_distance, &log_distance},
+        {"itu", calc_path_loss_itu, &itu},
+        {"log_normal_shadowing", calc_path_loss_log_normal_shadowing, &shadowing},
+        {"two_ray_ground", calc_path_loss_two_ray_ground, &two_ray},
+    };
+    size_t sz = NUM_STAS * NUM_STAS * sizeof(int);
+    struct wmediumd ctx;
+    int *expected;
+    size_t m;
+    int isa, i, failed = 0;
+
+    setup(&ctx);
+    expected = malloc(sz);
+    if (!expected) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    for (isa = PATH_LOSS_ISA_SCALAR; isa <= PATH_LOSS_ISA_AVX; isa++) {
+        if (path_loss_set_isa(isa)) {
+            printf("%-7s not supported, skipped\n", isa_names[isa]);
+            continue;
+        }
+        if (check_distances(&ctx))
+            failed++;
+
+        for (m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+            ctx.calc_path_loss = models[m].calc;
+            ctx.path_loss_param = models[m].param;
+            reference(&ctx, expected);
+
+            memset(ctx.snr_matrix, 0, sz);
+            recalc_path_loss(&ctx);
+            if (memcmp(expected, ctx.snr_matrix, sz)) {
+                fprintf(stderr, "%s/%s: recalc_path_loss differs\n",
+                        isa_names[isa], models[m].name);
+                failed++;
+            }
+
+            memset(ctx.snr_matrix, 0, sz);
+            for (i = 0; i < NUM_STAS; i++)
+                recalc_path_loss_station(&ctx, ctx.sta_array[i]);
+            if (memcmp(expected, ctx.snr_matrix, sz)) {
+                fprintf(stderr, "%s/%s: recalc_path_loss_station differs\n",
+                        isa_names[isa], models[m].name);
+                failed++;
+            }
+        }
+        printf("%-7s %s\n", isa_names[isa], failed ? "FAILED" : "ok");
+    }
+    path_loss_soa_free(&ctx.path_loss_soa);
+    sta_table_free(&ctx.sta_table);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+/*
+ * The tabulated/memoized get_error_prob_from_snr() must agree bit for
+ * bit with the analytic model; also reports calls/sec for both, once
+ * with random inputs and once with the few (snr, rate, len) tuples a
+ * steady-state simulation produces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "../wmediumd/wmediumd.h"
+
+#define BENCH_CALLS 2000000
+
+/* per.o logs through this when reading PER files */
+int w_flogf(struct wmediumd *ctx, u8 level, FILE *stream, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+    return 0;
+}
+
+static double elapsed_s(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static int check_accuracy(void)
+{
+    int lens[] = {0, 1, 14, 60, 256, 1500, 2304, 7935, 11454};
+    u32 freqs[] = {2412, 5180};
+    double snr, exact, table;
+    unsigned int rate;
+    size_t f, l;
+    int checked = 0, failed = 0;
+
+    /* integers inside and beyond the table, fractions, non-positive */
+    for (snr = -5.0; snr <= 150.0; snr += 0.25) {
+        for (f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+            for (rate = 0; rate < 14; rate++) {
+                for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+                    exact = get_error_prob_from_snr_analytic(snr, rate,
+                                                             freqs[f], lens[l]);
+                    table = get_error_prob_from_snr(snr, rate, freqs[f],
+                                                    lens[l]);
+                    checked++;
+                    if (exact != table) {
+                        if (failed++ < 10)
+                            fprintf(stderr, "mismatch snr %.2f rate %u freq %u "
+                                    "len %d: %.17g != %.17g\n", snr, rate,
+                                    freqs[f], lens[l], table, exact);
+                    }
+                }
+            }
+        }
+    }
+    printf("accuracy: %d/%d lookups identical\n", checked - failed, checked);
+    return failed ? -1 : 0;
+}
+
+static void bench(const char *name,
+                  double (*fn)(double, unsigned int, u32, int), bool steady)
+{
+    /* a handful of links, MRR rates and the usual frame sizes */
+    int snrs[] = {12, 18, 25, 31, 40};
+    int lens[] = {14, 60, 120, 1514};
+    struct timespec start, end;
+    volatile double sink = 0;
+    int i;
+
+    srand48(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < BENCH_CALLS; i++) {
+        if (steady)
+            sink += fn(snrs[lrand48() % 5], lrand48() % 4, 2412,
+                       lens[lrand48() % 4]);
+        else
+            sink += fn(lrand48() % 40 + 1, lrand48() % 8, 2412,
+                       lrand48() % 1500 + 14);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-10s %-8s %12.0f calls/sec\n", name, steady ? "steady" : "random",
+           BENCH_CALLS / elapsed_s(&start, &end));
+}
+
+int main(void)
+{
+    if (check_accuracy())
+        return EXIT_FAILURE;
+
+    bench("analytic", get_error_prob_from_snr_analytic, false);
+    bench("table", get_error_prob_from_snr, false);
+    bench("analytic", get_error_prob_from_snr_analytic, true);
+    bench("table", get_error_prob_from_snr, true);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+/*
+ * Per-frame scheduling cost vs. station count: the old rearm_timer()
+ * scan over every station/AC head against the frame_sched heap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../wmediumd/wmediumd.h"
+
+#define FRAMES_PER_STA 4
+#define ROUNDS 200000
+
+static struct station *stations;
+static struct frame *frames;
+
+bool timespec_before(struct timespec *t1, struct timespec *t2)
+{
+    return t1->tv_sec < t2->tv_sec ||
+           (t1->tv_sec == t2->tv_sec && t1->tv_nsec < t2->tv_nsec);
+}
+
+static void add_usec(struct timespec *t, long usec)
+{
+    t->tv_nsec += usec * 1000;
+    while (t->tv_nsec >= 1000000000) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+static double elapsed_ns(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void setup(int num_stas)
+{
+    struct timespec t = {0, 0};
+    int i, j;
+
+    stations = calloc(num_stas, sizeof(*stations));
+    frames = calloc(num_stas * FRAMES_PER_STA, sizeof(*frames));
+    if (!stations || !frames) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    srand48(1);
+    for (i = 0; i < num_stas; i++) {
+        for (j = 0; j < IEEE80211_NUM_ACS; j++) {
+            INIT_LIST_HEAD(&stations[i].queues[j].frames);
+            stations[i].queues[j].sched_idx = -1;
+        }
+    }
+    for (i = 0; i < num_stas * FRAMES_PER_STA; i++) {
+        struct wqueue *q = &stations[i % num_stas].queues[lrand48() % IEEE80211_NUM_ACS];
+
+        add_usec(&t, lrand48() % 100);
+        frames[i].expires = t;
+        list_add_tail(&frames[i].list, &q->frames);
+    }
+}
+
+/* move the delivered frame to the tail of a random queue */
+static struct wqueue *requeue(struct frame *frame, int num_stas,
+                              struct timespec *now)
+{
+    struct wqueue *q = &stations[lrand48() % num_stas].queues[lrand48() % IEEE80211_NUM_ACS];
+    struct frame *tail = list_last_entry_or_null(&q->frames, struct frame, list);
+
+    frame->expires = *now;
+    if (tail && timespec_before(now, &tail->expires))
+        frame->expires = tail->expires;
+    add_usec(&frame->expires, 1 + lrand48() % 1000);
+    list_add_tail(&frame->list, &q->frames);
+    return q;
+}
+
+static struct wqueue *linear_min(int num_stas)
+{
+    struct wqueue *min_q = NULL;
+    struct frame *frame, *min = NULL;
+    int i, j;
+
+    for (i = 0; i < num_stas; i++) {
+        for (j = 0; j < IEEE80211_NUM_ACS; j++) {
+            frame = list_first_entry_or_null(&stations[i].queues[j].frames,
+                                             struct frame, list);
+            if (frame && (!min || timespec_before(&frame->expires, &min->expires))) {
+                min = frame;
+                min_q = &stations[i].queues[j];
+            }
+        }
+    }
+    return min_q;
+}
+
+static double bench_linear(int num_stas)
+{
+    struct timespec start, end;
+    struct wqueue *q;
+    struct frame *frame;
+    int i;
+
+    setup(num_stas);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ROUNDS; i++) {
+        /* timer_cb: find expired frame, deliver, rearm */
+        q = linear_min(num_stas);
+        frame = list_first_entry(&q->frames, struct frame, list);
+        list_del(&frame->list);
+        linear_min(num_stas);
+        /* queue_frame: enqueue, rearm */
+        requeue(frame, num_stas, &frame->expires);
+        linear_min(num_stas);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(stations);
+    free(frames);
+    return elapsed_ns(&start, &end) / ROUNDS;
+}
+
+static double bench_heap(int num_stas)
+{
+    struct frame_sched sched;
+    struct timespec start, end;
+    struct wqueue *q;
+    struct frame *frame;
+    int i, j;
+
+    setup(num_stas);
+    sched_init(&sched);
+    for (i = 0; i < num_stas; i++)
+        for (j = 0; j < IEEE80211_NUM_ACS; j++)
+            sched_update(&sched, &stations[i].queues[j]);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ROUNDS; i++) {
+        q = sched_peek(&sched);
+        frame = list_first_entry(&q->frames, struct frame, list);
+        list_del(&frame->list);
+        sched_update(&sched, q);
+        sched_peek(&sched);
+        q = requeue(frame, num_stas, &frame->expires);
+        if (q->sched_idx < 0)
+            sched_update(&sched, q);
+        sched_peek(&sched);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sched_free(&sched);
+    free(stations);
+    free(frames);
+    return elapsed_ns(&start, &end) / ROUNDS;
+}
+
+/* the heap must always agree with the scan on the next expiry */
+static int check_heap(int num_stas)
+{
+    struct frame_sched sched;
+    struct frame *hf, *lf;
+    struct wqueue *q;
+    int i, j, ret = 0;
+
+    setup(num_stas);
+    sched_init(&sched);
+    for (i = 0; i < num_stas; i++)
+        for (j = 0; j < IEEE80211_NUM_ACS; j++)
+            sched_update(&sched, &stations[i].queues[j]);
+
+    for (i = 0; i < ROUNDS / 10; i++) {
+        q = sched_peek(&sched);
+        hf = list_first_entry(&q->frames, struct frame, list);
+        lf = list_first_entry(&linear_min(num_stas)->frames, struct frame, list);
+        if (timespec_before(&hf->expires, &lf->expires) ||
+            timespec_before(&lf->expires, &hf->expires)) {
+            fprintf(stderr, "heap/scan mismatch at round %d\n", i);
+            ret = -1;
+            break;
+        }
+        list_del(&hf->list);
+        sched_update(&sched, q);
+        q = requeue(hf, num_stas, &hf->expires);
+        if (q->sched_idx < 0)
+            sched_update(&sched, q);
+    }
+    sched_free(&sched);
+    free(stations);
+    free(frames);
+    return ret;
+}
+
+int main(void)
+{
+    int sizes[] = {16, 64, 256, 512, 1024, 4096};
+    size_t i;
+
+    if (check_heap(64))
+        return EXIT_FAILURE;
+
+    printf("%8s %16s %16s\n", "stations", "scan [ns/frame]", "heap [ns/frame]");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        printf("%8d %16.1f %16.1f\n", sizes[i],
+               bench_linear(sizes[i]), bench_heap(sizes[i]));
+    return EXIT_SUCCESS;
+}
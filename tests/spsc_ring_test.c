@@ -0,0 +1,113 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+/*
+ * Producer and consumer threads on one spsc_ring: every record must
+ * arrive once, in order and intact, across many buffer wrap-arounds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "../wmediumd/spsc_ring.h"
+
+#define RECORDS 2000000
+#define RING_BYTES 4096
+#define MAX_LEN 700
+
+static struct spsc_ring ring;
+
+/* record @seq: its length and every payload byte derive from @seq */
+static size_t rec_len(uint32_t seq)
+{
+    return sizeof(seq) + (seq * 2654435761u) % MAX_LEN;
+}
+
+static void *producer(void *arg)
+{
+    unsigned char buf[sizeof(uint32_t) + MAX_LEN];
+    uint32_t seq;
+    size_t len, i;
+    int ret;
+
+    for (seq = 0; seq < RECORDS; seq++) {
+        len = rec_len(seq);
+        memcpy(buf, &seq, sizeof(seq));
+        for (i = sizeof(seq); i < len; i++)
+            buf[i] = (unsigned char)(seq + i);
+        while ((ret = spsc_ring_push(&ring, buf, len)) == -ENOSPC)
+            sched_yield();
+        if (ret) {
+            fprintf(stderr, "push %u: %s\n", seq, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    unsigned char *rec;
+    pthread_t thread;
+    uint32_t seq, got;
+    size_t len, i;
+
+    if (spsc_ring_init(&ring, RING_BYTES)) {
+        perror("spsc_ring_init");
+        return EXIT_FAILURE;
+    }
+    if (spsc_ring_push(&ring, NULL, RING_BYTES) != -EMSGSIZE) {
+        fprintf(stderr, "oversized record accepted\n");
+        return EXIT_FAILURE;
+    }
+    pthread_create(&thread, NULL, producer, NULL);
+
+    for (seq = 0; seq < RECORDS; seq++) {
+        while (!(rec = spsc_ring_peek(&ring, &len)))
+            sched_yield();
+        memcpy(&got, rec, sizeof(got));
+        if (got != seq || len != rec_len(seq)) {
+            fprintf(stderr, "record %u: got %u, len %zu\n", seq, got, len);
+            return EXIT_FAILURE;
+        }
+        for (i = sizeof(seq); i < len; i++) {
+            if (rec[i] != (unsigned char)(seq + i)) {
+                fprintf(stderr, "record %u: corrupt at %zu\n", seq, i);
+                return EXIT_FAILURE;
+            }
+        }
+        spsc_ring_pop(&ring);
+    }
+    pthread_join(thread, NULL);
+    if (spsc_ring_peek(&ring, &len)) {
+        fprintf(stderr, "ring not empty\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d records: ok\n", RECORDS);
+    spsc_ring_free(&ring);
+    return EXIT_SUCCESS;
+}
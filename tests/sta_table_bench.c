@@ -0,0 +1,191 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+/*
+ * Station loops that only need the medium id, as in
+ * set_interference_duration() and the interference update of
+ * deliver_expired_frames(): chasing sta_array pointers into struct
+ * station against reading the contiguous sta_table column.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../wmediumd/wmediumd.h"
+
+#define SCANS 20000
+#define NUM_MEDIUMS 4
+
+static struct station **sta_array;
+static struct sta_table tab;
+static struct intf_info *row;
+
+static double elapsed_ms(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static void setup(int num_stas)
+{
+    void **frames;
+    int i;
+
+    sta_array = calloc(num_stas, sizeof(*sta_array));
+    frames = calloc(num_stas, sizeof(*frames));
+    row = calloc(num_stas, sizeof(*row));
+    if (!sta_array || !frames || !row || sta_table_reserve(&tab, num_stas)) {
+        perror("alloc");
+        exit(EXIT_FAILURE);
+    }
+
+    srand48(3);
+    for (i = 0; i < num_stas; i++) {
+        /* frames in flight sit between the stations on the heap */
+        frames[i] = malloc(sizeof(struct frame) + 1500);
+        sta_array[i] = calloc(1, sizeof(struct station));
+        if (!frames[i] || !sta_array[i]) {
+            perror("alloc");
+            exit(EXIT_FAILURE);
+        }
+        sta_array[i]->index = i;
+        sta_array[i]->medium_id = lrand48() % NUM_MEDIUMS;
+        sta_table_set(&tab, sta_array[i]);
+    }
+    for (i = 0; i < num_stas; i++)
+        free(frames[i]);
+    free(frames);
+}
+
+static void teardown(int num_stas)
+{
+    int i;
+
+    for (i = 0; i < num_stas; i++)
+        free(sta_array[i]);
+    free(sta_array);
+    free(row);
+    sta_table_free(&tab);
+}
+
+/* set_interference_duration() before and after */
+static void scan_ptr(int num_stas, int src)
+{
+    int i, medium_id = sta_array[src]->medium_id;
+
+    for (i = 0; i < num_stas; i++) {
+        if (medium_id != sta_array[i]->medium_id)
+            continue;
+        row[i].duration += 100;
+        row[i].signal = -80;
+    }
+}
+
+static void scan_soa(int num_stas, int src)
+{
+    const int *medium = tab.medium_id;
+    int i, medium_id = medium[src];
+
+    for (i = 0; i < num_stas; i++) {
+        if (medium_id != medium[i])
+            continue;
+        row[i].duration += 100;
+        row[i].signal = -80;
+    }
+}
+
+/* pair filter of the interference update, once per 10 ms */
+static long pairs_ptr(int num_stas)
+{
+    long n = 0;
+    int i, j;
+
+    for (i = 0; i < num_stas; i++)
+        for (j = 0; j < num_stas; j++)
+            if (i != j && sta_array[i]->medium_id == sta_array[j]->medium_id)
+                n++;
+    return n;
+}
+
+static long pairs_soa(int num_stas)
+{
+    const int *medium = tab.medium_id;
+    long n = 0;
+    int i, j;
+
+    for (i = 0; i < num_stas; i++)
+        for (j = 0; j < num_stas; j++)
+            if (i != j && medium[i] == medium[j])
+                n++;
+    return n;
+}
+
+static void run(int num_stas)
+{
+    struct timespec start, end;
+    double t_ptr, t_soa;
+    long n_ptr, n_soa;
+    int i;
+
+    setup(num_stas);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < SCANS; i++)
+        scan_ptr(num_stas, i % num_stas);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t_ptr = elapsed_ms(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < SCANS; i++)
+        scan_soa(num_stas, i % num_stas);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t_soa = elapsed_ms(&start, &end);
+
+    printf("%5d stations, medium scan:   %8.1f ns ptr %8.1f ns soa\n",
+           num_stas, t_ptr * 1e6 / SCANS, t_soa * 1e6 / SCANS);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    n_ptr = pairs_ptr(num_stas);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t_ptr = elapsed_ms(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    n_soa = pairs_soa(num_stas);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t_soa = elapsed_ms(&start, &end);
+
+    printf("%5d stations, pair filter:   %8.2f ms ptr %8.2f ms soa\n",
+           num_stas, t_ptr, t_soa);
+
+    teardown(num_stas);
+    if (n_ptr != n_soa) {
+        fprintf(stderr, "pair count mismatch: %ld != %ld\n", n_ptr, n_soa);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    run(1000);
+    run(5000);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+/*
+ * The trace ring: records come back in order with their contents, only
+ * the last capacity of them survive a wrap, a claimed but not yet
+ * committed record is skipped, and data spread over records reads back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../wmediumd/trace.h"
+
+#define CAPACITY 64
+#define RECORDS 1000
+
+static void fill(struct trace_record *rec, uint64_t n)
+{
+    rec->type = TRACE_QUEUED + n % 3;
+    rec->signal = -(int)(n % 90);
+    rec->time_ns = n * 1000;
+    rec->expires_ns = n * 1000 + 500;
+    rec->cookie = n;
+    rec->duration = n * 7;
+    memset(rec->sender, (int)n, sizeof(rec->sender));
+}
+
+static int check(const struct trace *trace, uint64_t n)
+{
+    struct trace_record rec;
+
+    if (!trace_read(trace, n, &rec)) {
+        fprintf(stderr, "record %llu missing\n", (unsigned long long)n);
+        return -1;
+    }
+    if (rec.cookie != n || rec.time_ns != n * 1000 ||
+        rec.expires_ns != n * 1000 + 500 || rec.duration != n * 7 ||
+        rec.type != TRACE_QUEUED + n % 3 || rec.signal != -(int)(n % 90) ||
+        rec.sender[5] != (uint8_t)n) {
+        fprintf(stderr, "record %llu corrupt\n", (unsigned long long)n);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/trace_test.XXXXXX";
+    struct trace writer, reader;
+    struct trace_record *rec, copy;
+    char data[3 * TRACE_DATA_LEN - 5], back[sizeof(data)];
+    uint64_t n;
+    int fd, ret = EXIT_FAILURE;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    if (trace_open(&writer, path, CAPACITY, 42)) {
+        fprintf(stderr, "trace_open failed\n");
+        goto out;
+    }
+    for (n = 0; n < RECORDS; n++) {
+        n = trace_claim(&writer, 1);
+        rec = trace_slot(&writer, n);
+        fill(rec, n);
+        trace_commit(rec, n);
+    }
+    /* claimed, never committed */
+    rec = trace_slot(&writer, trace_claim(&writer, 1));
+    fill(rec, RECORDS);
+
+    if (trace_map(&reader, path)) {
+        fprintf(stderr, "trace_map failed\n");
+        goto out_writer;
+    }
+    if (trace_first(&reader) != RECORDS + 1 - CAPACITY ||
+        trace_end(&reader) != RECORDS + 1) {
+        fprintf(stderr, "wrong range %llu..%llu\n",
+                (unsigned long long)trace_first(&reader),
+                (unsigned long long)trace_end(&reader));
+        goto out_reader;
+    }
+    for (n = trace_first(&reader); n < RECORDS; n++) {
+        if (check(&reader, n))
+            goto out_reader;
+    }
+    if (trace_read(&reader, RECORDS, &copy) ||
+        trace_read(&reader, RECORDS - CAPACITY, &copy)) {
+        fprintf(stderr, "read an uncommitted or overwritten record\n");
+        goto out_reader;
+    }
+    if (reader.hdr->seed != 42) {
+        fprintf(stderr, "wrong seed\n");
+        goto out_reader;
+    }
+
+    for (n = 0; n < sizeof(data); n++)
+        data[n] = (char)n;
+    n = trace_claim(&writer, trace_data_records(sizeof(data)));
+    trace_put_data(&writer, n, data, sizeof(data));
+    if (trace_data_records(sizeof(data)) != 3 ||
+        !trace_get_data(&reader, n, back, sizeof(back)) ||
+        memcmp(data, back, sizeof(data))) {
+        fprintf(stderr, "data did not read back\n");
+        goto out_reader;
+    }
+    printf("trace_test: %d records through a ring of %d\n", RECORDS,
+           CAPACITY);
+    ret = EXIT_SUCCESS;
+out_reader:
+    trace_close(&reader);
+out_writer:
+    trace_close(&writer);
+out:
+    unlink(path);
+    return ret;
+}
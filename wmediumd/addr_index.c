@@ -0,0 +1,151 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wmediumd.h"
+#include "addr_index.h"
+
+#define ADDR_INDEX_MIN_SIZE 16
+
+static inline const u8 *key_of(const struct addr_index *idx,
+			       const struct station *station)
+{
+	return (const u8 *)station + idx->key_off;
+}
+
+static inline unsigned int addr_hash(const u8 *addr, unsigned int mask)
+{
+	u64 v = 0;
+
+	memcpy(&v, addr, ETH_ALEN);
+	/* Fibonacci hashing; the top bits mix all six address bytes */
+	return (unsigned int)((v * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+/* Returns the slot holding @addr, or the empty slot where it belongs */
+static unsigned int find_slot(const struct addr_index *idx, const u8 *addr)
+{
+	unsigned int mask = idx->size - 1;
+	unsigned int i = addr_hash(addr, mask);
+
+	while (idx->slots[i] &&
+	       memcmp(key_of(idx, idx->slots[i]), addr, ETH_ALEN) != 0)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+static int resize(struct addr_index *idx, unsigned int size)
+{
+	struct station **old = idx->slots;
+	unsigned int old_size = idx->size;
+	unsigned int i;
+
+	idx->slots = calloc(size, sizeof(*idx->slots));
+	if (!idx->slots) {
+		idx->slots = old;
+		return -ENOMEM;
+	}
+	idx->size = size;
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i])
+			idx->slots[find_slot(idx, key_of(idx, old[i]))] = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+void addr_index_init(struct addr_index *idx, size_t key_off)
+{
+	idx->slots = NULL;
+	idx->size = 0;
+	idx->used = 0;
+	idx->key_off = key_off;
+}
+
+void addr_index_free(struct addr_index *idx)
+{
+	free(idx->slots);
+	addr_index_init(idx, idx->key_off);
+}
+
+int addr_index_insert(struct addr_index *idx, struct station *station)
+{
+	unsigned int i;
+	int ret;
+
+	/* keep the load factor at or below 1/2 */
+	if ((idx->used + 1) * 2 > idx->size) {
+		ret = resize(idx, idx->size ? idx->size * 2 :
+					      ADDR_INDEX_MIN_SIZE);
+		if (ret)
+			return ret;
+	}
+
+	i = find_slot(idx, key_of(idx, station));
+	if (idx->slots[i])
+		return -EEXIST;
+
+	idx->slots[i] = station;
+	idx->used++;
+	return 0;
+}
+
+void addr_index_remove(struct addr_index *idx, struct station *station)
+{
+	unsigned int mask, i, j, home;
+
+	if (!idx->size)
+		return;
+
+	mask = idx->size - 1;
+	i = find_slot(idx, key_of(idx, station));
+	if (idx->slots[i] != station)
+		return;
+
+	idx->slots[i] = NULL;
+	idx->used--;
+
+	/*
+	 * Backward-shift deletion: move later entries of the probe run
+	 * into the hole unless their home slot lies cyclically in (i, j].
+	 */
+	for (j = (i + 1) & mask; idx->slots[j]; j = (j + 1) & mask) {
+		home = addr_hash(key_of(idx, idx->slots[j]), mask);
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		idx->slots[i] = idx->slots[j];
+		idx->slots[j] = NULL;
+		i = j;
+	}
+}
+
+struct station *addr_index_lookup(const struct addr_index *idx,
+				  const uint8_t *addr)
+{
+	if (!idx->size)
+		return NULL;
+
+	return idx->slots[find_slot(idx, addr)];
+}
@@ -0,0 +1,53 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+#ifndef ADDR_INDEX_H_
+#define ADDR_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct station;
+
+/*
+ * Open-addressing (linear probing) hash table mapping a 6-byte MAC
+ * address embedded in struct station at @key_off to the station.
+ * Keys are unique: the first station inserted for an address wins,
+ * matching the first-match semantics of a list walk.
+ */
+struct addr_index {
+	struct station **slots;
+	unsigned int size;		/* number of slots, power of two */
+	unsigned int used;
+	size_t key_off;
+};
+
+void addr_index_init(struct addr_index *idx, size_t key_off);
+void addr_index_free(struct addr_index *idx);
+
+/* Returns 0, -EEXIST if the address is already indexed, or -ENOMEM */
+int addr_index_insert(struct addr_index *idx, struct station *station);
+
+/* Removes @station if it is the entry indexed under its address */
+void addr_index_remove(struct addr_index *idx, struct station *station);
+struct station *addr_index_lookup(const struct addr_index *idx,
+				  const uint8_t *addr);
+
+#endif /* ADDR_INDEX_H_ */
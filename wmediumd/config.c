@@ -29,6 +29,7 @@
 #include <math.h>
 
 #include "wmediumd.h"
+#include "path_loss.h"
 
 static void string_to_mac_address(const char *str, u8 *addr)
 {
@@ -55,7 +56,9 @@ static int get_link_snr_from_snr_matrix(struct wmediumd *ctx,
 					struct station *sender,
 					struct station *receiver)
 {
-	return ctx->snr_matrix[sender->index * ctx->num_stas + receiver->index];
+	return links_current(&ctx->links)->snr_matrix[sender->index *
+						     ctx->link_stride +
+						     receiver->index];
 }
 
 static double _get_error_prob_from_snr(struct wmediumd *ctx, double snr,
@@ -74,237 +77,28 @@ static double get_error_prob_from_matrix(struct wmediumd *ctx, double snr,
 	if (dst == NULL) // dst is multicast. returned value will not be used.
 		return 0.0;
 
-	return ctx->error_prob_matrix[ctx->num_stas * src->index + dst->index];
+	return links_current(&ctx->links)->error_prob_matrix[ctx->link_stride *
+							     src->index +
+							     dst->index];
 }
 
 int use_fixed_random_value(struct wmediumd *ctx)
 {
-	return ctx->error_prob_matrix != NULL || ctx->station_err_matrix != NULL;
-}
-
-#define FREQ_1CH (2.412e9)		// [Hz]
-#define SPEED_LIGHT (2.99792458e8)	// [meter/sec]
-/*
- * Calculate path loss based on a free-space path loss
- *
- * This function returns path loss [dBm].
- */
-static int calc_path_loss_free_space(void *model_param,
-			  struct station *dst, struct station *src)
-{
-	struct free_space_model_param *param;
-	double PL, d, denominator, numerator, lambda;
-	double f = src->freq * pow(10,6);
-
-	if (f < 0.1)
-		f = FREQ_1CH;
-
-	param = model_param;
-
-	d = sqrt((src->x - dst->x) * (src->x - dst->x) +
-			 (src->y - dst->y) * (src->y - dst->y) +
-			 (src->z - dst->z) * (src->z - dst->z));
-
-	/*
-	 * Calculate PL0 with Free-space path loss in decibels
-	 *
-	 * 20 * log10 * (4 * M_PI * d * f / c)
-	 *   d: distance [meter]
-	 *   f: frequency [Hz]
-	 *   c: speed of light in a vacuum [meter/second]
-	 *
-	 * https://en.wikipedia.org/wiki/Free-space_path_loss
-	 */
-	lambda = SPEED_LIGHT / f;
-	denominator = pow(lambda, 2);
-	numerator = pow((4.0 * M_PI * d), 2) * param->sL;
-	PL = 10.0 * log10(numerator / denominator);
-	return PL;
-}
-/*
- * Calculate path loss based on a log distance model
- *
- * This function returns path loss [dBm].
- */
-static int calc_path_loss_log_distance(void *model_param,
-			  struct station *dst, struct station *src)
-{
-	struct log_distance_model_param *param;
-	double PL, PL0, d;
-	double f = src->freq * pow(10,6);
-
-	if (f < 0.1)
-		f = FREQ_1CH;
+	struct link_matrices *links = links_current(&ctx->links);
 
-	param = model_param;
-
-	d = sqrt((src->x - dst->x) * (src->x - dst->x) +
-		 (src->y - dst->y) * (src->y - dst->y) +
-		 (src->z - dst->z) * (src->z - dst->z));
-
-	/*
-	 * Calculate PL0 with Free-space path loss in decibels
-	 *
-	 * 20 * log10 * (4 * M_PI * d * f / c)
-	 *   d: distance [meter]
-	 *   f: frequency [Hz]
-	 *   c: speed of light in a vacuum [meter/second]
-	 *
-	 * https://en.wikipedia.org/wiki/Free-space_path_loss
-	 */
-	PL0 = 20.0 * log10(4.0 * M_PI * 1.0 * f / SPEED_LIGHT);
-
-	/*
-	 * Calculate signal strength with Log-distance path loss model
-	 * https://en.wikipedia.org/wiki/Log-distance_path_loss_model
-	 */
-	PL = PL0 + 10.0 * param->path_loss_exponent * log10(d) + param->Xg;
-	return PL;
-}
-/*
- * Calculate path loss based on a itu model
- *
- * This function returns path loss [dBm].
- */
-static int calc_path_loss_itu(void *model_param,
-			  struct station *dst, struct station *src)
-{
-	struct itu_model_param *param;
-	double PL, d;
-	double f = src->freq;
-	int N=28, pL;
-
-	if (f < 0.1)
-		f = FREQ_1CH;
-
-	param = model_param;
-	pL = param->pL;
-
-	d = sqrt((src->x - dst->x) * (src->x - dst->x) +
-			 (src->y - dst->y) * (src->y - dst->y) +
-			 (src->z - dst->z) * (src->z - dst->z));
-
-	if (d>16)
-		N=38;
-	if (pL!=0)
-		N=pL;
-	/*
-	 * Calculate signal strength with ITU path loss model
-	 * Power Loss Coefficient Based on the Paper
-     * Site-Specific Validation of ITU Indoor Path Loss Model at 2.4 GHz
-     * from Theofilos Chrysikos, Giannis Georgopoulos and Stavros Kotsopoulos
-     * LF: floor penetration loss factor
-     * nFLOORS: number of floors
-	 */
-
-	PL = 20.0 * log10(f) + N * log10(d) + param->lF * param->nFLOORS - 28;
-	return PL;
-}
-/*
- * Calculate path loss based on a log-normal shadowing model
- *
- * This function returns path loss [dBm].
- */
-static int calc_path_loss_log_normal_shadowing(void *model_param,
-			  struct station *dst, struct station *src)
-{
-	struct log_normal_shadowing_model_param *param;
-	double PL, PL0, d;
-	double f = src->freq * pow(10,6);
-	double gRandom = src->gRandom;
-
-	if (f < 0.1)
-		f = FREQ_1CH;
-
-	param = model_param;
-
-	d = sqrt((src->x - dst->x) * (src->x - dst->x) +
-		 (src->y - dst->y) * (src->y - dst->y) +
-		 (src->z - dst->z) * (src->z - dst->z));
-
-	/*
-	 * Calculate PL0 with Free-space path loss in decibels
-	 *
-	 * 20 * log10 * (4 * M_PI * d * f / c)
-	 *   d: distance [meter]
-	 *   f: frequency [Hz]
-	 *   c: speed of light in a vacuum [meter/second]
-	 *
-	 * https://en.wikipedia.org/wiki/Free-space_path_loss
-	 */
-	PL0 = 20.0 * log10(4.0 * M_PI * 1.0 * f / SPEED_LIGHT);
-
-	/*
-	 * Calculate signal strength with Log-distance path loss model + gRandom (Gaussian random variable)
-	 * https://en.wikipedia.org/wiki/Log-distance_path_loss_model
-	 */
-	PL = PL0 + 10.0 * param->path_loss_exponent * log10(d) - gRandom;
-	return PL;
-}
-/*
- * Calculate path loss based on a two ray ground model
- *
- * This function returns path loss [dBm].
- */
-static int calc_path_loss_two_ray_ground(void *model_param,
-			  struct station *dst, struct station *src)
-{
-	//struct two_ray_ground_model_param *param;
-        double PL, d;
-        double f = 20 * 1000000; //frequency in Hz
-        double lambda = SPEED_LIGHT / f;
-        int ht = 1;
-        int hr = 1;
-        double dCross = (4 * M_PI * ht * hr) / (lambda / 1000);
-
-        //param = model_param;
-        d = sqrt((src->x - dst->x) * (src->x - dst->x) +
-                         (src->y - dst->y) * (src->y - dst->y) +
-                         (src->z - dst->z) * (src->z - dst->z));
-
-        if (d < dCross){
-            PL = calc_path_loss_free_space(model_param, dst, src);
-            return PL;
-        }
-        else{
-            double numerator = src->tx_power * src->gain * dst->gain * pow(ht, 2) * pow(hr, 2);
-            double denominator = pow(d, 4);
-            PL = (numerator / denominator);
-            return PL;
-        }
+	return links->error_prob_matrix != NULL ||
+	       links->station_err_matrix != NULL;
 }
 
 /* Existing link is from from -> to; copy to other dir */
 static void mirror_link(struct wmediumd *ctx, int from, int to)
 {
-	ctx->snr_matrix[ctx->num_stas * to + from] =
-		ctx->snr_matrix[ctx->num_stas * from + to];
+	ctx->snr_matrix[ctx->link_stride * to + from] =
+		ctx->snr_matrix[ctx->link_stride * from + to];
 
 	if (ctx->error_prob_matrix) {
-		ctx->error_prob_matrix[ctx->num_stas * to + from] =
-			ctx->error_prob_matrix[ctx->num_stas * from + to];
-    }
-}
-
-static void recalc_path_loss(struct wmediumd *ctx)
-{
-	int start, end, path_loss, gains, txpower, signal;
-
-	for (start = 0; start < ctx->num_stas; start++) {
-		for (end = 0; end < ctx->num_stas; end++) {
-			if (start == end)
-				continue;
-			txpower = ctx->sta_array[start]->tx_power;
-			if (ctx->sta_array[end]->isap == 1)
-				txpower = ctx->sta_array[end]->tx_power;
-
-			path_loss = ctx->calc_path_loss(ctx->path_loss_param,
-				ctx->sta_array[end], ctx->sta_array[start]);
-			gains = txpower + ctx->sta_array[start]->gain + ctx->sta_array[end]->gain;
-			signal = gains - path_loss - ctx->noise_threshold;
-            ctx->snr_matrix[ctx->num_stas * start + end] = signal;
-            ctx->snr_matrix[ctx->num_stas * end + start] = signal;
-	}
+		ctx->error_prob_matrix[ctx->link_stride * to + from] =
+			ctx->error_prob_matrix[ctx->link_stride * from + to];
     }
 }
 
@@ -313,17 +107,21 @@ static void move_stations_to_direction(struct wmediumd *ctx)
 	struct station *station;
 	struct timespec now;
 
-	clock_gettime(CLOCK_MONOTONIC, &now);
+	w_clock_gettime(ctx, &now);
 	if (!timespec_before(&ctx->next_move, &now))
 		return;
 
+	links_write_begin(ctx);
 	list_for_each_entry(station, &ctx->stations, list) {
 		station->x += station->dir_x;
 		station->y += station->dir_y;
+		station_table_update(ctx, station);
 	}
 	recalc_path_loss(ctx);
+	links_touch_all(ctx);
+	links_write_end(ctx);
 
-	clock_gettime(CLOCK_MONOTONIC, &ctx->next_move);
+	w_clock_gettime(ctx, &ctx->next_move);
 	ctx->next_move.tv_sec += MOVE_INTERVAL;
 }
 
@@ -538,6 +336,7 @@ static int parse_path_loss(struct wmediumd *ctx, config_t *cf)
 			station->isap = config_setting_get_int_elem(
 				isnodeaps, station->index);
 		}
+		station_table_update(ctx, station);
 	}
 
 	recalc_path_loss(ctx);
@@ -584,9 +383,14 @@ int load_config(struct wmediumd *ctx, const char *file, const char *per_file, bo
 	float default_prob_value = 0.0;
 	bool *link_map = NULL;
 
+	/* only set by parse_path_loss() */
+	ctx->calc_path_loss = NULL;
+	ctx->path_loss_param = NULL;
+
 	if (full_dynamic) {
 		ctx->sta_array = malloc(0);
 		ctx->num_stas = 0;
+		ctx->link_stride = 0;
 		ctx->intf = NULL;
 		ctx->get_fading_signal = get_no_fading_signal;
 		ctx->fading_coefficient = 0;
@@ -649,18 +453,31 @@ int load_config(struct wmediumd *ctx, const char *file, const char *per_file, bo
 		station->gRandom = GAUSS_RANDOM_DEFAULT;
 		station->isap = AP_DEFAULT;
 		station->medium_id = MEDIUM_ID_DEFAULT;
+		station->medium = NULL;
 		station_init_queues(station);
+		if (station_index_add(ctx, station)) {
+			w_flogf(ctx, LOG_ERR, stderr, "Out of memory(index)!\n");
+			free(station);
+			return -ENOMEM;
+		}
 		list_add_tail(&station->list, &ctx->stations);
 		ctx->sta_array[i] = station;
 
 		w_logf(ctx, LOG_NOTICE, "Added station %d: " MAC_FMT "\n", i, MAC_ARGS(addr));
 	}
 	ctx->num_stas = count_ids;
+	ctx->link_stride = count_ids;
+	if (station_table_sync(ctx)) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(sta_table)!\n");
+		return -ENOMEM;
+	}
+	if (medium_rebuild(ctx))
+		return -ENOMEM;
 
 	enable_interference = config_lookup(cf, "ifaces.enable_interference");
 	if (enable_interference &&
 	    config_setting_get_bool(enable_interference)) {
-		ctx->intf = calloc(ctx->num_stas * ctx->num_stas,
+		ctx->intf = calloc(ctx->link_stride * ctx->link_stride,
 				   sizeof(struct intf_info));
 		if (!ctx->intf) {
 			w_flogf(ctx, LOG_ERR, stderr, "Out of memory(intf)\n");
@@ -668,7 +485,7 @@ int load_config(struct wmediumd *ctx, const char *file, const char *per_file, bo
 		}
 		for (i = 0; i < ctx->num_stas; i++)
 			for (j = 0; j < ctx->num_stas; j++)
-				ctx->intf[i * ctx->num_stas + j].signal = -200;
+				ctx->intf[i * ctx->link_stride + j].signal = -200;
 	} else {
 		ctx->intf = NULL;
 	}
@@ -736,7 +553,8 @@ int load_config(struct wmediumd *ctx, const char *file, const char *per_file, bo
             for (j = 0; j < count_interfaces; j++) {
                 interface_data = config_setting_get_elem(medium_data, j);
                 station_id = config_setting_get_int(interface_data);
-                ctx->sta_array[station_id]->medium_id = i+1;
+                if (station_set_medium(ctx, ctx->sta_array[station_id], i+1))
+                    goto fail;
             }
         }
     }
@@ -812,16 +630,16 @@ int load_config(struct wmediumd *ctx, const char *file, const char *per_file, bo
 						start, end, snr);
 				goto fail;
 		}
-		ctx->snr_matrix[ctx->num_stas * start + end] = snr;
+		ctx->snr_matrix[ctx->link_stride * start + end] = snr;
 		link_map[ctx->num_stas * start + end] = true;
 	}
 
 	/* initialize with default_prob */
 	for (start = 0; error_probs && start < ctx->num_stas; start++)
 		for (end = start + 1; end < ctx->num_stas; end++) {
-			ctx->error_prob_matrix[ctx->num_stas *
+			ctx->error_prob_matrix[ctx->link_stride *
 				start + end] =
-			ctx->error_prob_matrix[ctx->num_stas *
+			ctx->error_prob_matrix[ctx->link_stride *
 				end + start] = default_prob_value;
 		}
 
@@ -848,7 +666,7 @@ int load_config(struct wmediumd *ctx, const char *file, const char *per_file, bo
 					goto fail;
 			}
 
-			ctx->error_prob_matrix[ctx->num_stas * start + end] =
+			ctx->error_prob_matrix[ctx->link_stride * start + end] =
 				error_prob_value;
 			link_map[ctx->num_stas * start + end] = true;
 	}
@@ -0,0 +1,115 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "epoch.h"
+
+/* the address of this identifies the thread */
+static __thread char self;
+
+/* the slot of the last epoch this thread read under */
+static __thread struct epoch *cached_ep;
+static __thread struct epoch_reader *cached_reader;
+
+void epoch_init(struct epoch *ep)
+{
+	memset(ep, 0, sizeof(*ep));
+	ep->global = 1;
+}
+
+static struct epoch_reader *epoch_reader(struct epoch *ep)
+{
+	struct epoch_reader *reader;
+	int i, n;
+
+	if (cached_ep == ep)
+		return cached_reader;
+
+	n = __atomic_load_n(&ep->num_readers, __ATOMIC_ACQUIRE);
+	for (i = 0; i < n && i < EPOCH_MAX_READERS; i++) {
+		if (__atomic_load_n(&ep->readers[i].owner,
+				    __ATOMIC_RELAXED) == &self)
+			break;
+	}
+	if (i == n || i == EPOCH_MAX_READERS) {
+		i = __atomic_fetch_add(&ep->num_readers, 1, __ATOMIC_ACQ_REL);
+		if (i >= EPOCH_MAX_READERS) {
+			fprintf(stderr, "epoch: more than %d reader threads\n",
+				EPOCH_MAX_READERS);
+			abort();
+		}
+		__atomic_store_n(&ep->readers[i].owner, &self,
+				 __ATOMIC_RELAXED);
+	}
+	reader = &ep->readers[i];
+
+	cached_ep = ep;
+	cached_reader = reader;
+	return reader;
+}
+
+void epoch_read_lock(struct epoch *ep)
+{
+	struct epoch_reader *reader = epoch_reader(ep);
+
+	if (reader->depth++)
+		return;
+	__atomic_store_n(&reader->epoch,
+			 __atomic_load_n(&ep->global, __ATOMIC_RELAXED),
+			 __ATOMIC_RELAXED);
+	/* announce the epoch before loading anything it protects */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_read_unlock(struct epoch *ep)
+{
+	struct epoch_reader *reader = epoch_reader(ep);
+
+	if (--reader->depth)
+		return;
+	__atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_synchronize(struct epoch *ep)
+{
+	uint64_t now, seen;
+	int i, n;
+
+	now = __atomic_add_fetch(&ep->global, 1, __ATOMIC_SEQ_CST);
+	/* order the caller's unpublishing stores before the scan */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	n = __atomic_load_n(&ep->num_readers, __ATOMIC_ACQUIRE);
+	if (n > EPOCH_MAX_READERS)
+		n = EPOCH_MAX_READERS;
+	for (i = 0; i < n; i++) {
+		/* readers that entered after the bump see the new data */
+		while ((seen = __atomic_load_n(&ep->readers[i].epoch,
+					       __ATOMIC_ACQUIRE)) &&
+		       seen < now)
+			sched_yield();
+	}
+}
@@ -0,0 +1,60 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+#include <stdint.h>
+
+/* threads that ever enter a read section, each keeps its slot */
+#define EPOCH_MAX_READERS	128
+
+/*
+ * Epoch based reclamation.  Readers bracket their use of shared data
+ * with epoch_read_lock()/epoch_read_unlock(), which never wait.  A
+ * writer that unpublished some data calls epoch_synchronize(); once it
+ * returns no reader can still be using that data, so it may be freed or
+ * reused.
+ */
+struct epoch_reader {
+	uint64_t epoch;			/* global epoch at entry, 0 outside */
+	int depth;			/* nesting, owner thread only */
+	const void *owner;
+} __attribute__((aligned(64)));
+
+struct epoch {
+	uint64_t global;
+	int num_readers;
+	struct epoch_reader readers[EPOCH_MAX_READERS];
+};
+
+void epoch_init(struct epoch *ep);
+void epoch_read_lock(struct epoch *ep);
+void epoch_read_unlock(struct epoch *ep);
+
+/*
+ * Wait until every reader that was inside a read section has left it.
+ * Must not be called from inside a read section.
+ */
+void epoch_synchronize(struct epoch *ep);
+
+#endif /* EPOCH_H_ */
@@ -0,0 +1,300 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netlink/netlink.h>
+#include <netlink/genl/genl.h>
+#include <event.h>
+
+#include "wmediumd.h"
+#include "wmediumd_dynamic.h"
+#include "fake_hwsim.h"
+
+#define FAKE_HWSIM_SEED		0x5eed
+#define FAKE_HWSIM_PEEK		256	/* enough for any header we look at */
+
+/* frames go out evenly spaced, @rate a second from fh->start */
+static void frame_time(struct fake_hwsim *fh, uint64_t n, struct timespec *t)
+{
+	uint64_t ns = n * 1000000000ULL / fh->rate;
+
+	*t = fh->start;
+	t->tv_sec += ns / 1000000000;
+	t->tv_nsec += ns % 1000000000;
+	if (t->tv_nsec >= 1000000000) {
+		t->tv_sec++;
+		t->tv_nsec -= 1000000000;
+	}
+}
+
+/* make up the next frame and feed it to wmediumd, as the kernel would */
+static void send_frame(struct fake_hwsim *fh)
+{
+	struct wmediumd *ctx = fh->ctx;
+	struct hwsim_tx_rate tx_rates[IEEE80211_TX_MAX_RATES] = {
+		{ 7, 2 }, { 4, 2 }, { 0, 3 }, { -1, 0 },
+	};
+	u8 src[ETH_ALEN], dst[ETH_ALEN];
+	struct ieee80211_hdr *hdr;
+	struct nlattr *frame_attr;
+	struct nl_msg *msg;
+	int n, i, j;
+
+	pthread_rwlock_rdlock(&snr_lock);
+	n = ctx->num_stas;
+	if (n >= 2) {
+		i = nrand48(fh->rand48) % n;
+		j = nrand48(fh->rand48) % (n - 1);
+		if (j >= i)
+			j++;
+		memcpy(src, ctx->sta_array[i]->addr, ETH_ALEN);
+		memcpy(dst, ctx->sta_array[j]->addr, ETH_ALEN);
+	}
+	pthread_rwlock_unlock(&snr_lock);
+	fh->next++;
+	if (n < 2) {
+		fh->skipped++;
+		return;
+	}
+
+	msg = nlmsg_alloc();
+	if (!msg) {
+		w_logf(ctx, LOG_ERR, "Error allocating new message MSG!\n");
+		return;
+	}
+	if (!genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, ctx->family_id, 0,
+			 NLM_F_REQUEST, HWSIM_CMD_FRAME, VERSION_NR) ||
+	    nla_put(msg, HWSIM_ATTR_ADDR_TRANSMITTER, ETH_ALEN, src) ||
+	    nla_put_u32(msg, HWSIM_ATTR_FLAGS, HWSIM_TX_CTL_REQ_TX_STATUS) ||
+	    nla_put(msg, HWSIM_ATTR_TX_INFO, sizeof(tx_rates), tx_rates) ||
+	    nla_put_u64(msg, HWSIM_ATTR_COOKIE, fh->next) ||
+	    nla_put_u32(msg, HWSIM_ATTR_FREQ, 2412) ||
+	    !(frame_attr = nla_reserve(msg, HWSIM_ATTR_FRAME,
+				       FAKE_HWSIM_FRAME_LEN))) {
+		w_logf(ctx, LOG_ERR, "%s: Failed to fill a payload\n", __func__);
+		goto out;
+	}
+	hdr = nla_data(frame_attr);
+	memset(hdr, 0, FAKE_HWSIM_FRAME_LEN);
+	hdr->frame_control[0] = FTYPE_DATA;
+	memcpy(hdr->addr1, dst, ETH_ALEN);
+	memcpy(hdr->addr2, src, ETH_ALEN);
+	memcpy(hdr->addr3, src, ETH_ALEN);
+
+	/* as if it had just come out of recvmmsg() */
+	ctx->rx.stamp_ns = lat_now();
+	fh->sent++;
+	process_nlh(nlmsg_hdr(msg), ctx);
+out:
+	nlmsg_free(msg);
+}
+
+/* copy up to @len bytes at @off of the datagram of @hdr into @buf */
+static size_t gather(const struct msghdr *hdr, size_t off, void *buf,
+		     size_t len)
+{
+	size_t i, n, done = 0;
+
+	for (i = 0; i < hdr->msg_iovlen && done < len; i++) {
+		const struct iovec *iov = &hdr->msg_iov[i];
+
+		if (off >= iov->iov_len) {
+			off -= iov->iov_len;
+			continue;
+		}
+		n = min(iov->iov_len - off, len - done);
+		memcpy((char *)buf + done, (char *)iov->iov_base + off, n);
+		done += n;
+		off = 0;
+	}
+	return done;
+}
+
+/* nl_batch send hook: count what wmediumd sends to the radios */
+static int fake_hwsim_send(void *arg, const struct msghdr *hdr)
+{
+	struct fake_hwsim *fh = arg;
+	uint64_t rx = 0, reports = 0, acked = 0;
+	char buf[FAKE_HWSIM_PEEK] __attribute__((aligned(NLMSG_ALIGNTO)));
+	size_t off = 0, len;
+
+	while ((len = gather(hdr, off, buf, sizeof(buf))) >= NLMSG_HDRLEN) {
+		struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+		struct genlmsghdr *gnlh = nlmsg_data(nlh);
+		struct nlattr *flags;
+
+		if (nlh->nlmsg_len < NLMSG_HDRLEN + GENL_HDRLEN ||
+		    len < NLMSG_HDRLEN + GENL_HDRLEN)
+			break;
+		if (gnlh->cmd == HWSIM_CMD_FRAME) {
+			rx++;
+		} else if (gnlh->cmd == HWSIM_CMD_TX_INFO_FRAME) {
+			reports++;
+			flags = nla_find(genlmsg_attrdata(gnlh, 0),
+					 min(len, nlh->nlmsg_len) -
+					 NLMSG_HDRLEN - GENL_HDRLEN,
+					 HWSIM_ATTR_FLAGS);
+			if (flags && (nla_get_u32(flags) & HWSIM_TX_STAT_ACK))
+				acked++;
+		}
+		off += NLMSG_ALIGN(nlh->nlmsg_len);
+	}
+
+	__atomic_fetch_add(&fh->datagrams, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&fh->rx_frames, rx, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&fh->tx_reports, reports, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&fh->acked, acked, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static void tick_cb(int fd, short what, void *data)
+{
+	struct fake_hwsim *fh = data;
+	struct timeval drain = { .tv_sec = FAKE_HWSIM_DRAIN_SEC };
+	struct timespec now, t;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	while (fh->next < fh->total) {
+		frame_time(fh, fh->next, &t);
+		if (timespec_before(&now, &t))
+			break;
+		send_frame(fh);
+	}
+	if (fh->ctx->shard_workers)
+		shards_wake(fh->ctx);
+
+	if (fh->next == fh->total) {
+		event_del(fh->ev_tick);
+		event_loopexit(&drain);
+	}
+}
+
+static bool source_next(struct frame_source *src, struct timespec *when)
+{
+	struct fake_hwsim *fh = src->priv;
+
+	if (fh->next == fh->total)
+		return false;
+	frame_time(fh, fh->next, when);
+	return true;
+}
+
+static void source_inject(struct frame_source *src, struct wmediumd *ctx)
+{
+	send_frame(src->priv);
+}
+
+int fake_hwsim_init(struct wmediumd *ctx, struct fake_hwsim *fh,
+		    unsigned int rate, unsigned int seconds)
+{
+	memset(fh, 0, sizeof(*fh));
+	fh->ctx = ctx;
+	fh->rate = rate;
+	fh->seconds = seconds;
+	fh->total = (uint64_t)rate * seconds;
+	fh->rand48[0] = 0x330e;
+	fh->rand48[1] = FAKE_HWSIM_SEED & 0xffff;
+	fh->rand48[2] = FAKE_HWSIM_SEED >> 16;
+
+	/* the tx batches still number and address their messages with it */
+	ctx->sock = nl_socket_alloc();
+	if (!ctx->sock) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(fake hwsim)\n");
+		return -ENOMEM;
+	}
+	ctx->family_id = FAKE_HWSIM_FAMILY_ID;
+	return 0;
+}
+
+void fake_hwsim_attach(struct fake_hwsim *fh)
+{
+	struct wmediumd *ctx = fh->ctx;
+	int i;
+
+	for (i = 0; i < ctx->num_shards; i++) {
+		ctx->shards[i].tx_batch.send = fake_hwsim_send;
+		ctx->shards[i].tx_batch.send_arg = fh;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &fh->wall_start);
+}
+
+int fake_hwsim_start(struct fake_hwsim *fh, bool virtual_time)
+{
+	struct wmediumd *ctx = fh->ctx;
+	struct timeval tick = { .tv_usec = FAKE_HWSIM_TICK_MS * 1000 };
+
+	fake_hwsim_attach(fh);
+	w_logf(ctx, LOG_NOTICE, "Fake hwsim: %u frames/s for %u s on %s time\n",
+	       fh->rate, fh->seconds, virtual_time ? "virtual" : "real");
+
+	if (virtual_time) {
+		fh->source.next = source_next;
+		fh->source.inject = source_inject;
+		fh->source.priv = fh;
+		vtime_run(ctx, &fh->source, &fh->start);
+		return 0;
+	}
+
+	fh->ev_tick = calloc(1, sizeof(*fh->ev_tick));
+	if (!fh->ev_tick)
+		return -ENOMEM;
+	fh->start = fh->wall_start;
+	event_set(fh->ev_tick, -1, EV_PERSIST, tick_cb, fh);
+	return event_add(fh->ev_tick, &tick) ? -EINVAL : 0;
+}
+
+void fake_hwsim_report(struct fake_hwsim *fh)
+{
+	struct timespec end;
+	double secs;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = end.tv_sec - fh->wall_start.tv_sec +
+	       (end.tv_nsec - fh->wall_start.tv_nsec) / 1e9;
+	printf("fake hwsim: %llu frames sent (%llu skipped with fewer than "
+	       "two stations), %llu tx reports (%llu acked), "
+	       "%llu frames received, in %llu datagrams\n",
+	       (unsigned long long)fh->sent,
+	       (unsigned long long)fh->skipped,
+	       (unsigned long long)fh->tx_reports,
+	       (unsigned long long)fh->acked,
+	       (unsigned long long)fh->rx_frames,
+	       (unsigned long long)fh->datagrams);
+	printf("fake hwsim: %.3f s, %.0f frames/s\n", secs,
+	       secs > 0 ? fh->tx_reports / secs : 0);
+	if (fh->ctx->source)
+		printf("fake hwsim: %ld.%09ld s of virtual time\n",
+		       (long)(fh->ctx->vnow.tv_sec - fh->start.tv_sec),
+		       fh->ctx->vnow.tv_nsec);
+}
+
+void fake_hwsim_free(struct fake_hwsim *fh)
+{
+	if (fh->ev_tick)
+		event_del(fh->ev_tick);
+	free(fh->ev_tick);
+	fh->ev_tick = NULL;
+}
@@ -0,0 +1,94 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef FAKE_HWSIM_H_
+#define FAKE_HWSIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "vtime.h"
+
+#define FAKE_HWSIM_FAMILY_ID	0x7f00	/* any genl id, nobody else sees it */
+#define FAKE_HWSIM_FRAME_LEN	1000
+#define FAKE_HWSIM_DEFAULT_SECONDS	10
+#define FAKE_HWSIM_TICK_MS	1
+#define FAKE_HWSIM_DRAIN_SEC	1	/* real time left for queued frames */
+
+struct wmediumd;
+struct event;
+
+/*
+ * In-process stand-in for mac80211_hwsim.  It makes up HWSIM_CMD_FRAME
+ * messages from random stations to random other stations and hands them
+ * to process_nlh(), as if read from the socket.  What wmediumd sends back
+ * goes through the shards' tx batches as usual, but into fake_hwsim_send()
+ * instead of the socket, which counts the deliveries and tx reports.
+ *
+ * The traffic is seeded, so every run of a config sends the same frames;
+ * on virtual time the deliveries are the same too.
+ */
+struct fake_hwsim {
+	struct wmediumd *ctx;
+	unsigned int rate;		/* frames per second, all stations */
+	unsigned int seconds;		/* then stop sending */
+	unsigned short rand48[3];
+	uint64_t total;			/* frames to send */
+	uint64_t next;			/* the next of them, for its time */
+	uint64_t sent;			/* handed to process_nlh() */
+	uint64_t skipped;		/* fewer than two stations to pick */
+	struct timespec start;		/* time of frame 0 */
+	struct frame_source source;	/* on virtual time */
+	struct event *ev_tick;		/* on real time */
+	struct timespec wall_start;
+
+	/* counted by whichever thread flushes a tx batch */
+	uint64_t datagrams;
+	uint64_t rx_frames;		/* HWSIM_CMD_FRAME to a radio */
+	uint64_t tx_reports;		/* HWSIM_CMD_TX_INFO_FRAME */
+	uint64_t acked;			/* ... with HWSIM_TX_STAT_ACK */
+};
+
+/*
+ * Set up @fh to send @rate frames per second for @seconds.  Takes the
+ * place of the netlink connection, so it comes before shards_start().
+ */
+int fake_hwsim_init(struct wmediumd *ctx, struct fake_hwsim *fh,
+		    unsigned int rate, unsigned int seconds);
+
+/*
+ * Start sending, after shards_start(): on the main event loop, or with
+ * @virtual_time as the frame source of vtime_run(), which this runs.
+ */
+int fake_hwsim_start(struct fake_hwsim *fh, bool virtual_time);
+
+/*
+ * Take what wmediumd sends, without sending frames of its own; for
+ * trace replay, which feeds in the frames and counts them in sent.
+ */
+void fake_hwsim_attach(struct fake_hwsim *fh);
+
+/* Print what came back, and how fast */
+void fake_hwsim_report(struct fake_hwsim *fh);
+void fake_hwsim_free(struct fake_hwsim *fh);
+
+#endif /* FAKE_HWSIM_H_ */
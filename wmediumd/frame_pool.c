@@ -0,0 +1,161 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "wmediumd.h"
+#include "frame_pool.h"
+
+static const struct {
+	size_t data_size;
+	unsigned int max_free;
+} frame_classes[FRAME_POOL_CLASSES] = {
+	{ FRAME_POOL_SMALL, 4096 },
+	{ FRAME_POOL_MTU, 2048 },
+	{ FRAME_POOL_AMSDU, 256 },
+};
+
+static inline int frame_class(size_t data_len)
+{
+	int i;
+
+	for (i = 0; i < FRAME_POOL_CLASSES; i++) {
+		if (data_len <= frame_classes[i].data_size)
+			return i;
+	}
+	return -1;
+}
+
+void frame_pool_init(struct frame_pool *pool)
+{
+	int i;
+
+	for (i = 0; i < FRAME_POOL_CLASSES; i++) {
+		struct frame_pool_class *cls = &pool->classes[i];
+
+		cls->data_size = frame_classes[i].data_size;
+		cls->max_free = frame_classes[i].max_free;
+		INIT_LIST_HEAD(&cls->free);
+		cls->nfree = 0;
+		cls->allocs = 0;
+		cls->reused = 0;
+		cls->released = 0;
+	}
+	pool->oversize = 0;
+	pool->in_use = 0;
+}
+
+void frame_pool_free(struct frame_pool *pool)
+{
+	struct frame *frame, *tmp;
+	int i;
+
+	for (i = 0; i < FRAME_POOL_CLASSES; i++) {
+		list_for_each_entry_safe(frame, tmp, &pool->classes[i].free,
+					 list) {
+			list_del(&frame->list);
+			free(frame);
+		}
+		pool->classes[i].nfree = 0;
+	}
+}
+
+struct frame *frame_alloc(struct frame_pool *pool, size_t data_len)
+{
+	struct frame_pool_class *cls;
+	struct frame *frame;
+	int idx = frame_class(data_len);
+
+	if (idx < 0) {
+		frame = malloc(sizeof(*frame) + data_len);
+		if (frame) {
+			pool->oversize++;
+			pool->in_use++;
+		}
+		return frame;
+	}
+
+	cls = &pool->classes[idx];
+#ifndef CONFIG_NO_FRAME_POOL
+	if (cls->nfree) {
+		frame = list_first_entry(&cls->free, struct frame, list);
+		list_del(&frame->list);
+		cls->nfree--;
+		cls->reused++;
+		cls->allocs++;
+		pool->in_use++;
+		return frame;
+	}
+	frame = malloc(sizeof(*frame) + cls->data_size);
+#else
+	frame = malloc(sizeof(*frame) + data_len);
+#endif
+	if (!frame)
+		return NULL;
+	cls->allocs++;
+	pool->in_use++;
+	return frame;
+}
+
+/* @frame->data_len must still be the length it was allocated for */
+void frame_free(struct frame_pool *pool, struct frame *frame)
+{
+	struct frame_pool_class *cls;
+	int idx = frame_class(frame->data_len);
+
+	pool->in_use--;
+	if (idx < 0) {
+		free(frame);
+		return;
+	}
+
+	cls = &pool->classes[idx];
+#ifndef CONFIG_NO_FRAME_POOL
+	if (cls->nfree < cls->max_free) {
+		list_add(&frame->list, &cls->free);
+		cls->nfree++;
+		return;
+	}
+#endif
+	cls->released++;
+	free(frame);
+}
+
+void frame_pool_print_stats(struct frame_pool *pool, FILE *out)
+{
+	int i;
+
+#ifdef CONFIG_NO_FRAME_POOL
+	fprintf(out, "frame pool: disabled (malloc)\n");
+#endif
+	fprintf(out, "frame pool: %" PRIu64 " in use, %" PRIu64 " oversize\n",
+		pool->in_use, pool->oversize);
+	for (i = 0; i < FRAME_POOL_CLASSES; i++) {
+		struct frame_pool_class *cls = &pool->classes[i];
+
+		fprintf(out, "  class %5zu: allocs %" PRIu64 " reused %" PRIu64
+			" (%.1f%%) released %" PRIu64 " cached %u/%u\n",
+			cls->data_size, cls->allocs, cls->reused,
+			cls->allocs ? 100.0 * cls->reused / cls->allocs : 0.0,
+			cls->released, cls->nfree, cls->max_free);
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef FRAME_POOL_H_
+#define FRAME_POOL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "list.h"
+
+struct frame;
+
+/* payload capacity of each size class; larger frames go to malloc() */
+#define FRAME_POOL_SMALL	256	/* mgmt, ACK/BA, short control */
+#define FRAME_POOL_MTU		2048	/* 1500-byte MSDUs */
+#define FRAME_POOL_AMSDU	12288	/* A-MSDUs up to the VHT MPDU limit */
+#define FRAME_POOL_CLASSES	3
+
+struct frame_pool_class {
+	size_t data_size;		/* payload bytes per frame */
+	struct list_head free;		/* cached frames, linked by ->list */
+	unsigned int nfree;
+	unsigned int max_free;		/* cache cap, excess is free()d */
+	uint64_t allocs;		/* frame_alloc() calls */
+	uint64_t reused;		/* ... served from the freelist */
+	uint64_t released;		/* frame_free() calls beyond max_free */
+};
+
+/*
+ * Size-classed cache of struct frame allocations.  Not thread-safe: all
+ * users run either on the event loop or under the snr_lock write lock.
+ *
+ * Building with -DCONFIG_NO_FRAME_POOL (make NO_FRAME_POOL=1) turns the
+ * pool into plain malloc()/free() so ASan/valgrind see every frame.
+ */
+struct frame_pool {
+	struct frame_pool_class classes[FRAME_POOL_CLASSES];
+	uint64_t oversize;		/* frames too big for any class */
+	uint64_t in_use;
+};
+
+void frame_pool_init(struct frame_pool *pool);
+void frame_pool_free(struct frame_pool *pool);
+struct frame *frame_alloc(struct frame_pool *pool, size_t data_len);
+void frame_free(struct frame_pool *pool, struct frame *frame);
+void frame_pool_print_stats(struct frame_pool *pool, FILE *out);
+
+#endif /* FRAME_POOL_H_ */
@@ -0,0 +1,160 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wmediumd.h"
+#include "shard.h"
+#include "latency.h"
+
+static const char *const stage_names[LAT_STAGES] = {
+	[LAT_INGEST] = "ingest to queued",
+	[LAT_LATENESS] = "timer lateness",
+	[LAT_DELIVERY] = "delivery per receiver",
+	[LAT_SNR_LOCK] = "snr_lock wait",
+	[LAT_SNR_LOCK_CONTROL] = "snr_lock wait (control)",
+};
+
+void lat_hist_snapshot(struct lat_hist *dst, const struct lat_hist *src)
+{
+	uint64_t max = __atomic_load_n(&src->max_ns, __ATOMIC_RELAXED);
+	unsigned int i;
+
+	dst->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+	dst->sum_ns += __atomic_load_n(&src->sum_ns, __ATOMIC_RELAXED);
+	if (max > dst->max_ns)
+		dst->max_ns = max;
+	for (i = 0; i < LAT_BUCKETS; i++)
+		dst->buckets[i] += __atomic_load_n(&src->buckets[i],
+						   __ATOMIC_RELAXED);
+}
+
+void lat_hist_reset(struct lat_hist *h)
+{
+	unsigned int i;
+
+	/* a concurrent lat_record() may survive in part, which is harmless */
+	__atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->sum_ns, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->max_ns, 0, __ATOMIC_RELAXED);
+	for (i = 0; i < LAT_BUCKETS; i++)
+		__atomic_store_n(&h->buckets[i], 0, __ATOMIC_RELAXED);
+}
+
+uint64_t lat_bucket_low(unsigned int idx)
+{
+	unsigned int group = idx >> LAT_SUB_BITS;
+
+	if (!group)
+		return idx;
+	return (uint64_t)(LAT_SUB + (idx & (LAT_SUB - 1))) << (group - 1);
+}
+
+uint64_t lat_bucket_high(unsigned int idx)
+{
+	if (idx + 1 == LAT_BUCKETS)
+		return UINT64_MAX;
+	return lat_bucket_low(idx + 1) - 1;
+}
+
+uint64_t lat_hist_percentile(const struct lat_hist *h, double q)
+{
+	uint64_t rank, seen = 0, high;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+	/* the rank of the value, counting from 1 */
+	rank = q * h->count + 0.5;
+	if (rank < 1)
+		rank = 1;
+	if (rank > h->count)
+		rank = h->count;
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	if (i == LAT_BUCKETS)
+		return h->max_ns;
+	high = lat_bucket_high(i);
+	return high < h->max_ns ? high : h->max_ns;
+}
+
+void lat_hist_print(const struct lat_hist *h, const char *name, FILE *out)
+{
+	fprintf(out, "%s: %llu, mean %.1f us, p50 %.1f p90 %.1f p99 %.1f "
+		"p99.9 %.1f max %.1f us\n", name,
+		(unsigned long long)h->count,
+		h->count ? h->sum_ns / 1e3 / h->count : 0.0,
+		lat_hist_percentile(h, 0.5) / 1e3,
+		lat_hist_percentile(h, 0.9) / 1e3,
+		lat_hist_percentile(h, 0.99) / 1e3,
+		lat_hist_percentile(h, 0.999) / 1e3,
+		h->max_ns / 1e3);
+}
+
+void latency_collect(struct wmediumd *ctx, struct lat_hist *stages)
+{
+	int i;
+
+	memset(stages, 0, LAT_STAGES * sizeof(*stages));
+	for (i = 0; i < ctx->num_shards; i++) {
+		struct latency *lat = &ctx->shards[i].lat;
+
+		lat_hist_snapshot(&stages[LAT_INGEST], &lat->ingest);
+		lat_hist_snapshot(&stages[LAT_LATENESS], &lat->lateness);
+		lat_hist_snapshot(&stages[LAT_DELIVERY], &lat->delivery);
+		lat_hist_snapshot(&stages[LAT_SNR_LOCK], &lat->snr_lock);
+	}
+	lat_hist_snapshot(&stages[LAT_SNR_LOCK_CONTROL], &ctx->control_lock_wait);
+}
+
+void latency_reset(struct wmediumd *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->num_shards; i++) {
+		struct latency *lat = &ctx->shards[i].lat;
+
+		lat_hist_reset(&lat->ingest);
+		lat_hist_reset(&lat->lateness);
+		lat_hist_reset(&lat->delivery);
+		lat_hist_reset(&lat->snr_lock);
+	}
+	lat_hist_reset(&ctx->control_lock_wait);
+}
+
+void latency_print(struct wmediumd *ctx, FILE *out)
+{
+	struct lat_hist *stages;
+	int i;
+
+	stages = malloc(LAT_STAGES * sizeof(*stages));
+	if (!stages)
+		return;
+	latency_collect(ctx, stages);
+	for (i = 0; i < LAT_STAGES; i++)
+		lat_hist_print(&stages[i], stage_names[i], out);
+	free(stages);
+}
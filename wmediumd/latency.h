@@ -0,0 +1,119 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#define LAT_SUB_BITS	3	/* 8 buckets per power of two, 12.5% wide */
+#define LAT_SUB		(1 << LAT_SUB_BITS)
+#define LAT_BUCKETS	((64 - LAT_SUB_BITS + 1) << LAT_SUB_BITS)
+
+/*
+ * Histogram of ns durations in log-linear buckets, like HdrHistogram:
+ * values below LAT_SUB each have their own bucket, above that every
+ * power of two is split in LAT_SUB.  Recording is a few relaxed atomic
+ * adds, so any thread may record; readers take a lat_hist_snapshot().
+ */
+struct lat_hist {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+	uint64_t buckets[LAT_BUCKETS];
+};
+
+struct wmediumd;
+
+/* The stages of a frame's way through wmediumd, per shard */
+struct latency {
+	struct lat_hist ingest;		/* recvmmsg() until queue_frame() done */
+	struct lat_hist lateness;	/* expiry until the timer pass */
+	struct lat_hist delivery;	/* deliver_frame() per receiver */
+	struct lat_hist snr_lock;	/* waiting for snr_lock */
+};
+
+/* What latency_collect() returns, in this order */
+enum lat_stage {
+	LAT_INGEST,
+	LAT_LATENESS,
+	LAT_DELIVERY,
+	LAT_SNR_LOCK,
+	LAT_SNR_LOCK_CONTROL,	/* the server's and other waits off the shards */
+	LAT_STAGES,
+};
+
+/* CLOCK_MONOTONIC in ns, what the histograms are measured with */
+static inline uint64_t lat_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static inline unsigned int lat_bucket(uint64_t ns)
+{
+	unsigned int e;
+
+	if (ns < LAT_SUB)
+		return ns;
+	e = 63 - __builtin_clzll(ns);
+	return ((e - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+	       ((ns >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+static inline void lat_record(struct lat_hist *h, uint64_t ns)
+{
+	uint64_t max = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&h->buckets[lat_bucket(ns)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->sum_ns, ns, __ATOMIC_RELAXED);
+	while (ns > max &&
+	       !__atomic_compare_exchange_n(&h->max_ns, &max, ns, true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/* Add what @src recorded so far to @dst, which nobody else writes */
+void lat_hist_snapshot(struct lat_hist *dst, const struct lat_hist *src);
+void lat_hist_reset(struct lat_hist *h);
+
+/* Smallest and largest value that land in bucket @idx */
+uint64_t lat_bucket_low(unsigned int idx);
+uint64_t lat_bucket_high(unsigned int idx);
+
+/* Value at or below which a fraction @q of the recorded ones are */
+uint64_t lat_hist_percentile(const struct lat_hist *h, double q);
+
+/* One line of count, mean, percentiles and max of @h, named @name */
+void lat_hist_print(const struct lat_hist *h, const char *name, FILE *out);
+
+/* Sum up the shards' histograms into @stages[LAT_STAGES] */
+void latency_collect(struct wmediumd *ctx, struct lat_hist *stages);
+void latency_reset(struct wmediumd *ctx);
+void latency_print(struct wmediumd *ctx, FILE *out);
+
+#endif /* LATENCY_H_ */
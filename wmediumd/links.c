@@ -0,0 +1,275 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wmediumd.h"
+#include "links.h"
+
+static void *matrix_dup(const void *src, size_t size, int stride)
+{
+	size_t len = size * stride * stride;
+	void *dst;
+
+	if (!src)
+		return NULL;
+	/* at least one entry, so NULL only means out of memory */
+	dst = malloc(len ? len : size);
+	if (dst)
+		memcpy(dst, src, len);
+	return dst;
+}
+
+static void matrices_free(struct link_matrices *m)
+{
+	/* the per-link arrays belong to the writers' copy */
+	free(m->snr_matrix);
+	free(m->error_prob_matrix);
+	free(m->station_err_matrix);
+	m->snr_matrix = NULL;
+	m->error_prob_matrix = NULL;
+	m->station_err_matrix = NULL;
+}
+
+/* a copy of the writers' matrices */
+static int matrices_dup(struct wmediumd *ctx, struct link_matrices *m)
+{
+	int stride = ctx->link_stride;
+
+	m->snr_matrix = matrix_dup(ctx->snr_matrix, sizeof(int), stride);
+	m->error_prob_matrix = matrix_dup(ctx->error_prob_matrix,
+					  sizeof(double), stride);
+	m->station_err_matrix = matrix_dup(ctx->station_err_matrix,
+					   sizeof(double *), stride);
+	if ((ctx->snr_matrix && !m->snr_matrix) ||
+	    (ctx->error_prob_matrix && !m->error_prob_matrix) ||
+	    (ctx->station_err_matrix && !m->station_err_matrix)) {
+		matrices_free(m);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void dirty_reset(struct links *links)
+{
+	links->num_dirty = 0;
+	links->dirty_all = false;
+}
+
+int links_init(struct wmediumd *ctx)
+{
+	struct links *links = &ctx->links;
+
+	memset(links, 0, sizeof(*links));
+	epoch_init(&links->epoch);
+	pthread_mutex_init(&links->writer, NULL);
+
+	if (matrices_dup(ctx, &links->copies[0])) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(links)\n");
+		return -ENOMEM;
+	}
+	links->copies[0].version = 1;
+	links->cur = &links->copies[0];
+	return 0;
+}
+
+void links_free(struct wmediumd *ctx)
+{
+	struct links *links = &ctx->links;
+
+	if (links->cur)
+		matrices_free(links->cur);
+	free(links->dirty);
+	free(links->retired);
+	pthread_mutex_destroy(&links->writer);
+}
+
+int links_reset(struct wmediumd *ctx)
+{
+	struct links *links = &ctx->links;
+	struct link_matrices fresh;
+
+	if (matrices_dup(ctx, &fresh)) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(links)\n");
+		return -ENOMEM;
+	}
+	fresh.version = links->cur->version + 1;
+	matrices_free(links->cur);
+	*links->cur = fresh;
+	links->publishes++;
+	links->full_copies++;
+	return 0;
+}
+
+void links_write_begin(struct wmediumd *ctx)
+{
+	pthread_mutex_lock(&ctx->links.writer);
+}
+
+static void links_touch(struct wmediumd *ctx, int a, int b)
+{
+	struct links *links = &ctx->links;
+	struct link_dirty *dirty;
+
+	if (links->dirty_all)
+		return;
+	if (links->num_dirty == links->dirty_cap) {
+		int cap = links->dirty_cap ? links->dirty_cap * 2 : 16;
+
+		dirty = realloc(links->dirty, cap * sizeof(*dirty));
+		if (!dirty) {
+			/* can't track it, so catch up on everything */
+			links->dirty_all = true;
+			return;
+		}
+		links->dirty = dirty;
+		links->dirty_cap = cap;
+	}
+	links->dirty[links->num_dirty].a = a;
+	links->dirty[links->num_dirty].b = b;
+	links->num_dirty++;
+}
+
+void links_touch_pair(struct wmediumd *ctx, int a, int b)
+{
+	links_touch(ctx, a, b);
+}
+
+void links_touch_station(struct wmediumd *ctx, int a)
+{
+	links_touch(ctx, a, -1);
+}
+
+void links_touch_all(struct wmediumd *ctx)
+{
+	ctx->links.dirty_all = true;
+}
+
+void links_retire(struct wmediumd *ctx, void *ptr)
+{
+	struct links *links = &ctx->links;
+	void **retired;
+
+	if (links->num_retired == links->retired_cap) {
+		int cap = links->retired_cap ? links->retired_cap * 2 : 16;
+
+		retired = realloc(links->retired, cap * sizeof(*retired));
+		if (!retired) {
+			/* readers may still use it: leaking is the safe way */
+			w_flogf(ctx, LOG_ERR, stderr, "Out of memory(links)\n");
+			return;
+		}
+		links->retired = retired;
+		links->retired_cap = cap;
+	}
+	links->retired[links->num_retired++] = ptr;
+}
+
+/*
+ * Bring @dst up to date with @src: @num stations, rows of @stride
+ * entries of @size bytes.
+ */
+static void matrix_catch_up(void *dst, const void *src, size_t size,
+			    int stride, int num, struct links *links)
+{
+	char *d = dst;
+	const char *s = src;
+	size_t off;
+	int i, k, stations = 0;
+
+	if (!dst)
+		return;
+	for (i = 0; i < links->num_dirty; i++)
+		stations += links->dirty[i].b < 0;
+
+	/*
+	 * Entries past @num are set up again before a station gets them, so
+	 * a full catch-up needs just the first @num rows; it is also cheaper
+	 * than walking the columns of most of the stations one by one.
+	 */
+	if (links->dirty_all || 2 * stations >= num) {
+		for (k = 0; k < num; k++) {
+			off = size * stride * k;
+			memcpy(d + off, s + off, size * num);
+		}
+		return;
+	}
+	for (i = 0; i < links->num_dirty; i++) {
+		int a = links->dirty[i].a, b = links->dirty[i].b;
+
+		if (b >= 0) {
+			off = size * ((size_t)stride * a + b);
+			memcpy(d + off, s + off, size);
+			off = size * ((size_t)stride * b + a);
+			memcpy(d + off, s + off, size);
+			continue;
+		}
+		off = size * stride * a;
+		memcpy(d + off, s + off, size * num);
+		for (k = 0; k < num; k++) {
+			off = size * ((size_t)stride * k + a);
+			memcpy(d + off, s + off, size);
+		}
+	}
+}
+
+void links_write_end(struct wmediumd *ctx)
+{
+	struct links *links = &ctx->links;
+	struct link_matrices *old = links->cur;
+	struct link_matrices *next = old == &links->copies[0] ?
+		&links->copies[1] : &links->copies[0];
+	int stride = ctx->link_stride, num = ctx->num_stas, i;
+
+	if (!links->num_dirty && !links->dirty_all && !links->num_retired)
+		goto out;
+
+	next->snr_matrix = ctx->snr_matrix;
+	next->error_prob_matrix = ctx->error_prob_matrix;
+	next->station_err_matrix = ctx->station_err_matrix;
+	next->version = old->version + 1;
+	__atomic_store_n(&links->cur, next, __ATOMIC_RELEASE);
+	epoch_synchronize(&links->epoch);
+
+	/* nobody sees @old any more: catch it up for the next writer */
+	matrix_catch_up(old->snr_matrix, next->snr_matrix, sizeof(int),
+			stride, num, links);
+	matrix_catch_up(old->error_prob_matrix, next->error_prob_matrix,
+			sizeof(double), stride, num, links);
+	matrix_catch_up(old->station_err_matrix, next->station_err_matrix,
+			sizeof(double *), stride, num, links);
+	ctx->snr_matrix = old->snr_matrix;
+	ctx->error_prob_matrix = old->error_prob_matrix;
+	ctx->station_err_matrix = old->station_err_matrix;
+
+	for (i = 0; i < links->num_retired; i++)
+		free(links->retired[i]);
+	links->num_retired = 0;
+	links->publishes++;
+	if (links->dirty_all)
+		links->full_copies++;
+	dirty_reset(links);
+out:
+	pthread_mutex_unlock(&links->writer);
+}
@@ -0,0 +1,116 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#ifndef LINKS_H_
+#define LINKS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+struct wmediumd;
+
+/* One copy of the link matrices, indexed [sender * link_stride + receiver] */
+struct link_matrices {
+	int *snr_matrix;
+	double *error_prob_matrix;
+	double **station_err_matrix;	/* per-link arrays shared by copies */
+	uint64_t version;
+};
+
+/* entries changed in a write section; b < 0: row and column of a */
+struct link_dirty {
+	int a, b;
+};
+
+/*
+ * Link state shared with the data path, kept in two copies.  Readers
+ * use the published copy, which never changes while it is visible.
+ * Writers change the other one, ctx->snr_matrix & co., and
+ * links_write_end() publishes it; once no reader can see the previous
+ * copy any more, the changed entries are copied into it and it becomes
+ * the writers' copy.  A link update thus costs the entries it touches
+ * twice plus a wait for readers to move on, and never blocks them.
+ *
+ * Station positions, powers and gains that the matrices derive from
+ * are only used by writers, under the writer lock.
+ */
+struct links {
+	struct link_matrices *cur;	/* published copy */
+	struct link_matrices copies[2];
+	struct epoch epoch;
+	pthread_mutex_t writer;		/* one write section at a time */
+
+	struct link_dirty *dirty;
+	int num_dirty;
+	int dirty_cap;
+	bool dirty_all;
+	void **retired;			/* freed after the next publish */
+	int num_retired;
+	int retired_cap;
+
+	uint64_t publishes;
+	uint64_t full_copies;		/* catch-ups that copied everything */
+};
+
+/* Share the matrices loaded from the config with the data path */
+int links_init(struct wmediumd *ctx);
+void links_free(struct wmediumd *ctx);
+
+/*
+ * Republish after the matrices were reallocated or reshaped, with no
+ * readers around (snr_lock held for writing).
+ */
+int links_reset(struct wmediumd *ctx);
+
+static inline void links_read_lock(struct links *links)
+{
+	epoch_read_lock(&links->epoch);
+}
+
+static inline void links_read_unlock(struct links *links)
+{
+	epoch_read_unlock(&links->epoch);
+}
+
+/* The published copy; only valid inside a read section */
+static inline struct link_matrices *links_current(struct links *links)
+{
+	return __atomic_load_n(&links->cur, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Write sections may change ctx->snr_matrix, ->error_prob_matrix and
+ * ->station_err_matrix, recording each change with a links_touch_*()
+ * call.  Must not be entered from a read section.
+ */
+void links_write_begin(struct wmediumd *ctx);
+void links_touch_pair(struct wmediumd *ctx, int a, int b);
+void links_touch_station(struct wmediumd *ctx, int a);
+void links_touch_all(struct wmediumd *ctx);
+/* free @ptr, no longer referenced by the writers' copy, once unseen */
+void links_retire(struct wmediumd *ctx, void *ptr);
+void links_write_end(struct wmediumd *ctx);
+
+#endif /* LINKS_H_ */
@@ -0,0 +1,210 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wmediumd.h"
+#include "medium.h"
+
+#define MEDIUM_MIN_CAP 8
+
+void medium_table_init(struct medium_table *tab)
+{
+	tab->mediums = NULL;
+	tab->num = 0;
+}
+
+void medium_table_free(struct medium_table *tab)
+{
+	int i;
+
+	for (i = 0; i < tab->num; i++) {
+		free(tab->mediums[i]->members);
+		free(tab->mediums[i]);
+	}
+	free(tab->mediums);
+	medium_table_init(tab);
+}
+
+/*
+ * The medium for @id: the slot that had it last, else an empty slot,
+ * else a new one.  Keeping ids on empty slots lets medium_rebuild()
+ * refill the same slots without allocating.  Slots are dealt out to
+ * the shards round-robin and keep their shard when reused.
+ */
+static struct medium *medium_get(struct wmediumd *ctx, int id)
+{
+	struct medium_table *tab = &ctx->mediums;
+	struct medium *medium, *empty = NULL, **mediums;
+	int i;
+
+	for (i = 0; i < tab->num; i++) {
+		if (tab->mediums[i]->id == id)
+			return tab->mediums[i];
+		if (!empty && !tab->mediums[i]->num_members)
+			empty = tab->mediums[i];
+	}
+	if (empty) {
+		empty->id = id;
+		memset(empty->last_expires, 0, sizeof(empty->last_expires));
+		return empty;
+	}
+
+	medium = calloc(1, sizeof(*medium));
+	if (!medium)
+		return NULL;
+	mediums = realloc(tab->mediums, (tab->num + 1) * sizeof(*mediums));
+	if (!mediums) {
+		free(medium);
+		return NULL;
+	}
+	medium->id = id;
+	medium->shard = &ctx->shards[tab->num % ctx->num_shards];
+	mediums[tab->num++] = medium;
+	tab->mediums = mediums;
+	return medium;
+}
+
+/* fold the queue tails of @station into the summary of @medium */
+static void medium_add_tails(struct medium *medium, struct station *station)
+{
+	struct frame *tail;
+	int ac;
+
+	for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+		tail = list_last_entry_or_null(&station->queues[ac].frames,
+					       struct frame, list);
+		if (tail)
+			medium_frame_queued(medium, ac, &tail->expires);
+	}
+}
+
+static int medium_join(struct wmediumd *ctx, struct station *station)
+{
+	struct medium *medium;
+	int i, *members;
+
+	medium = medium_get(ctx, station->medium_id);
+	if (!medium)
+		return -ENOMEM;
+
+	if (medium->num_members == medium->cap) {
+		int cap = medium->cap ? medium->cap * 2 : MEDIUM_MIN_CAP;
+
+		members = realloc(medium->members, cap * sizeof(*members));
+		if (!members)
+			return -ENOMEM;
+		medium->members = members;
+		medium->cap = cap;
+	}
+
+	/* keep ascending order, the order of the old full station scans */
+	for (i = medium->num_members; i > 0; i--) {
+		if (medium->members[i - 1] < station->index)
+			break;
+		medium->members[i] = medium->members[i - 1];
+	}
+	medium->members[i] = station->index;
+	medium->num_members++;
+
+	medium_add_tails(medium, station);
+	station->medium = medium;
+	return 0;
+}
+
+static void medium_leave(struct wmediumd *ctx, struct station *station)
+{
+	struct medium *medium = station->medium;
+	int i, j;
+
+	if (!medium)
+		return;
+	station->medium = NULL;
+
+	for (i = 0, j = 0; i < medium->num_members; i++) {
+		if (medium->members[i] != station->index)
+			medium->members[j++] = medium->members[i];
+	}
+	medium->num_members = j;
+
+	/* the leaving station's frames may have set the maximum */
+	memset(medium->last_expires, 0, sizeof(medium->last_expires));
+	for (i = 0; i < medium->num_members; i++)
+		medium_add_tails(medium, ctx->sta_array[medium->members[i]]);
+}
+
+int station_set_medium(struct wmediumd *ctx, struct station *station,
+		       int medium_id)
+{
+	struct shard *from = station_shard(ctx, station);
+	int ret;
+
+	if (station->medium && station->medium_id == medium_id)
+		return 0;
+
+	medium_leave(ctx, station);
+	station->medium_id = medium_id;
+	/*
+	 * Just the medium: detection moves stations from the data path,
+	 * while link writers may be reading the rest of the row.
+	 */
+	ctx->sta_table.medium_id[station->index] = medium_id;
+
+	ret = medium_join(ctx, station);
+	if (ret)
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(medium)\n");
+	if (station_shard(ctx, station) != from)
+		shard_move_station(station, from, station_shard(ctx, station));
+	return ret;
+}
+
+int medium_rebuild(struct wmediumd *ctx)
+{
+	struct medium_table *tab = &ctx->mediums;
+	struct station *station;
+	int i, ret = 0;
+
+	for (i = 0; i < tab->num; i++) {
+		tab->mediums[i]->num_members = 0;
+		memset(tab->mediums[i]->last_expires, 0,
+		       sizeof(tab->mediums[i]->last_expires));
+	}
+
+	/* by index, so every member list is built by appending */
+	for (i = 0; i < ctx->num_stas; i++) {
+		struct shard *from;
+
+		station = ctx->sta_array[i];
+		from = station_shard(ctx, station);
+
+		station->medium = NULL;
+		if (medium_join(ctx, station))
+			ret = -ENOMEM;
+		if (station_shard(ctx, station) != from)
+			shard_move_station(station, from,
+					   station_shard(ctx, station));
+	}
+	if (ret)
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(medium)\n");
+	return ret;
+}
@@ -0,0 +1,77 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef MEDIUM_H_
+#define MEDIUM_H_
+
+#include <time.h>
+
+#include "ieee80211.h"
+
+struct wmediumd;
+struct station;
+
+/*
+ * Stations sharing a medium_id.  last_expires[ac] is the latest expiry
+ * of any frame a member queued on @ac; since frames only leave a queue
+ * once expired, it equals the latest queue tail for every start time
+ * queue_frame() can use.
+ */
+struct medium {
+	int id;
+	int *members;			/* station indices, ascending */
+	int num_members;
+	int cap;
+	struct timespec last_expires[IEEE80211_NUM_ACS];
+	struct shard *shard;		/* owner of the members' queues */
+};
+
+struct medium_table {
+	struct medium **mediums;	/* stable pointers, slots reused */
+	int num;
+};
+
+void medium_table_init(struct medium_table *tab);
+void medium_table_free(struct medium_table *tab);
+
+/* Move @station to @medium_id; returns 0 or -ENOMEM (no medium then) */
+int station_set_medium(struct wmediumd *ctx, struct station *station,
+		       int medium_id);
+
+/*
+ * Recompute all member lists and summaries from the stations, after
+ * a station was deleted or medium ids were set directly.
+ */
+int medium_rebuild(struct wmediumd *ctx);
+
+/* Account a frame queued by a member of @medium */
+static inline void medium_frame_queued(struct medium *medium, int ac,
+				       const struct timespec *expires)
+{
+	struct timespec *last = &medium->last_expires[ac];
+
+	if (last->tv_sec < expires->tv_sec ||
+	    (last->tv_sec == expires->tv_sec &&
+	     last->tv_nsec < expires->tv_nsec))
+		*last = *expires;
+}
+
+#endif /* MEDIUM_H_ */
@@ -0,0 +1,198 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "nl_batch.h"
+
+int nl_batch_init(struct nl_batch *batch, struct nl_sock *sock,
+		  unsigned int max_msgs)
+{
+	batch->sock = sock;
+	batch->seq = nl_socket_use_seq(sock);
+	batch->buf_len = 0;
+	batch->len = 0;
+	batch->niov = 0;
+	batch->nrefs = 0;
+	batch->count = 0;
+	batch->max_msgs = max_msgs ? max_msgs : 1;
+	batch->send = NULL;
+	batch->send_arg = NULL;
+	batch->msgs = 0;
+	batch->syscalls = 0;
+	batch->errors = 0;
+
+	batch->buf = malloc(NL_BATCH_MAX_BYTES);
+	batch->iov = calloc(NL_BATCH_MAX_IOV, sizeof(*batch->iov));
+	batch->refs = calloc(NL_BATCH_MAX_IOV, sizeof(*batch->refs));
+	if (!batch->buf || !batch->iov || !batch->refs) {
+		nl_batch_free(batch);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void drop_refs(struct nl_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < batch->nrefs; i++)
+		nlmsg_free(batch->refs[i]);
+	batch->nrefs = 0;
+}
+
+void nl_batch_free(struct nl_batch *batch)
+{
+	if (batch->refs)
+		drop_refs(batch);
+	free(batch->buf);
+	free(batch->iov);
+	free(batch->refs);
+	batch->buf = NULL;
+	batch->iov = NULL;
+	batch->refs = NULL;
+}
+
+int nl_batch_flush(struct nl_batch *batch)
+{
+	struct sockaddr_nl peer = { .nl_family = AF_NETLINK };
+	struct msghdr hdr = {
+		.msg_name = &peer,
+		.msg_namelen = sizeof(peer),
+		.msg_iov = batch->iov,
+		.msg_iovlen = batch->niov,
+	};
+	int ret = 0;
+
+	if (!batch->count)
+		return 0;
+
+	batch->syscalls++;
+	if (batch->send)
+		ret = batch->send(batch->send_arg, &hdr);
+	else if (sendmsg(nl_socket_get_fd(batch->sock), &hdr, 0) < 0)
+		ret = -errno;
+	if (ret < 0)
+		batch->errors++;
+	batch->msgs += batch->count;
+
+	drop_refs(batch);
+	batch->count = 0;
+	batch->niov = 0;
+	batch->buf_len = 0;
+	batch->len = 0;
+	return ret;
+}
+
+/* make room for @len more bytes, of which @copy go into buf, in 2 iovs */
+static int batch_reserve(struct nl_batch *batch, size_t len, size_t copy)
+{
+	if (batch->len + len > NL_BATCH_MAX_BYTES ||
+	    batch->buf_len + copy > NL_BATCH_MAX_BYTES ||
+	    batch->niov + 2 > NL_BATCH_MAX_IOV)
+		return nl_batch_flush(batch);
+	return 0;
+}
+
+static void batch_copy(struct nl_batch *batch, const void *data,
+		       size_t len, size_t padded)
+{
+	char *dst = batch->buf + batch->buf_len;
+	struct iovec *last = batch->niov ? &batch->iov[batch->niov - 1] : NULL;
+
+	memcpy(dst, data, len);
+	memset(dst + len, 0, padded - len);
+
+	if (last && (char *)last->iov_base + last->iov_len == dst) {
+		last->iov_len += padded;
+	} else {
+		batch->iov[batch->niov].iov_base = dst;
+		batch->iov[batch->niov].iov_len = padded;
+		batch->niov++;
+	}
+	batch->buf_len += padded;
+	batch->len += padded;
+}
+
+static int batch_msg_done(struct nl_batch *batch)
+{
+	if (++batch->count >= batch->max_msgs)
+		return nl_batch_flush(batch);
+	return 0;
+}
+
+static struct nlmsghdr *complete_msg(struct nl_batch *batch,
+				     struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+
+	/*
+	 * A fresh sequence number every time @msg is queued, from the
+	 * batch rather than the socket: batches of different threads
+	 * share the socket.
+	 */
+	nlh->nlmsg_seq = batch->seq++;
+	nl_complete_msg(batch->sock, msg);
+	return nlh;
+}
+
+int nl_batch_add(struct nl_batch *batch, struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh = complete_msg(batch, msg);
+	size_t len = NLMSG_ALIGN(nlh->nlmsg_len);
+	int ret;
+
+	if (len > NL_BATCH_MAX_BYTES)
+		return nl_batch_add_split(batch, msg, 0);
+
+	ret = batch_reserve(batch, len, len);
+	batch_copy(batch, nlh, nlh->nlmsg_len, len);
+	return batch_msg_done(batch) ?: ret;
+}
+
+int nl_batch_add_split(struct nl_batch *batch, struct nl_msg *msg,
+		       size_t head_len)
+{
+	struct nlmsghdr *nlh = complete_msg(batch, msg);
+	size_t len = NLMSG_ALIGN(nlh->nlmsg_len);
+	int ret;
+
+	if (head_len > nlh->nlmsg_len || head_len > NL_BATCH_MAX_BYTES)
+		return -EINVAL;
+
+	ret = batch_reserve(batch, len, head_len);
+	if (head_len)
+		batch_copy(batch, nlh, head_len, head_len);
+
+	/* an oversized message still goes out, as its own datagram */
+	nlmsg_get(msg);
+	batch->refs[batch->nrefs++] = msg;
+	batch->iov[batch->niov].iov_base = (char *)nlh + head_len;
+	batch->iov[batch->niov].iov_len = len - head_len;
+	batch->niov++;
+	batch->len += len - head_len;
+
+	return batch_msg_done(batch) ?: ret;
+}
@@ -0,0 +1,83 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef NL_BATCH_H_
+#define NL_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+
+#define NL_BATCH_DEFAULT_MSGS	256
+#define NL_BATCH_MAX_BYTES	(32 * 1024)
+#define NL_BATCH_MAX_IOV	1024	/* UIO_MAXIOV */
+
+/*
+ * Outgoing netlink messages collected during one event loop pass and
+ * written to the socket with a single sendmsg().  The kernel walks every
+ * nlmsghdr in the datagram, so this is equivalent to sending them one
+ * by one, in order.
+ *
+ * Small messages are copied into buf.  nl_batch_add_split() copies only
+ * the head of a message and references the rest in place, holding a
+ * reference on the nl_msg until the batch is flushed.
+ */
+struct nl_batch {
+	struct nl_sock *sock;
+	uint32_t seq;			/* next nlmsg_seq */
+	char *buf;
+	size_t buf_len;			/* bytes copied into buf */
+	size_t len;			/* total datagram length */
+	struct iovec *iov;
+	int niov;
+	struct nl_msg **refs;		/* messages referenced by iov */
+	int nrefs;
+	unsigned int count;		/* messages in the batch */
+	unsigned int max_msgs;		/* flush when reached; 1 = no batching */
+	/* sends the datagram instead of sendmsg() on sock, if set */
+	int (*send)(void *arg, const struct msghdr *hdr);
+	void *send_arg;
+
+	uint64_t msgs;			/* messages sent */
+	uint64_t syscalls;		/* sendmsg() calls */
+	uint64_t errors;		/* failed sendmsg() calls */
+};
+
+int nl_batch_init(struct nl_batch *batch, struct nl_sock *sock,
+		  unsigned int max_msgs);
+void nl_batch_free(struct nl_batch *batch);
+
+/* Complete @msg and queue a copy of it; the caller still owns @msg. */
+int nl_batch_add(struct nl_batch *batch, struct nl_msg *msg);
+
+/*
+ * Like nl_batch_add(), but only the first @head_len bytes are copied.
+ * The remainder is sent straight from @msg, so the caller may patch
+ * the head and queue @msg again without duplicating the tail.
+ */
+int nl_batch_add_split(struct nl_batch *batch, struct nl_msg *msg,
+		       size_t head_len);
+int nl_batch_flush(struct nl_batch *batch);
+
+#endif /* NL_BATCH_H_ */
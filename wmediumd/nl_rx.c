@@ -0,0 +1,136 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#define _GNU_SOURCE	/* recvmmsg() */
+#include <stdlib.h>
+#include <errno.h>
+
+#include "nl_rx.h"
+#include "latency.h"
+
+int nl_rx_init(struct nl_rx *rx, int fd)
+{
+	int i;
+
+	rx->fd = fd;
+	rx->wakeups = 0;
+	rx->syscalls = 0;
+	rx->datagrams = 0;
+	rx->overruns = 0;
+	rx->truncated = 0;
+	rx->stamp_ns = 0;
+
+	rx->msgs = calloc(NL_RX_VLEN, sizeof(*rx->msgs));
+	rx->iov = calloc(NL_RX_VLEN, sizeof(*rx->iov));
+	rx->bufs = malloc(NL_RX_VLEN * NL_RX_BUF_SIZE);
+	if (!rx->msgs || !rx->iov || !rx->bufs) {
+		nl_rx_free(rx);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < NL_RX_VLEN; i++) {
+		rx->iov[i].iov_base = rx->bufs + i * NL_RX_BUF_SIZE;
+		rx->iov[i].iov_len = NL_RX_BUF_SIZE;
+		rx->msgs[i].msg_hdr.msg_iov = &rx->iov[i];
+		rx->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	return 0;
+}
+
+void nl_rx_free(struct nl_rx *rx)
+{
+	free(rx->msgs);
+	free(rx->iov);
+	free(rx->bufs);
+	rx->msgs = NULL;
+	rx->iov = NULL;
+	rx->bufs = NULL;
+}
+
+int nl_rx_set_rcvbuf(struct nl_rx *rx, int size)
+{
+	socklen_t len = sizeof(size);
+
+	if (setsockopt(rx->fd, SOL_SOCKET, SO_RCVBUFFORCE,
+		       &size, sizeof(size)) &&
+	    setsockopt(rx->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)))
+		return -errno;
+
+	if (getsockopt(rx->fd, SOL_SOCKET, SO_RCVBUF, &size, &len))
+		return -errno;
+	return size;
+}
+
+static void parse_datagram(struct nl_rx *rx, struct mmsghdr *msg,
+			   nl_rx_handler handler, void *arg)
+{
+	struct nlmsghdr *nlh = msg->msg_hdr.msg_iov->iov_base;
+	int len = msg->msg_len;
+
+	rx->datagrams++;
+	if (msg->msg_hdr.msg_flags & MSG_TRUNC) {
+		rx->truncated++;
+		return;
+	}
+
+	for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len))
+		handler(nlh, arg);
+}
+
+/*
+ * Returns the number of datagrams received, or -errno on a socket error
+ * other than EAGAIN/ENOBUFS.
+ */
+int nl_rx_drain(struct nl_rx *rx, nl_rx_handler handler, void *arg)
+{
+	int total = 0, rounds, n, i;
+
+	rx->wakeups++;
+	for (rounds = 0; rounds < NL_RX_MAX_ROUNDS; rounds++) {
+		for (i = 0; i < NL_RX_VLEN; i++)
+			rx->msgs[i].msg_hdr.msg_flags = 0;
+
+		rx->syscalls++;
+		n = recvmmsg(rx->fd, rx->msgs, NL_RX_VLEN, MSG_DONTWAIT, NULL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				/* messages were lost, but the queue is intact */
+				rx->overruns++;
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+
+		rx->stamp_ns = lat_now();
+		for (i = 0; i < n; i++)
+			parse_datagram(rx, &rx->msgs[i], handler, arg);
+		total += n;
+
+		/* short read: the socket is empty */
+		if (n < NL_RX_VLEN)
+			break;
+	}
+	return total;
+}
@@ -0,0 +1,68 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef NL_RX_H_
+#define NL_RX_H_
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#define NL_RX_DEFAULT_RCVBUF	(4 * 1024 * 1024)
+#define NL_RX_VLEN		32		/* datagrams per recvmmsg() */
+#define NL_RX_BUF_SIZE		(16 * 1024)	/* largest hwsim frame msg */
+#define NL_RX_MAX_ROUNDS	64		/* recvmmsg() calls per wakeup */
+
+/*
+ * Bulk receive side of the hwsim netlink socket: each wakeup drains the
+ * socket with recvmmsg() until it would block and hands every nlmsghdr
+ * found to a callback, bypassing libnl's one-datagram-per-call receive.
+ */
+struct mmsghdr;
+
+struct nl_rx {
+	int fd;
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	char *bufs;
+
+	uint64_t wakeups;
+	uint64_t syscalls;		/* recvmmsg() calls */
+	uint64_t datagrams;
+	uint64_t overruns;		/* ENOBUFS: kernel dropped messages */
+	uint64_t truncated;		/* datagrams larger than NL_RX_BUF_SIZE */
+	uint64_t stamp_ns;		/* lat_now() of the last recvmmsg() */
+};
+
+typedef void (*nl_rx_handler)(struct nlmsghdr *nlh, void *arg);
+
+int nl_rx_init(struct nl_rx *rx, int fd);
+void nl_rx_free(struct nl_rx *rx);
+
+/*
+ * Try SO_RCVBUFFORCE (needs CAP_NET_ADMIN), then SO_RCVBUF, which the
+ * kernel caps at net.core.rmem_max.  Returns the resulting buffer size
+ * or -errno.
+ */
+int nl_rx_set_rcvbuf(struct nl_rx *rx, int size);
+int nl_rx_drain(struct nl_rx *rx, nl_rx_handler handler, void *arg);
+
+#endif /* NL_RX_H_ */
@@ -0,0 +1,513 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "wmediumd.h"
+#include "path_loss.h"
+
+#define FREQ_1CH (2.412e9)		// [Hz]
+#define SPEED_LIGHT (2.99792458e8)	// [meter/sec]
+/*
+ * Calculate path loss based on a free-space path loss
+ *
+ * This function returns path loss [dBm].
+ */
+static int free_space_dist(void *model_param, struct station *dst,
+		struct station *src, double d)
+{
+	struct free_space_model_param *param;
+	double PL, denominator, numerator, lambda;
+	double f = src->freq * pow(10,6);
+
+	if (f < 0.1)
+		f = FREQ_1CH;
+
+	param = model_param;
+
+	/*
+	 * Calculate PL0 with Free-space path loss in decibels
+	 *
+	 * 20 * log10 * (4 * M_PI * d * f / c)
+	 *   d: distance [meter]
+	 *   f: frequency [Hz]
+	 *   c: speed of light in a vacuum [meter/second]
+	 *
+	 * https://en.wikipedia.org/wiki/Free-space_path_loss
+	 */
+	lambda = SPEED_LIGHT / f;
+	denominator = pow(lambda, 2);
+	numerator = pow((4.0 * M_PI * d), 2) * param->sL;
+	PL = 10.0 * log10(numerator / denominator);
+	return PL;
+}
+/*
+ * Calculate path loss based on a log distance model
+ *
+ * This function returns path loss [dBm].
+ */
+static int log_distance_dist(void *model_param, struct station *dst,
+		struct station *src, double d)
+{
+	struct log_distance_model_param *param;
+	double PL, PL0;
+	double f = src->freq * pow(10,6);
+
+	if (f < 0.1)
+		f = FREQ_1CH;
+
+	param = model_param;
+
+	/*
+	 * Calculate PL0 with Free-space path loss in decibels
+	 *
+	 * 20 * log10 * (4 * M_PI * d * f / c)
+	 *   d: distance [meter]
+	 *   f: frequency [Hz]
+	 *   c: speed of light in a vacuum [meter/second]
+	 *
+	 * https://en.wikipedia.org/wiki/Free-space_path_loss
+	 */
+	PL0 = 20.0 * log10(4.0 * M_PI * 1.0 * f / SPEED_LIGHT);
+
+	/*
+	 * Calculate signal strength with Log-distance path loss model
+	 * https://en.wikipedia.org/wiki/Log-distance_path_loss_model
+	 */
+	PL = PL0 + 10.0 * param->path_loss_exponent * log10(d) + param->Xg;
+	return PL;
+}
+/*
+ * Calculate path loss based on a itu model
+ *
+ * This function returns path loss [dBm].
+ */
+static int itu_dist(void *model_param, struct station *dst,
+		struct station *src, double d)
+{
+	struct itu_model_param *param;
+	double PL;
+	double f = src->freq;
+	int N=28, pL;
+
+	if (f < 0.1)
+		f = FREQ_1CH;
+
+	param = model_param;
+	pL = param->pL;
+
+	if (d>16)
+		N=38;
+	if (pL!=0)
+		N=pL;
+	/*
+	 * Calculate signal strength with ITU path loss model
+	 * Power Loss Coefficient Based on the Paper
+     * Site-Specific Validation of ITU Indoor Path Loss Model at 2.4 GHz
+     * from Theofilos Chrysikos, Giannis Georgopoulos and Stavros Kotsopoulos
+     * LF: floor penetration loss factor
+     * nFLOORS: number of floors
+	 */
+
+	PL = 20.0 * log10(f) + N * log10(d) + param->lF * param->nFLOORS - 28;
+	return PL;
+}
+/*
+ * Calculate path loss based on a log-normal shadowing model
+ *
+ * This function returns path loss [dBm].
+ */
+static int log_normal_shadowing_dist(void *model_param, struct station *dst,
+		struct station *src, double d)
+{
+	struct log_normal_shadowing_model_param *param;
+	double PL, PL0;
+	double f = src->freq * pow(10,6);
+	double gRandom = src->gRandom;
+
+	if (f < 0.1)
+		f = FREQ_1CH;
+
+	param = model_param;
+
+	/*
+	 * Calculate PL0 with Free-space path loss in decibels
+	 *
+	 * 20 * log10 * (4 * M_PI * d * f / c)
+	 *   d: distance [meter]
+	 *   f: frequency [Hz]
+	 *   c: speed of light in a vacuum [meter/second]
+	 *
+	 * https://en.wikipedia.org/wiki/Free-space_path_loss
+	 */
+	PL0 = 20.0 * log10(4.0 * M_PI * 1.0 * f / SPEED_LIGHT);
+
+	/*
+	 * Calculate signal strength with Log-distance path loss model + gRandom (Gaussian random variable)
+	 * https://en.wikipedia.org/wiki/Log-distance_path_loss_model
+	 */
+	PL = PL0 + 10.0 * param->path_loss_exponent * log10(d) - gRandom;
+	return PL;
+}
+/*
+ * Calculate path loss based on a two ray ground model
+ *
+ * This function returns path loss [dBm].
+ */
+static int two_ray_ground_dist(void *model_param, struct station *dst,
+		struct station *src, double d)
+{
+	//struct two_ray_ground_model_param *param;
+        double PL;
+        double f = 20 * 1000000; //frequency in Hz
+        double lambda = SPEED_LIGHT / f;
+        int ht = 1;
+        int hr = 1;
+        double dCross = (4 * M_PI * ht * hr) / (lambda / 1000);
+
+        //param = model_param;
+
+        if (d < dCross){
+            PL = free_space_dist(model_param, dst, src, d);
+            return PL;
+        }
+        else{
+            double numerator = src->tx_power * src->gain * dst->gain * pow(ht, 2) * pow(hr, 2);
+            double denominator = pow(d, 4);
+            PL = (numerator / denominator);
+            return PL;
+        }
+}
+
+static inline double station_distance(struct station *dst,
+				      struct station *src)
+{
+	return sqrt((src->x - dst->x) * (src->x - dst->x) +
+		    (src->y - dst->y) * (src->y - dst->y) +
+		    (src->z - dst->z) * (src->z - dst->z));
+}
+
+int calc_path_loss_free_space(void *model_param,
+			      struct station *dst, struct station *src)
+{
+	return free_space_dist(model_param, dst, src,
+			       station_distance(dst, src));
+}
+
+int calc_path_loss_log_distance(void *model_param,
+				struct station *dst, struct station *src)
+{
+	return log_distance_dist(model_param, dst, src,
+				 station_distance(dst, src));
+}
+
+int calc_path_loss_itu(void *model_param,
+		       struct station *dst, struct station *src)
+{
+	return itu_dist(model_param, dst, src, station_distance(dst, src));
+}
+
+int calc_path_loss_log_normal_shadowing(void *model_param,
+					struct station *dst,
+					struct station *src)
+{
+	return log_normal_shadowing_dist(model_param, dst, src,
+					 station_distance(dst, src));
+}
+
+int calc_path_loss_two_ray_ground(void *model_param,
+				  struct station *dst, struct station *src)
+{
+	return two_ray_ground_dist(model_param, dst, src,
+				   station_distance(dst, src));
+}
+
+typedef int (*path_loss_dist_fn)(void *, struct station *, struct station *,
+				 double);
+
+/* the distance-taking form of each model, for the bulk kernels */
+static path_loss_dist_fn model_dist_fn(struct wmediumd *ctx)
+{
+	if (ctx->calc_path_loss == calc_path_loss_free_space)
+		return free_space_dist;
+	if (ctx->calc_path_loss == calc_path_loss_log_distance)
+		return log_distance_dist;
+	if (ctx->calc_path_loss == calc_path_loss_itu)
+		return itu_dist;
+	if (ctx->calc_path_loss == calc_path_loss_log_normal_shadowing)
+		return log_normal_shadowing_dist;
+	if (ctx->calc_path_loss == calc_path_loss_two_ray_ground)
+		return two_ray_ground_dist;
+	return NULL;
+}
+
+/*
+ * Distance kernels: d[i] = |s - p[i]| over structure-of-arrays
+ * coordinates.  The vector versions perform the same IEEE operations in
+ * the same order as station_distance() (sqrt is correctly rounded in
+ * every variant), so all of them produce bit-identical distances.
+ */
+typedef void (*distance_fn)(const double *x, const double *y,
+			    const double *z, int n, double sx, double sy,
+			    double sz, double *d);
+
+static void distances_scalar(const double *x, const double *y,
+			     const double *z, int n, double sx, double sy,
+			     double sz, double *d)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		d[i] = sqrt((sx - x[i]) * (sx - x[i]) +
+			    (sy - y[i]) * (sy - y[i]) +
+			    (sz - z[i]) * (sz - z[i]));
+}
+
+#ifdef __SSE2__
+static void distances_sse2(const double *x, const double *y,
+			   const double *z, int n, double sx, double sy,
+			   double sz, double *d)
+{
+	__m128d vx = _mm_set1_pd(sx), vy = _mm_set1_pd(sy);
+	__m128d vz = _mm_set1_pd(sz);
+	__m128d dx, dy, dz;
+	int i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		dx = _mm_sub_pd(vx, _mm_loadu_pd(x + i));
+		dy = _mm_sub_pd(vy, _mm_loadu_pd(y + i));
+		dz = _mm_sub_pd(vz, _mm_loadu_pd(z + i));
+		_mm_storeu_pd(d + i, _mm_sqrt_pd(
+			_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx),
+					      _mm_mul_pd(dy, dy)),
+				   _mm_mul_pd(dz, dz))));
+	}
+	distances_scalar(x + i, y + i, z + i, n - i, sx, sy, sz, d + i);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx")))
+static void distances_avx(const double *x, const double *y,
+			  const double *z, int n, double sx, double sy,
+			  double sz, double *d)
+{
+	__m256d vx = _mm256_set1_pd(sx), vy = _mm256_set1_pd(sy);
+	__m256d vz = _mm256_set1_pd(sz);
+	__m256d dx, dy, dz;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		dx = _mm256_sub_pd(vx, _mm256_loadu_pd(x + i));
+		dy = _mm256_sub_pd(vy, _mm256_loadu_pd(y + i));
+		dz = _mm256_sub_pd(vz, _mm256_loadu_pd(z + i));
+		_mm256_storeu_pd(d + i, _mm256_sqrt_pd(
+			_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx),
+						    _mm256_mul_pd(dy, dy)),
+				      _mm256_mul_pd(dz, dz))));
+	}
+	distances_scalar(x + i, y + i, z + i, n - i, sx, sy, sz, d + i);
+}
+#endif
+
+static distance_fn distances;
+
+int path_loss_set_isa(enum path_loss_isa isa)
+{
+	switch (isa) {
+	case PATH_LOSS_ISA_AUTO:
+#if defined(__x86_64__) || defined(__i386__)
+		if (__builtin_cpu_supports("avx"))
+			return path_loss_set_isa(PATH_LOSS_ISA_AVX);
+#endif
+#ifdef __SSE2__
+		return path_loss_set_isa(PATH_LOSS_ISA_SSE2);
+#endif
+		/* fall through */
+	case PATH_LOSS_ISA_SCALAR:
+		distances = distances_scalar;
+		return 0;
+	case PATH_LOSS_ISA_SSE2:
+#ifdef __SSE2__
+		distances = distances_sse2;
+		return 0;
+#endif
+		break;
+	case PATH_LOSS_ISA_AVX:
+#if defined(__x86_64__) || defined(__i386__)
+		if (__builtin_cpu_supports("avx")) {
+			distances = distances_avx;
+			return 0;
+		}
+#endif
+		break;
+	}
+	return -ENOTSUP;
+}
+
+void path_loss_distances(const double *x, const double *y, const double *z,
+			 int n, double sx, double sy, double sz, double *d)
+{
+	if (!distances)
+		path_loss_set_isa(PATH_LOSS_ISA_AUTO);
+	distances(x, y, z, n, sx, sy, sz, d);
+}
+
+void path_loss_soa_init(struct path_loss_soa *soa)
+{
+	soa->d = NULL;
+	soa->cap = 0;
+}
+
+void path_loss_soa_free(struct path_loss_soa *soa)
+{
+	free(soa->d);
+	path_loss_soa_init(soa);
+}
+
+/* size the distance scratch row for num_stas stations */
+static int soa_reserve(struct wmediumd *ctx)
+{
+	struct path_loss_soa *soa = &ctx->path_loss_soa;
+	double *d;
+
+	if (ctx->num_stas <= soa->cap)
+		return 0;
+	d = realloc(soa->d, ctx->num_stas * sizeof(double));
+	if (!d)
+		return -ENOMEM;
+	soa->d = d;
+	soa->cap = ctx->num_stas;
+	return 0;
+}
+
+/*
+ * Signal of the link between stations @a and @b, a > b.  The matrix is
+ * symmetric and, as the full recalculation always did, the value stored
+ * for both directions is the one computed with the higher index as the
+ * transmitter.
+ */
+static inline int link_signal(struct wmediumd *ctx, int a, int b,
+			      int path_loss)
+{
+	const struct sta_table *tab = &ctx->sta_table;
+	int txpower, gains;
+
+	txpower = tab->tx_power[a];
+	if (tab->isap[b] == 1)
+		txpower = tab->tx_power[b];
+
+	gains = txpower + tab->gain[a] + tab->gain[b];
+	return gains - path_loss - ctx->noise_threshold;
+}
+
+static inline void set_link(struct wmediumd *ctx, int a, int b, int signal)
+{
+	ctx->snr_matrix[ctx->link_stride * a + b] = signal;
+	ctx->snr_matrix[ctx->link_stride * b + a] = signal;
+}
+
+/* set link (a, b), a > b, from its distance */
+static inline void set_link_dist(struct wmediumd *ctx, path_loss_dist_fn fn,
+				 int a, int b, double d)
+{
+	struct station *start = ctx->sta_array[a];
+	struct station *end = ctx->sta_array[b];
+
+	set_link(ctx, a, b, link_signal(ctx, a, b,
+		 fn(ctx->path_loss_param, end, start, d)));
+}
+
+static inline void set_link_pair(struct wmediumd *ctx, int a, int b)
+{
+	struct station *start = ctx->sta_array[a];
+	struct station *end = ctx->sta_array[b];
+
+	set_link(ctx, a, b, link_signal(ctx, a, b,
+		 ctx->calc_path_loss(ctx->path_loss_param, end, start)));
+}
+
+void recalc_path_loss(struct wmediumd *ctx)
+{
+	struct path_loss_soa *soa = &ctx->path_loss_soa;
+	const struct sta_table *tab = &ctx->sta_table;
+	path_loss_dist_fn fn = model_dist_fn(ctx);
+	int start, end;
+
+	if (!ctx->calc_path_loss)
+		return;
+
+	if (!fn || soa_reserve(ctx)) {
+		for (start = 1; start < ctx->num_stas; start++)
+			for (end = 0; end < start; end++)
+				set_link_pair(ctx, start, end);
+		return;
+	}
+
+	/* row by row, lower triangle: distances of start to [0, start) */
+	for (start = 1; start < ctx->num_stas; start++) {
+		path_loss_distances(tab->x, tab->y, tab->z, start,
+				    tab->x[start], tab->y[start], tab->z[start],
+				    soa->d);
+		for (end = 0; end < start; end++)
+			set_link_dist(ctx, fn, start, end, soa->d[end]);
+	}
+}
+
+/*
+ * Only the row and column of @station depend on its position, tx power,
+ * gain and gaussian random value; recompute those 2N - 2 entries.
+ */
+void recalc_path_loss_station(struct wmediumd *ctx, struct station *station)
+{
+	struct path_loss_soa *soa = &ctx->path_loss_soa;
+	const struct sta_table *tab = &ctx->sta_table;
+	path_loss_dist_fn fn = model_dist_fn(ctx);
+	int idx = station->index;
+	int other;
+
+	/* SNR matrix or dynamic mode: links are set explicitly */
+	if (!ctx->calc_path_loss)
+		return;
+
+	if (!fn || soa_reserve(ctx)) {
+		for (other = 0; other < ctx->num_stas; other++) {
+			if (other < idx)
+				set_link_pair(ctx, idx, other);
+			else if (other > idx)
+				set_link_pair(ctx, other, idx);
+		}
+		return;
+	}
+
+	path_loss_distances(tab->x, tab->y, tab->z, ctx->num_stas, tab->x[idx],
+			    tab->y[idx], tab->z[idx], soa->d);
+	for (other = 0; other < ctx->num_stas; other++) {
+		if (other < idx)
+			set_link_dist(ctx, fn, idx, other, soa->d[other]);
+		else if (other > idx)
+			set_link_dist(ctx, fn, other, idx, soa->d[other]);
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef PATH_LOSS_H_
+#define PATH_LOSS_H_
+
+struct wmediumd;
+struct station;
+
+/*
+ * Scratch for the bulk distance kernels, which read the coordinates
+ * straight from ctx->sta_table.
+ */
+struct path_loss_soa {
+	double *d;			/* distances of one row */
+	int cap;
+};
+
+enum path_loss_isa {
+	PATH_LOSS_ISA_AUTO,		/* best the CPU supports */
+	PATH_LOSS_ISA_SCALAR,
+	PATH_LOSS_ISA_SSE2,
+	PATH_LOSS_ISA_AVX,
+};
+
+int calc_path_loss_free_space(void *model_param,
+			      struct station *dst, struct station *src);
+int calc_path_loss_log_distance(void *model_param,
+				struct station *dst, struct station *src);
+int calc_path_loss_itu(void *model_param,
+		       struct station *dst, struct station *src);
+int calc_path_loss_log_normal_shadowing(void *model_param,
+					struct station *dst,
+					struct station *src);
+int calc_path_loss_two_ray_ground(void *model_param,
+				  struct station *dst, struct station *src);
+
+void path_loss_soa_init(struct path_loss_soa *soa);
+void path_loss_soa_free(struct path_loss_soa *soa);
+
+/*
+ * Select the distance kernel used by the recalc functions.  Returns
+ * -ENOTSUP if this build or CPU lacks @isa.
+ */
+int path_loss_set_isa(enum path_loss_isa isa);
+
+/* d[i] = distance between (sx, sy, sz) and (x[i], y[i], z[i]) */
+void path_loss_distances(const double *x, const double *y, const double *z,
+			 int n, double sx, double sy, double sz, double *d);
+
+/*
+ * Recompute the whole SNR matrix from positions and the path loss model.
+ * Positions, tx power and gains are read from ctx->sta_table.
+ */
+void recalc_path_loss(struct wmediumd *ctx);
+
+/* Recompute only the links of @station, after it moved or changed power */
+void recalc_path_loss_station(struct wmediumd *ctx, struct station *station);
+
+#endif /* PATH_LOSS_H_ */
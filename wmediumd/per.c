@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "wmediumd.h"
 
@@ -207,9 +208,10 @@ static double mqam_ber(int m, double snr_db)
 }
 
 /*
- * Compute packet (frame) error rate given a length
+ * Compute the probability that a bit is left uncorrected by the
+ * convolutional code (union bound over the first ten distances).
  */
-static double per(double ber, enum fec_rate rate, int frame_len)
+static double prob_uncorrected(double ber, enum fec_rate rate)
 {
 	/* free distances for each fec_rate */
 	int d_free[] = { 10, 6, 5 };
@@ -258,16 +260,37 @@ static double per(double ber, enum fec_rate rate, int frame_len)
 	if (prob_uncorrected > 1)
 		prob_uncorrected = 1;
 
-	return 1.0 - pow(1 - prob_uncorrected, 8 * frame_len);
+	return prob_uncorrected;
 }
 
-double get_error_prob_from_snr(double snr, unsigned int rate_idx, u32 freq,
-							   int frame_len)
+/*
+ * Probability that a single bit of a frame is received correctly at
+ * @snr dB with rateset[rate_idx]; a frame survives with q^(8 * len).
+ */
+static double bit_success_prob(double snr, unsigned int rate_idx)
 {
-	int m;
-	enum fec_rate fec;
+	int m = rateset[rate_idx].mqam;
 	double ber;
 
+	if (m == 2)
+		ber = bpsk_ber(snr);
+	else
+		ber = mqam_ber(m, snr);
+
+	return 1 - prob_uncorrected(ber, rateset[rate_idx].fec);
+}
+
+/*
+ * Compute packet (frame) error rate given a length
+ */
+static inline double per(double q, int frame_len)
+{
+	return 1.0 - pow(q, 8 * frame_len);
+}
+
+double get_error_prob_from_snr_analytic(double snr, unsigned int rate_idx,
+					u32 freq, int frame_len)
+{
 	if (snr <= 0.0)
 		return 1.0;
 
@@ -277,15 +300,104 @@ double get_error_prob_from_snr(double snr, unsigned int rate_idx, u32 freq,
 	if (rate_idx >= rate_len)
 		return 1.0;
 
-	m = rateset[rate_idx].mqam;
-	fec = rateset[rate_idx].fec;
+	return per(bit_success_prob(snr, rate_idx), frame_len);
+}
 
-	if (m == 2)
-		ber = bpsk_ber(snr);
-	else
-		ber = mqam_ber(m, snr);
+/*
+ * bit_success_prob() for every integer SNR in [1, PER_TABLE_SNR_MAX]
+ * and every rate.  Only the frame length is left to the caller, so
+ * lookups give the same result as the analytic path, bit for bit, and
+ * cost one pow() instead of erfc() and the union bound series.
+ */
+#define PER_TABLE_SNR_MAX 100
+
+static double per_table[PER_TABLE_SNR_MAX + 1][ARRAY_SIZE(rateset)];
+static pthread_once_t per_table_once = PTHREAD_ONCE_INIT;
+
+static void per_table_init(void)
+{
+	size_t rate_idx;
+	int snr;
+
+	for (snr = 1; snr <= PER_TABLE_SNR_MAX; snr++)
+		for (rate_idx = 0; rate_idx < rate_len; rate_idx++)
+			per_table[snr][rate_idx] =
+				bit_success_prob(snr, rate_idx);
+}
+
+/*
+ * Memo of the final 1 - q^(8 * len) for tabulated SNRs.  The result is
+ * a pure function of (snr, rate, len), so entries never go stale when
+ * positions, the SNR matrix or interference change -- those only pick
+ * a different key -- and the cache needs no invalidation hooks and no
+ * per-link state.  It is thread-local and direct-mapped, so a miss just
+ * overwrites the slot.
+ */
+#define PER_MEMO_BITS	12
+#define PER_MEMO_VALID	(1U << 31)
+
+struct per_memo_entry {
+	uint32_t key;
+	double per;
+};
+
+static __thread struct per_memo_entry per_memo[1 << PER_MEMO_BITS];
+
+static double per_memoized(int snr, unsigned int rate_idx, int frame_len,
+			   double q)
+{
+	struct per_memo_entry *e;
+	uint32_t key;
+
+	/* all but the 100% success case need pow() */
+	if (q == 1.0)
+		return 0.0;
+	if (frame_len < 0 || frame_len > 0xffff)
+		return per(q, frame_len);
+
+	key = PER_MEMO_VALID | (uint32_t)snr << 20 | rate_idx << 16 |
+	      frame_len;
+	e = &per_memo[(key * 0x9e3779b1U) >> (32 - PER_MEMO_BITS)];
+	if (e->key != key) {
+		e->key = key;
+		e->per = per(q, frame_len);
+	}
+	return e->per;
+}
+
+double get_error_prob_from_snr(double snr, unsigned int rate_idx, u32 freq,
+							   int frame_len)
+{
+	double q;
+
+	if (snr <= 0.0)
+		return 1.0;
+
+	if (freq > 5000)
+		    rate_idx += 4;
+
+	if (rate_idx >= rate_len)
+		return 1.0;
+
+	pthread_once(&per_table_once, per_table_init);
+
+	if (snr > PER_TABLE_SNR_MAX) {
+		/*
+		 * The error probability only falls with SNR; once the bit
+		 * success probability rounds to 1 it stays there.
+		 */
+		q = per_table[PER_TABLE_SNR_MAX][rate_idx];
+		if (q != 1.0)
+			q = bit_success_prob(snr, rate_idx);
+	} else if (snr != (int)snr) {
+		/* fractional SNR: not tabulated */
+		q = bit_success_prob(snr, rate_idx);
+	} else {
+		q = per_table[(int)snr][rate_idx];
+		return per_memoized((int)snr, rate_idx, frame_len, q);
+	}
 
-	return per(ber, fec, frame_len);
+	return per(q, frame_len);
 }
 
 static double get_error_prob_from_per_matrix(struct wmediumd *ctx, double snr,
@@ -0,0 +1,247 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "wmediumd.h"
+#include "fake_hwsim.h"
+#include "replay.h"
+
+int replay_open(struct replay *rp, const char *path, bool paced)
+{
+	int ret;
+
+	memset(rp, 0, sizeof(*rp));
+	rp->sock[0] = rp->sock[1] = -1;
+	rp->paced = paced;
+	ret = trace_map(&rp->trace, path);
+	if (ret)
+		return ret;
+	rp->next = trace_first(&rp->trace);
+	rp->end = trace_end(&rp->trace);
+	return 0;
+}
+
+uint64_t replay_seed(struct replay *rp)
+{
+	return rp->trace.hdr->seed;
+}
+
+static int reserve_buf(struct replay *rp, size_t len)
+{
+	u8 *buf;
+
+	if (len <= rp->buf_len)
+		return 0;
+	buf = realloc(rp->buf, len);
+	if (!buf)
+		return -ENOMEM;
+	rp->buf = buf;
+	rp->buf_len = len;
+	return 0;
+}
+
+/* hold the input until the wall clock is as far as the recording was */
+static void pace(struct replay *rp, uint64_t time_ns)
+{
+	struct timespec now, target;
+	uint64_t now_ns, target_ns;
+
+	target_ns = timespec_to_ns(&rp->wall_start) + time_ns -
+		    timespec_to_ns(&rp->start);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns = timespec_to_ns(&now);
+	if (now_ns >= target_ns) {
+		if (now_ns - target_ns > rp->max_lag_ns)
+			rp->max_lag_ns = now_ns - target_ns;
+		return;
+	}
+	ns_to_timespec(target_ns, &target);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target,
+			       NULL) == EINTR)
+		;
+}
+
+static bool source_next(struct frame_source *src, struct timespec *when)
+{
+	struct replay *rp = src->priv;
+	uint64_t n;
+
+	while (!rp->have_rec && rp->next < rp->end) {
+		n = rp->next++;
+		if (!trace_read(&rp->trace, n, &rp->rec)) {
+			rp->incomplete++;
+			continue;
+		}
+		if (rp->rec.type != TRACE_INGRESS &&
+		    rp->rec.type != TRACE_CONTROL)
+			continue;
+		rp->rec_pos = n;
+		rp->have_rec = true;
+	}
+	if (!rp->have_rec)
+		return false;
+	ns_to_timespec(rp->rec.time_ns, when);
+	return true;
+}
+
+static void inject_frame(struct replay *rp, struct wmediumd *ctx)
+{
+	struct trace_record *rec = &rp->rec;
+	struct hwsim_tx_rate tx_rates[IEEE80211_TX_MAX_RATES];
+	size_t len = min(rec->data_len, TRACE_HEADER_BYTES);
+	int i, count = 0;
+
+	if (reserve_buf(rp, rec->data_len)) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(replay)\n");
+		return;
+	}
+	if (!trace_get_data(&rp->trace, rp->rec_pos + 1, rp->buf, len)) {
+		rp->incomplete++;
+		return;
+	}
+	/* just the header was recorded, nothing looks past it */
+	memset(rp->buf + len, 0, rec->data_len - len);
+
+	for (i = 0; i < TRACE_MAX_RATES; i++) {
+		tx_rates[i].idx = rec->rates[i].idx;
+		tx_rates[i].count = rec->rates[i].count;
+		if (tx_rates[i].idx >= 0)
+			count = i + 1;
+	}
+
+	if (rp->paced)
+		pace(rp, rec->time_ns);
+	rp->frames++;
+	if (vtime_queue_frame(ctx, rp->buf, rec->data_len, rec->flags,
+			      tx_rates, count, rec->cookie, rec->freq))
+		rp->unknown++;
+	else
+		rp->fh->sent++;
+}
+
+static void inject_request(struct replay *rp, struct wmediumd *ctx)
+{
+	struct trace_record *rec = &rp->rec;
+	char drain[4096];
+	int ret;
+
+	if (!rec->data_len)
+		return;
+	if (reserve_buf(rp, rec->data_len)) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(replay)\n");
+		return;
+	}
+	if (!trace_get_data(&rp->trace, rp->rec_pos + 1, rp->buf,
+			    rec->data_len)) {
+		rp->incomplete++;
+		return;
+	}
+
+	if (rp->paced)
+		pace(rp, rec->time_ns);
+	rp->requests++;
+	ret = handle_request(&rp->req, rp->buf, rec->data_len);
+	if (ret == WACTION_ERROR)
+		w_logf(ctx, LOG_WARNING, "Replayed request of type %d "
+		       "failed\n", rp->buf[0]);
+	/* nobody waits for the responses */
+	send_responses(&rp->req);
+	while (recv(rp->sock[1], drain, sizeof(drain), MSG_DONTWAIT) > 0)
+		;
+}
+
+static void source_inject(struct frame_source *src, struct wmediumd *ctx)
+{
+	struct replay *rp = src->priv;
+
+	rp->have_rec = false;
+	if (rp->rec.type == TRACE_INGRESS)
+		inject_frame(rp, ctx);
+	else
+		inject_request(rp, ctx);
+}
+
+int replay_run(struct replay *rp, struct wmediumd *ctx,
+	       struct fake_hwsim *fh)
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, rp->sock))
+		return -errno;
+	if (fcntl(rp->sock[0], F_SETFL, O_NONBLOCK))
+		return -errno;
+	rp->ctx = ctx;
+	rp->fh = fh;
+	rp->req.ctx = ctx;
+	rp->req.sock_fd = rp->sock[0];
+	INIT_LIST_HEAD(&rp->req.list);
+
+	if (rp->next != 0)
+		w_logf(ctx, LOG_WARNING, "Trace wrapped, replaying only its "
+		       "last %llu records\n",
+		       (unsigned long long)(rp->end - rp->next));
+	rp->source.next = source_next;
+	rp->source.inject = source_inject;
+	rp->source.priv = rp;
+	if (!source_next(&rp->source, &rp->start))
+		return 0;
+
+	fake_hwsim_attach(fh);
+	fh->start = rp->start;
+	rp->wall_start = fh->wall_start;
+	w_logf(ctx, LOG_NOTICE, "Replaying records %llu to %llu%s\n",
+	       (unsigned long long)rp->rec_pos,
+	       (unsigned long long)rp->end - 1,
+	       rp->paced ? " at the recorded pace" : "");
+	vtime_run(ctx, &rp->source, &rp->start);
+	return 0;
+}
+
+void replay_report(struct replay *rp)
+{
+	printf("replay: %llu frames, %llu requests, %llu frames from "
+	       "unknown stations, %llu records incomplete\n",
+	       (unsigned long long)rp->frames,
+	       (unsigned long long)rp->requests,
+	       (unsigned long long)rp->unknown,
+	       (unsigned long long)rp->incomplete);
+	if (rp->paced)
+		printf("replay: at most %.3f ms behind the recording\n",
+		       rp->max_lag_ns / 1e6);
+}
+
+void replay_free(struct replay *rp)
+{
+	if (rp->sock[0] >= 0)
+		close(rp->sock[0]);
+	if (rp->sock[1] >= 0)
+		close(rp->sock[1]);
+	free(rp->buf);
+	rp->buf = NULL;
+	free(rp->req.wbuf);
+	rp->req.wbuf = NULL;
+	trace_close(&rp->trace);
+}
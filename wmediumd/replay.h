@@ -0,0 +1,93 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "trace.h"
+#include "vtime.h"
+#include "wserver.h"
+
+struct wmediumd;
+struct fake_hwsim;
+
+/*
+ * Replay of what a trace file (-w) recorded coming in: the frames from
+ * the radios and the wserver requests, fed to queue_frame_data() and
+ * handle_request() at their recorded times, on virtual time.  Given the
+ * config and the random seed of the recording, every replay makes the
+ * same delivery decisions, so the traces of two replays can be compared
+ * to check a change to the data path; the throughput is what the CPU
+ * allows.  Paced, the frames go in no faster than they were recorded.
+ *
+ * A recording that ran on real time is only reproduced as closely as
+ * its deliveries happened at their expiry, and one that lost its start
+ * to the ring wrapping is not reproduced at all; replays of either are
+ * still the same as each other.
+ */
+struct replay {
+	struct wmediumd *ctx;
+	struct trace trace;
+	uint64_t next;			/* position of the next record */
+	uint64_t end;
+	struct trace_record rec;	/* the next input, if have_rec */
+	uint64_t rec_pos;
+	bool have_rec;
+	bool paced;
+	u8 *buf;
+	size_t buf_len;
+	struct request_ctx req;		/* replayed requests come from here */
+	int sock[2];			/* and their responses go there */
+	struct fake_hwsim *fh;		/* takes what wmediumd sends */
+	struct frame_source source;
+	struct timespec start;		/* of the first input */
+	struct timespec wall_start;
+
+	uint64_t frames;
+	uint64_t requests;
+	uint64_t unknown;		/* frames from stations not there */
+	uint64_t incomplete;		/* records overwritten or half written */
+	uint64_t max_lag_ns;		/* paced: behind the recording */
+};
+
+/* Map the trace file at @path; returns 0 or -errno */
+int replay_open(struct replay *rp, const char *path, bool paced);
+
+/* The random seed the trace was recorded with */
+uint64_t replay_seed(struct replay *rp);
+
+/*
+ * Replay the whole trace, after shards_start() and fake_hwsim_init(),
+ * which @fh stands in for the radios with.  Needs a single shard
+ * without workers, like vtime_run().
+ */
+int replay_run(struct replay *rp, struct wmediumd *ctx,
+	       struct fake_hwsim *fh);
+
+/* Print what was replayed, and how fast */
+void replay_report(struct replay *rp);
+void replay_free(struct replay *rp);
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,157 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "wmediumd.h"
+#include "sched.h"
+
+#define SCHED_MIN_CAP 64
+
+static inline bool ts_before(const struct timespec *t1,
+			     const struct timespec *t2)
+{
+	return t1->tv_sec < t2->tv_sec ||
+	       (t1->tv_sec == t2->tv_sec && t1->tv_nsec < t2->tv_nsec);
+}
+
+static inline bool entry_before(struct sched_entry *a, struct sched_entry *b)
+{
+	return ts_before(&a->expires, &b->expires);
+}
+
+static inline void entry_set(struct frame_sched *sched, int idx,
+			     struct sched_entry *entry)
+{
+	sched->heap[idx] = *entry;
+	entry->queue->sched_idx = idx;
+}
+
+static void sift_up(struct frame_sched *sched, int idx)
+{
+	struct sched_entry entry = sched->heap[idx];
+	int parent;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (!entry_before(&entry, &sched->heap[parent]))
+			break;
+		entry_set(sched, idx, &sched->heap[parent]);
+		idx = parent;
+	}
+	entry_set(sched, idx, &entry);
+}
+
+static void sift_down(struct frame_sched *sched, int idx)
+{
+	struct sched_entry entry = sched->heap[idx];
+	int child;
+
+	while ((child = 2 * idx + 1) < sched->len) {
+		if (child + 1 < sched->len &&
+		    entry_before(&sched->heap[child + 1], &sched->heap[child]))
+			child++;
+		if (!entry_before(&sched->heap[child], &entry))
+			break;
+		entry_set(sched, idx, &sched->heap[child]);
+		idx = child;
+	}
+	entry_set(sched, idx, &entry);
+}
+
+void sched_init(struct frame_sched *sched)
+{
+	sched->heap = NULL;
+	sched->len = 0;
+	sched->cap = 0;
+}
+
+void sched_free(struct frame_sched *sched)
+{
+	free(sched->heap);
+	sched_init(sched);
+}
+
+void sched_remove(struct frame_sched *sched, struct wqueue *queue)
+{
+	int idx = queue->sched_idx;
+
+	if (idx < 0)
+		return;
+
+	queue->sched_idx = -1;
+	if (--sched->len == idx)
+		return;
+
+	entry_set(sched, idx, &sched->heap[sched->len]);
+	if (idx > 0 && entry_before(&sched->heap[idx],
+				    &sched->heap[(idx - 1) / 2]))
+		sift_up(sched, idx);
+	else
+		sift_down(sched, idx);
+}
+
+int sched_update(struct frame_sched *sched, struct wqueue *queue)
+{
+	struct frame *head;
+	struct sched_entry *entry;
+	struct timespec old;
+
+	head = list_first_entry_or_null(&queue->frames, struct frame, list);
+	if (!head) {
+		sched_remove(sched, queue);
+		return 0;
+	}
+
+	if (queue->sched_idx >= 0) {
+		entry = &sched->heap[queue->sched_idx];
+		old = entry->expires;
+		entry->expires = head->expires;
+		if (ts_before(&head->expires, &old))
+			sift_up(sched, queue->sched_idx);
+		else
+			sift_down(sched, queue->sched_idx);
+		return 0;
+	}
+
+	if (sched->len == sched->cap) {
+		int cap = sched->cap ? sched->cap * 2 : SCHED_MIN_CAP;
+		struct sched_entry *heap;
+
+		heap = realloc(sched->heap, cap * sizeof(*heap));
+		if (!heap)
+			return -ENOMEM;
+		sched->heap = heap;
+		sched->cap = cap;
+	}
+
+	entry = &sched->heap[sched->len];
+	entry->expires = head->expires;
+	entry->queue = queue;
+	queue->sched_idx = sched->len++;
+	sift_up(sched, queue->sched_idx);
+	return 0;
+}
+
+struct wqueue *sched_peek(struct frame_sched *sched)
+{
+	return sched->len ? sched->heap[0].queue : NULL;
+}
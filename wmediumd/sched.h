@@ -0,0 +1,55 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <time.h>
+
+struct wqueue;
+
+struct sched_entry {
+	struct timespec expires;	/* expiry of the queue's head frame */
+	struct wqueue *queue;
+};
+
+/*
+ * Binary min-heap holding every non-empty wqueue, keyed on the expiry
+ * of its head frame.  The top of the heap is the next frame to deliver.
+ */
+struct frame_sched {
+	struct sched_entry *heap;
+	int len;
+	int cap;
+};
+
+void sched_init(struct frame_sched *sched);
+void sched_free(struct frame_sched *sched);
+
+/*
+ * Must be called whenever the head of @queue changed (frame added to an
+ * empty queue or head frame removed).  Inserts, re-keys or removes the
+ * queue as needed.  Returns 0 or -ENOMEM.
+ */
+int sched_update(struct frame_sched *sched, struct wqueue *queue);
+void sched_remove(struct frame_sched *sched, struct wqueue *queue);
+struct wqueue *sched_peek(struct frame_sched *sched);
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,311 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <event.h>
+
+#include "wmediumd.h"
+#include "wmediumd_dynamic.h"
+#include "shard.h"
+
+/* ring records a worker handles per snr_lock read-side section */
+#define SHARD_LOCK_BATCH	256
+
+static __thread unsigned short *thread_rand48;
+
+double w_drand48(void)
+{
+	return thread_rand48 ? erand48(thread_rand48) : drand48();
+}
+
+int shards_init(struct wmediumd *ctx, int num)
+{
+	int i;
+
+	ctx->shards = calloc(num, sizeof(*ctx->shards));
+	if (!ctx->shards)
+		return -ENOMEM;
+	ctx->num_shards = num;
+	ctx->shard_workers = false;
+
+	for (i = 0; i < num; i++) {
+		struct shard *shard = &ctx->shards[i];
+
+		shard->ctx = ctx;
+		shard->id = i;
+		shard->timerfd = -1;
+		shard->wake_fd = -1;
+		sched_init(&shard->sched);
+		frame_pool_init(&shard->frame_pool);
+	}
+	return 0;
+}
+
+void shards_free(struct wmediumd *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->num_shards; i++) {
+		struct shard *shard = &ctx->shards[i];
+
+		nl_batch_free(&shard->tx_batch);
+		sched_free(&shard->sched);
+		frame_pool_free(&shard->frame_pool);
+		spsc_ring_free(&shard->ring);
+		if (shard->timerfd >= 0)
+			close(shard->timerfd);
+		if (shard->wake_fd >= 0)
+			close(shard->wake_fd);
+		if (shard->base) {
+			event_del(shard->ev_wake);
+			event_del(shard->ev_timer);
+			event_base_free(shard->base);
+		}
+		free(shard->ev_wake);
+		free(shard->ev_timer);
+	}
+	free(ctx->shards);
+	ctx->shards = NULL;
+	ctx->num_shards = 0;
+}
+
+static void flush(struct shard *shard)
+{
+	if (nl_batch_flush(&shard->tx_batch) < 0)
+		w_logf(shard->ctx, LOG_ERR, "%s: nl_batch_flush failed\n",
+		       __func__);
+}
+
+static void worker_timer_cb(int fd, short what, void *data)
+{
+	struct shard *shard = data;
+	uint64_t u;
+
+	snr_rdlock(&shard->lat.snr_lock);
+	links_read_lock(&shard->ctx->links);
+	read(fd, &u, sizeof(u));
+	deliver_expired_frames(shard);
+	rearm_timer(shard);
+	links_read_unlock(&shard->ctx->links);
+	pthread_rwlock_unlock(&snr_lock);
+
+	flush(shard);
+}
+
+static void worker_wake_cb(int fd, short what, void *data)
+{
+	struct shard *shard = data;
+	uint64_t *ingest_ns;
+	uint64_t u;
+	size_t len;
+	int n;
+
+	read(fd, &u, sizeof(u));
+	if (__atomic_load_n(&shard->stop, __ATOMIC_ACQUIRE)) {
+		event_base_loopbreak(shard->base);
+		return;
+	}
+
+	/*
+	 * Drop the lock now and then so station changes get through, and
+	 * leave the read section so link updates don't wait for long.
+	 */
+	do {
+		snr_rdlock(&shard->lat.snr_lock);
+		links_read_lock(&shard->ctx->links);
+		for (n = 0; n < SHARD_LOCK_BATCH; n++) {
+			/* see shard_dispatch() */
+			ingest_ns = spsc_ring_peek(&shard->ring, &len);
+			if (!ingest_ns)
+				break;
+			shard_queue_nlh(shard, (struct nlmsghdr *)(ingest_ns + 1),
+					*ingest_ns);
+			spsc_ring_pop(&shard->ring);
+		}
+		links_read_unlock(&shard->ctx->links);
+		pthread_rwlock_unlock(&snr_lock);
+	} while (n == SHARD_LOCK_BATCH);
+
+	flush(shard);
+}
+
+static void *worker_main(void *data)
+{
+	struct shard *shard = data;
+
+	thread_rand48 = shard->rand48;
+	event_base_dispatch(shard->base);
+	return NULL;
+}
+
+static int start_worker(struct shard *shard)
+{
+	int ret;
+
+	ret = spsc_ring_init(&shard->ring, SHARD_RING_BYTES);
+	if (ret)
+		return ret;
+
+	shard->wake_fd = eventfd(0, EFD_NONBLOCK);
+	shard->base = event_base_new();
+	shard->ev_wake = calloc(1, sizeof(*shard->ev_wake));
+	shard->ev_timer = calloc(1, sizeof(*shard->ev_timer));
+	if (shard->wake_fd < 0 || !shard->base || !shard->ev_wake || !shard->ev_timer)
+		return -ENOMEM;
+
+	event_set(shard->ev_wake, shard->wake_fd, EV_READ | EV_PERSIST,
+		  worker_wake_cb, shard);
+	event_base_set(shard->base, shard->ev_wake);
+	event_add(shard->ev_wake, NULL);
+	event_set(shard->ev_timer, shard->timerfd, EV_READ | EV_PERSIST,
+		  worker_timer_cb, shard);
+	event_base_set(shard->base, shard->ev_timer);
+	event_add(shard->ev_timer, NULL);
+
+	/* seeded from the global generator, so -j runs stay seedable */
+	shard->rand48[0] = lrand48();
+	shard->rand48[1] = lrand48();
+	shard->rand48[2] = lrand48();
+
+	return -pthread_create(&shard->thread, NULL, worker_main, shard);
+}
+
+int shards_start(struct wmediumd *ctx, bool workers, unsigned int batch_msgs)
+{
+	int i, ret;
+
+	for (i = 0; i < ctx->num_shards; i++) {
+		struct shard *shard = &ctx->shards[i];
+
+		if (nl_batch_init(&shard->tx_batch, ctx->sock, batch_msgs))
+			return -ENOMEM;
+		shard->timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+		if (shard->timerfd < 0)
+			return -errno;
+		w_clock_gettime(ctx, &shard->intf_updated);
+	}
+	if (!workers)
+		return 0;
+
+	ctx->shard_workers = true;
+	for (i = 0; i < ctx->num_shards; i++) {
+		ret = start_worker(&ctx->shards[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+void shards_stop(struct wmediumd *ctx)
+{
+	uint64_t one = 1;
+	int i;
+
+	if (!ctx->shard_workers)
+		return;
+
+	for (i = 0; i < ctx->num_shards; i++) {
+		struct shard *shard = &ctx->shards[i];
+
+		__atomic_store_n(&shard->stop, true, __ATOMIC_RELEASE);
+		write(shard->wake_fd, &one, sizeof(one));
+		pthread_join(shard->thread, NULL);
+	}
+	ctx->shard_workers = false;
+}
+
+static void wake(struct shard *shard)
+{
+	uint64_t one = 1;
+
+	write(shard->wake_fd, &one, sizeof(one));
+	shard->wake_pending = false;
+}
+
+void shard_dispatch(struct shard *shard, const struct nlmsghdr *nlh,
+		    uint64_t ingest_ns)
+{
+	int ret;
+
+	/* a ring record is the ingest time, then the message */
+	ret = spsc_ring_push2(&shard->ring, &ingest_ns, sizeof(ingest_ns),
+			      nlh, nlh->nlmsg_len);
+	if (ret) {
+		/*
+		 * The worker is behind.  Waiting for it would hold up the
+		 * frames of every other shard too, so drop the frame like
+		 * a full socket buffer would, and make sure it is draining.
+		 * Logged on the 1st, 2nd, 4th, ... drop.
+		 */
+		wake(shard);
+		shard->ring_dropped++;
+		if (!(shard->ring_dropped & (shard->ring_dropped - 1)))
+			w_logf(shard->ctx, LOG_ERR, "%s: shard %d dropped "
+			       "%llu messages: %s\n", __func__, shard->id,
+			       (unsigned long long)shard->ring_dropped,
+			       strerror(-ret));
+		return;
+	}
+	shard->dispatched++;
+	shard->wake_pending = true;
+}
+
+void shards_wake(struct wmediumd *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->num_shards; i++) {
+		if (ctx->shards[i].wake_pending)
+			wake(&ctx->shards[i]);
+	}
+}
+
+void shard_move_station(struct station *station, struct shard *from,
+			struct shard *to)
+{
+	struct wqueue *queue;
+	struct list_head *l;
+	int ac, n;
+
+	for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+		queue = &station->queues[ac];
+		sched_remove(&from->sched, queue);
+		if (list_empty(&queue->frames))
+			continue;
+
+		/* frames go back to the pool of the shard that frees them */
+		n = 0;
+		list_for_each(l, &queue->frames)
+			n++;
+		from->frame_pool.in_use -= n;
+		to->frame_pool.in_use += n;
+
+		if (sched_update(&to->sched, queue))
+			w_flogf(to->ctx, LOG_ERR, stderr,
+				"Out of memory(sched)\n");
+	}
+	rearm_timer(to);
+}
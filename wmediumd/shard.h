@@ -0,0 +1,113 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "sched.h"
+#include "frame_pool.h"
+#include "nl_batch.h"
+#include "spsc_ring.h"
+#include "latency.h"
+
+#define SHARD_MAX_WORKERS	64
+#define SHARD_RING_BYTES	(1024 * 1024)
+
+struct wmediumd;
+struct station;
+struct nlmsghdr;
+struct event;
+struct event_base;
+
+/*
+ * Delivery state for a set of mediums.  Stations of different mediums
+ * never contend or interfere, so each shard owns the queues of its
+ * mediums' stations, their scheduler, timer and frame memory.
+ *
+ * Without -j there is one shard, driven by the main event loop.  With
+ * -j N each of N shards runs on its own thread and event base; the
+ * main thread only reads the hwsim socket and hands HWSIM_CMD_FRAME
+ * messages to the sender's shard through its ring.
+ */
+struct shard {
+	struct wmediumd *ctx;
+	int id;
+	struct frame_sched sched;
+	struct frame_pool frame_pool;
+	struct nl_batch tx_batch;
+	int timerfd;
+	struct timespec intf_updated;
+	struct latency lat;		/* see latency.h */
+
+	/* worker threads only */
+	struct spsc_ring ring;		/* netlink messages from ingest */
+	int wake_fd;			/* eventfd, ingest -> worker */
+	bool wake_pending;		/* ingest side */
+	bool stop;
+	unsigned short rand48[3];	/* erand48() state of the thread */
+	pthread_t thread;
+	struct event_base *base;
+	struct event *ev_wake;
+	struct event *ev_timer;
+
+	uint64_t dispatched;		/* messages handed to the worker */
+	uint64_t ring_dropped;		/* not handed over, ring full */
+	uint64_t misrouted;		/* sender changed shard meanwhile */
+};
+
+/*
+ * Allocate @num shards; mediums are spread over them as they are
+ * created, so this comes before the config is loaded.
+ */
+int shards_init(struct wmediumd *ctx, int num);
+void shards_free(struct wmediumd *ctx);
+
+/*
+ * Set up timers and tx batches and, with @workers, start one thread per
+ * shard; after the netlink socket is connected.
+ */
+int shards_start(struct wmediumd *ctx, bool workers, unsigned int batch_msgs);
+void shards_stop(struct wmediumd *ctx);
+
+/*
+ * Ingest side: queue @nlh, received at lat_now() @ingest_ns, for @shard,
+ * then wake all pending workers.  Drops @nlh if the shard's ring is full.
+ */
+void shard_dispatch(struct shard *shard, const struct nlmsghdr *nlh,
+		    uint64_t ingest_ns);
+void shards_wake(struct wmediumd *ctx);
+
+/*
+ * Hand the queues of @station over from @from to @to, after its medium
+ * moved to another shard.  Caller holds the snr_lock write lock.
+ */
+void shard_move_station(struct station *station, struct shard *from,
+			struct shard *to);
+
+/* drand48() of the calling shard worker, or the global one */
+double w_drand48(void);
+
+#endif /* SHARD_H_ */
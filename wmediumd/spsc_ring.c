@@ -0,0 +1,131 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "spsc_ring.h"
+
+/* 8-byte header keeps payloads 8-byte aligned */
+struct rec_hdr {
+	uint32_t len;
+	uint32_t pad;
+};
+
+#define REC_SKIP	UINT32_MAX	/* rest of the buffer is unused */
+#define REC_ALIGN(len)	(((len) + 7) & ~(size_t)7)
+
+static inline size_t rec_size(size_t len)
+{
+	return sizeof(struct rec_hdr) + REC_ALIGN(len);
+}
+
+int spsc_ring_init(struct spsc_ring *ring, size_t size)
+{
+	size_t n = 64;
+
+	while (n < size)
+		n <<= 1;
+	ring->buf = malloc(n);
+	if (!ring->buf)
+		return -ENOMEM;
+	ring->size = n;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+void spsc_ring_free(struct spsc_ring *ring)
+{
+	free(ring->buf);
+	ring->buf = NULL;
+	ring->size = 0;
+}
+
+int spsc_ring_push2(struct spsc_ring *ring, const void *data, size_t len,
+		    const void *more, size_t more_len)
+{
+	size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	size_t tail = ring->tail;
+	size_t off = tail & (ring->size - 1);
+	size_t to_end = ring->size - off;
+	size_t need = rec_size(len + more_len);
+	struct rec_hdr *hdr;
+
+	if (need > ring->size / 2)
+		return -EMSGSIZE;
+
+	/* records never wrap; skip the tail end of the buffer instead */
+	if (need > to_end) {
+		if (tail + to_end + need - head > ring->size)
+			return -ENOSPC;
+		hdr = (struct rec_hdr *)(ring->buf + off);
+		hdr->len = REC_SKIP;
+		tail += to_end;
+		off = 0;
+	} else if (tail + need - head > ring->size) {
+		return -ENOSPC;
+	}
+
+	hdr = (struct rec_hdr *)(ring->buf + off);
+	hdr->len = len + more_len;
+	memcpy(hdr + 1, data, len);
+	if (more_len)
+		memcpy((unsigned char *)(hdr + 1) + len, more, more_len);
+	__atomic_store_n(&ring->tail, tail + need, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int spsc_ring_push(struct spsc_ring *ring, const void *data, size_t len)
+{
+	return spsc_ring_push2(ring, data, len, NULL, 0);
+}
+
+void *spsc_ring_peek(struct spsc_ring *ring, size_t *len)
+{
+	size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	size_t head = ring->head;
+	struct rec_hdr *hdr;
+
+	if (head == tail)
+		return NULL;
+
+	hdr = (struct rec_hdr *)(ring->buf + (head & (ring->size - 1)));
+	if (hdr->len == REC_SKIP) {
+		head += ring->size - (head & (ring->size - 1));
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+		/* the producer only skips to place a record at offset 0 */
+		hdr = (struct rec_hdr *)ring->buf;
+	}
+	*len = hdr->len;
+	return hdr + 1;
+}
+
+void spsc_ring_pop(struct spsc_ring *ring)
+{
+	struct rec_hdr *hdr;
+
+	hdr = (struct rec_hdr *)(ring->buf + (ring->head & (ring->size - 1)));
+	__atomic_store_n(&ring->head, ring->head + rec_size(hdr->len),
+			 __ATOMIC_RELEASE);
+}
@@ -0,0 +1,53 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stddef.h>
+
+/*
+ * Lock-free single-producer/single-consumer ring of variable-length
+ * records.  Exactly one thread may push and one other thread may
+ * peek/pop; the positions are free-running byte counters published
+ * with release stores, so a record is only visible once fully written.
+ */
+struct spsc_ring {
+	unsigned char *buf;
+	size_t size;			/* power of two */
+	size_t head;			/* consumer position */
+	size_t tail;			/* producer position */
+};
+
+int spsc_ring_init(struct spsc_ring *ring, size_t size);
+void spsc_ring_free(struct spsc_ring *ring);
+
+/* Returns 0, -ENOSPC if the ring is full, -EMSGSIZE if it never fits */
+int spsc_ring_push(struct spsc_ring *ring, const void *data, size_t len);
+/* The same, for a record of @data followed by @more */
+int spsc_ring_push2(struct spsc_ring *ring, const void *data, size_t len,
+		    const void *more, size_t more_len);
+
+/* Oldest record, or NULL if empty; valid until spsc_ring_pop() */
+void *spsc_ring_peek(struct spsc_ring *ring, size_t *len);
+void spsc_ring_pop(struct spsc_ring *ring);
+
+#endif /* SPSC_RING_H_ */
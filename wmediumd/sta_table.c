@@ -0,0 +1,98 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "wmediumd.h"
+#include "sta_table.h"
+
+#define STA_TABLE_MIN_CAP 16
+
+void sta_table_init(struct sta_table *tab)
+{
+	tab->medium_id = NULL;
+	tab->x = NULL;
+	tab->y = NULL;
+	tab->z = NULL;
+	tab->tx_power = NULL;
+	tab->gain = NULL;
+	tab->isap = NULL;
+	tab->cap = 0;
+}
+
+void sta_table_free(struct sta_table *tab)
+{
+	free(tab->medium_id);
+	free(tab->x);
+	free(tab->y);
+	free(tab->z);
+	free(tab->tx_power);
+	free(tab->gain);
+	free(tab->isap);
+	sta_table_init(tab);
+}
+
+/* grow one column; on failure the old column is left in place */
+static int grow(void **col, size_t elem, int cap)
+{
+	void *p = realloc(*col, elem * cap);
+
+	if (!p)
+		return -ENOMEM;
+	*col = p;
+	return 0;
+}
+
+int sta_table_reserve(struct sta_table *tab, int n)
+{
+	int cap = tab->cap ? tab->cap : STA_TABLE_MIN_CAP;
+
+	if (n <= tab->cap)
+		return 0;
+	while (cap < n)
+		cap *= 2;
+
+	/* columns keep their old size until all of them have grown */
+	if (grow((void **)&tab->medium_id, sizeof(int), cap) ||
+	    grow((void **)&tab->x, sizeof(double), cap) ||
+	    grow((void **)&tab->y, sizeof(double), cap) ||
+	    grow((void **)&tab->z, sizeof(double), cap) ||
+	    grow((void **)&tab->tx_power, sizeof(int), cap) ||
+	    grow((void **)&tab->gain, sizeof(int), cap) ||
+	    grow((void **)&tab->isap, sizeof(int), cap))
+		return -ENOMEM;
+	tab->cap = cap;
+	return 0;
+}
+
+void sta_table_set(struct sta_table *tab, const struct station *station)
+{
+	int i = station->index;
+
+	tab->medium_id[i] = station->medium_id;
+	tab->x[i] = station->x;
+	tab->y[i] = station->y;
+	tab->z[i] = station->z;
+	tab->tx_power[i] = station->tx_power;
+	tab->gain[i] = station->gain;
+	tab->isap[i] = station->isap;
+}
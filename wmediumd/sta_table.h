@@ -0,0 +1,51 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef STA_TABLE_H_
+#define STA_TABLE_H_
+
+struct station;
+
+/*
+ * Structure-of-arrays copy of the station fields read by the per-frame
+ * and per-link loops, indexed by station->index.  struct station stays
+ * the record that is written; every writer refreshes the copy with
+ * sta_table_set() (via station_table_update()) under the same lock.
+ */
+struct sta_table {
+	int *medium_id;
+	double *x, *y, *z;
+	int *tx_power;
+	int *gain;
+	int *isap;
+	int cap;
+};
+
+void sta_table_init(struct sta_table *tab);
+void sta_table_free(struct sta_table *tab);
+
+/* Make room for @n stations; returns 0 or -ENOMEM */
+int sta_table_reserve(struct sta_table *tab, int n);
+
+/* Copy the hot fields of @station to its row, which must be reserved */
+void sta_table_set(struct sta_table *tab, const struct station *station);
+
+#endif /* STA_TABLE_H_ */
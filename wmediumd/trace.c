@@ -0,0 +1,194 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+_Static_assert(sizeof(struct trace_record) == 64, "trace record size");
+_Static_assert(sizeof(struct trace_data) == 64, "trace data size");
+_Static_assert(sizeof(struct trace_header) == 64, "trace header size");
+
+static size_t trace_len(uint64_t capacity)
+{
+	return sizeof(struct trace_header) +
+		capacity * sizeof(struct trace_record);
+}
+
+static void trace_set_map(struct trace *trace, void *map, size_t len)
+{
+	trace->hdr = map;
+	trace->records = (void *)(trace->hdr + 1);
+	trace->capacity = trace->hdr->capacity;
+	trace->map_len = len;
+}
+
+int trace_open(struct trace *trace, const char *path, uint64_t capacity,
+	       uint64_t seed)
+{
+	struct trace_header *hdr;
+	size_t len = trace_len(capacity);
+	void *map;
+	int fd, ret = 0;
+
+	if (!capacity)
+		return -EINVAL;
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+	/* sparse: blocks are only allocated as the ring fills */
+	if (ftruncate(fd, len)) {
+		ret = -errno;
+		goto out;
+	}
+	map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		ret = -errno;
+		goto out;
+	}
+
+	hdr = map;
+	memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+	hdr->version = TRACE_VERSION;
+	hdr->record_size = sizeof(struct trace_record);
+	hdr->capacity = capacity;
+	hdr->head = 0;
+	hdr->seed = seed;
+	trace_set_map(trace, map, len);
+out:
+	/* the mapping keeps the file */
+	close(fd);
+	return ret;
+}
+
+int trace_map(struct trace *trace, const char *path)
+{
+	struct trace_header *hdr;
+	struct stat st;
+	void *map;
+	int fd, ret = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st)) {
+		ret = -errno;
+		goto out;
+	}
+	if ((size_t)st.st_size < sizeof(*hdr)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		ret = -errno;
+		goto out;
+	}
+
+	hdr = map;
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != TRACE_VERSION ||
+	    hdr->record_size != sizeof(struct trace_record) ||
+	    !hdr->capacity ||
+	    hdr->capacity > (st.st_size - sizeof(*hdr)) / hdr->record_size) {
+		munmap(map, st.st_size);
+		ret = -EINVAL;
+		goto out;
+	}
+	trace_set_map(trace, map, st.st_size);
+out:
+	close(fd);
+	return ret;
+}
+
+void trace_close(struct trace *trace)
+{
+	if (trace->hdr)
+		munmap(trace->hdr, trace->map_len);
+	trace->hdr = NULL;
+	trace->records = NULL;
+}
+
+uint64_t trace_end(const struct trace *trace)
+{
+	return __atomic_load_n(&trace->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t trace_first(const struct trace *trace)
+{
+	uint64_t end = trace_end(trace);
+
+	return end > trace->capacity ? end - trace->capacity : 0;
+}
+
+bool trace_read(const struct trace *trace, uint64_t n,
+		struct trace_record *rec)
+{
+	const struct trace_record *slot = &trace->records[n % trace->capacity];
+	uint32_t seq = (uint32_t)n + 1;
+
+	if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq)
+		return false;
+	memcpy(rec, slot, sizeof(*rec));
+	/* a writer may have claimed the slot again meanwhile */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq;
+}
+
+void trace_put_data(struct trace *trace, uint64_t n, const void *data,
+		    size_t len)
+{
+	const uint8_t *p = data;
+	struct trace_data *rec;
+	size_t chunk;
+
+	for (; len; n++, p += chunk, len -= chunk) {
+		chunk = len < TRACE_DATA_LEN ? len : TRACE_DATA_LEN;
+		rec = (struct trace_data *)trace_slot(trace, n);
+		rec->type = TRACE_DATA;
+		memcpy(rec->data, p, chunk);
+		trace_commit((struct trace_record *)rec, n);
+	}
+}
+
+bool trace_get_data(const struct trace *trace, uint64_t n, void *data,
+		    size_t len)
+{
+	struct trace_record rec;
+	struct trace_data *d = (struct trace_data *)&rec;
+	uint8_t *p = data;
+	size_t chunk;
+
+	for (; len; n++, p += chunk, len -= chunk) {
+		chunk = len < TRACE_DATA_LEN ? len : TRACE_DATA_LEN;
+		if (!trace_read(trace, n, &rec) || d->type != TRACE_DATA)
+			return false;
+		memcpy(p, d->data, chunk);
+	}
+	return true;
+}
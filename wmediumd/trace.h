@@ -0,0 +1,163 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TRACE_MAGIC		"WMDTRACE"
+#define TRACE_VERSION		2
+#define TRACE_DEFAULT_RECORDS	(1 << 20)
+#define TRACE_MAX_RATES		4
+#define TRACE_DATA_LEN		59	/* bytes in a TRACE_DATA record */
+#define TRACE_HEADER_BYTES	TRACE_DATA_LEN	/* of an ingress frame */
+
+enum trace_type {
+	TRACE_QUEUED = 1,	/* queue_frame() computed the frame's fate */
+	TRACE_RX,		/* a receiver got the frame */
+	TRACE_TX_STATUS,	/* the sender got its transmit status */
+	/*
+	 * What came in, for trace replay: a frame from a radio with the
+	 * tx rates it offered, and a wserver request.  Both are followed
+	 * by TRACE_DATA records, with the first TRACE_HEADER_BYTES of the
+	 * frame and with the whole request as it was sent.
+	 */
+	TRACE_INGRESS,
+	TRACE_CONTROL,
+	TRACE_DATA,
+};
+
+/*
+ * One event, 64 bytes.  Times are ns of the simulation clock, the
+ * virtual one in virtual-time mode.  seq is the low 32 bits of the
+ * record's position plus one, stored last; 0 while it is written.
+ */
+struct trace_record {
+	uint32_t seq;
+	uint8_t type;
+	uint8_t ac;			/* TRACE_QUEUED only */
+	int16_t signal;			/* dBm, at the receiver for TRACE_RX */
+	uint64_t time_ns;
+	uint64_t expires_ns;
+	uint64_t cookie;
+	uint32_t duration;		/* usec on air, retries included */
+	uint16_t flags;			/* HWSIM_TX_* */
+	uint16_t freq;
+	uint32_t data_len;		/* of the frame, or of the request */
+	uint8_t sender[6];
+	uint8_t receiver[6];		/* addr1, but the station for TRACE_RX */
+	struct {
+		int8_t idx;
+		uint8_t count;
+	} rates[TRACE_MAX_RATES];	/* the tries made, idx -1 past them */
+};
+
+struct trace_data {
+	uint32_t seq;
+	uint8_t type;			/* TRACE_DATA */
+	uint8_t data[TRACE_DATA_LEN];
+};
+
+/*
+ * The file is this header followed by @capacity records.  head counts
+ * every record ever claimed and record n lives at n % capacity, so the
+ * file holds the last @capacity of them.
+ */
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;
+	uint64_t head;
+	uint64_t seed;			/* of the run's random numbers */
+	uint8_t pad[24];
+};
+
+/*
+ * A ring file mapped shared.  Writers claim records and fill them in,
+ * so nothing is formatted or written out on the data path; the kernel
+ * writes the pages back on its own.  Any number of threads may write.
+ */
+struct trace {
+	struct trace_header *hdr;
+	struct trace_record *records;
+	uint64_t capacity;
+	size_t map_len;
+};
+
+/* Create or truncate @path for @capacity records; returns 0 or -errno */
+int trace_open(struct trace *trace, const char *path, uint64_t capacity,
+	       uint64_t seed);
+/* Map an existing trace file read-only; returns 0 or -errno */
+int trace_map(struct trace *trace, const char *path);
+void trace_close(struct trace *trace);
+
+static inline unsigned int trace_data_records(size_t len)
+{
+	return (len + TRACE_DATA_LEN - 1) / TRACE_DATA_LEN;
+}
+
+/* Claim @count consecutive records; returns the position of the first */
+static inline uint64_t trace_claim(struct trace *trace, unsigned int count)
+{
+	return __atomic_fetch_add(&trace->hdr->head, count, __ATOMIC_RELAXED);
+}
+
+/* Record @n, to be filled in and passed to trace_commit() */
+static inline struct trace_record *trace_slot(struct trace *trace,
+					      uint64_t n)
+{
+	struct trace_record *rec = &trace->records[n % trace->capacity];
+
+	__atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+	/* readers must see the 0 before any of the new contents */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return rec;
+}
+
+static inline void trace_commit(struct trace_record *rec, uint64_t n)
+{
+	__atomic_store_n(&rec->seq, (uint32_t)n + 1, __ATOMIC_RELEASE);
+}
+
+/* Write @len bytes of @data into the data records from @n on */
+void trace_put_data(struct trace *trace, uint64_t n, const void *data,
+		    size_t len);
+
+/*
+ * Copy record @n into @rec.  Returns false if it was overwritten or is
+ * not complete yet, which a reader of a live file may see.
+ */
+bool trace_read(const struct trace *trace, uint64_t n,
+		struct trace_record *rec);
+
+/* Read @len bytes from the data records from @n on, false if incomplete */
+bool trace_get_data(const struct trace *trace, uint64_t n, void *data,
+		    size_t len);
+
+/* First record still in the file, and one past the last */
+uint64_t trace_first(const struct trace *trace);
+uint64_t trace_end(const struct trace *trace);
+
+#endif /* TRACE_H_ */
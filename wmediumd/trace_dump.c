@@ -0,0 +1,184 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+/*
+ * Print a frame trace file written with wmediumd -w, oldest event
+ * first, or a summary of it with -s.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "trace.h"
+
+/* HWSIM_TX_STAT_ACK, hwsim's tx status flag */
+#define TX_STAT_ACK (1 << 2)
+
+static const char *type_name(uint8_t type)
+{
+	switch (type) {
+	case TRACE_QUEUED:
+		return "queued";
+	case TRACE_RX:
+		return "rx";
+	case TRACE_TX_STATUS:
+		return "tx_status";
+	case TRACE_INGRESS:
+		return "ingress";
+	case TRACE_CONTROL:
+		return "control";
+	}
+	return "?";
+}
+
+static void print_addr(const uint8_t *a)
+{
+	printf("%02x:%02x:%02x:%02x:%02x:%02x", a[0], a[1], a[2], a[3], a[4],
+	       a[5]);
+}
+
+static void print_record(const struct trace_record *rec)
+{
+	int i;
+
+	printf("%" PRIu64 ".%09" PRIu64 " %-9s ", rec->time_ns / 1000000000,
+	       rec->time_ns % 1000000000, type_name(rec->type));
+	if (rec->type == TRACE_CONTROL) {
+		printf("request len %u\n", rec->data_len);
+		return;
+	}
+	print_addr(rec->sender);
+	printf(" -> ");
+	print_addr(rec->receiver);
+	printf(" signal %d len %u freq %u rates", rec->signal, rec->data_len,
+	       rec->freq);
+	for (i = 0; i < TRACE_MAX_RATES && rec->rates[i].idx >= 0; i++)
+		printf("%c%d:%u", i ? ',' : ' ', rec->rates[i].idx,
+		       rec->rates[i].count);
+	if (!i)
+		printf(" -");
+	if (rec->type == TRACE_QUEUED)
+		printf(" ac %u", rec->ac);
+	printf(" flags 0x%x duration %u expires %" PRIu64 ".%09" PRIu64
+	       " cookie %" PRIu64 "\n", rec->flags, rec->duration,
+	       rec->expires_ns / 1000000000, rec->expires_ns % 1000000000,
+	       rec->cookie);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s] [-n N] FILE\n"
+			"  -s    print a summary instead of the events\n"
+			"  -n N  only the last N events\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct trace trace;
+	struct trace_record rec;
+	uint64_t first, end, n, last = 0, skipped = 0;
+	uint64_t counts[TRACE_CONTROL + 1] = {0};
+	uint64_t acked = 0, tries = 0, start_ns = 0, end_ns = 0;
+	char *endp;
+	bool summary = false;
+	int opt, i, ret;
+
+	while ((opt = getopt(argc, argv, "sn:")) != -1) {
+		switch (opt) {
+		case 's':
+			summary = true;
+			break;
+		case 'n':
+			last = strtoull(optarg, &endp, 10);
+			if (optarg == endp || *endp)
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	ret = trace_map(&trace, argv[optind]);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	first = trace_first(&trace);
+	end = trace_end(&trace);
+	if (last && end - first > last)
+		first = end - last;
+
+	for (n = first; n < end; n++) {
+		if (!trace_read(&trace, n, &rec)) {
+			skipped++;
+			continue;
+		}
+		/* the contents of an ingress or control record */
+		if (rec.type == TRACE_DATA)
+			continue;
+		if (!summary) {
+			print_record(&rec);
+			continue;
+		}
+		if (rec.type <= TRACE_CONTROL)
+			counts[rec.type]++;
+		if (!start_ns || rec.time_ns < start_ns)
+			start_ns = rec.time_ns;
+		if (rec.time_ns > end_ns)
+			end_ns = rec.time_ns;
+		if (rec.type != TRACE_TX_STATUS)
+			continue;
+		if (rec.flags & TX_STAT_ACK)
+			acked++;
+		for (i = 0; i < TRACE_MAX_RATES && rec.rates[i].idx >= 0; i++)
+			tries += rec.rates[i].count;
+	}
+
+	if (summary) {
+		double secs = (end_ns - start_ns) / 1e9;
+
+		printf("events %" PRIu64 " of %" PRIu64 " recorded, %" PRIu64
+		       " incomplete\n", end - first - skipped, end, skipped);
+		printf("queued %" PRIu64 " rx %" PRIu64 " tx_status %" PRIu64
+		       "\n", counts[TRACE_QUEUED], counts[TRACE_RX],
+		       counts[TRACE_TX_STATUS]);
+		printf("ingress %" PRIu64 " control %" PRIu64 "\n",
+		       counts[TRACE_INGRESS], counts[TRACE_CONTROL]);
+		printf("acked %" PRIu64 " tries per frame %.2f\n", acked,
+		       counts[TRACE_TX_STATUS] ?
+		       (double)tries / counts[TRACE_TX_STATUS] : 0.0);
+		printf("span %.6f s, %.0f frames/s\n", secs,
+		       secs > 0 ? counts[TRACE_TX_STATUS] / secs : 0.0);
+	} else if (skipped) {
+		fprintf(stderr, "%" PRIu64 " incomplete events skipped\n",
+			skipped);
+	}
+	trace_close(&trace);
+	return EXIT_SUCCESS;
+}
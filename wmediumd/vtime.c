@@ -0,0 +1,119 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "wmediumd.h"
+#include "wmediumd_dynamic.h"
+#include "vtime.h"
+
+int vtime_queue_frame(struct wmediumd *ctx, const u8 *data, int data_len,
+		      unsigned int flags, const struct hwsim_tx_rate *tx_rates,
+		      int tx_rates_count, u64 cookie, u32 freq)
+{
+	const struct ieee80211_hdr *hdr = (const void *)data;
+	struct station *sender;
+
+	if (data_len < 6 + 6 + 4)
+		return -EINVAL;
+	snr_rdlock(&ctx->shards[0].lat.snr_lock);
+	sender = get_station_by_addr(ctx, hdr->addr2);
+	if (sender) {
+		links_read_lock(&ctx->links);
+		queue_frame_data(station_shard(ctx, sender), sender, data,
+				 data_len, flags, tx_rates, tx_rates_count,
+				 cookie, freq);
+		links_read_unlock(&ctx->links);
+	}
+	pthread_rwlock_unlock(&snr_lock);
+	return sender ? 0 : -ENOENT;
+}
+
+/* expiry of the next frame to deliver, false if none is queued */
+static bool next_expiry(struct shard *shard, struct timespec *when)
+{
+	struct wqueue *queue = sched_peek(&shard->sched);
+	struct frame *frame;
+
+	if (!queue)
+		return false;
+	frame = list_first_entry(&queue->frames, struct frame, list);
+	*when = frame->expires;
+	return true;
+}
+
+static void advance(struct wmediumd *ctx, const struct timespec *to)
+{
+	/* time never goes back, a source may hand out past frames */
+	if (timespec_before(&ctx->vnow, (struct timespec *)to))
+		ctx->vnow = *to;
+}
+
+void vtime_run(struct wmediumd *ctx, struct frame_source *src,
+	       const struct timespec *start)
+{
+	struct shard *shard = &ctx->shards[0];
+	struct timespec expires, when;
+	bool queued, more;
+
+	pthread_rwlock_wrlock(&snr_lock);
+	ctx->source = src;
+	ctx->vnow = *start;
+	shard->intf_updated = *start;
+	ctx->next_move = *start;
+	ctx->next_move.tv_sec += MOVE_INTERVAL;
+	pthread_rwlock_unlock(&snr_lock);
+
+	for (;;) {
+		snr_rdlock(&shard->lat.snr_lock);
+		queued = next_expiry(shard, &expires);
+		more = src->next(src, &when);
+		if (!queued && !more) {
+			pthread_rwlock_unlock(&snr_lock);
+			break;
+		}
+
+		/* ties go to the source, queue_frame() is before delivery */
+		if (more && (!queued || !timespec_before(&expires, &when))) {
+			advance(ctx, &when);
+			pthread_rwlock_unlock(&snr_lock);
+			src->inject(src, ctx);
+		} else {
+			/* a timer fires just after the expiry it was set to */
+			if (++expires.tv_nsec == 1000000000) {
+				expires.tv_sec++;
+				expires.tv_nsec = 0;
+			}
+			advance(ctx, &expires);
+			/* as timer_cb(): publishes new links, so not in a read section */
+			ctx->move_stations(ctx);
+			links_read_lock(&ctx->links);
+			deliver_expired_frames(shard);
+			links_read_unlock(&ctx->links);
+			pthread_rwlock_unlock(&snr_lock);
+			if (nl_batch_flush(&shard->tx_batch) < 0)
+				w_logf(ctx, LOG_ERR, "%s: nl_batch_flush failed\n",
+				       __func__);
+		}
+	}
+}
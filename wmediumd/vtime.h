@@ -0,0 +1,74 @@
+/*
+ *	wmediumd, wireless medium simulator for mac80211_hwsim kernel module
+ *	Copyright (c) 2011 cozybit Inc.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version 2
+ *	of the License, or (at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *	02110-1301, USA.
+ */
+
+
+#ifndef VTIME_H_
+#define VTIME_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "ieee80211.h"
+
+struct wmediumd;
+struct station;
+struct frame;
+struct hwsim_tx_rate;
+
+/*
+ * In-process replacement for the hwsim netlink socket.  With a frame
+ * source set, wmediumd runs on virtual time: vtime_run() keeps its own
+ * clock and jumps from one event to the next, either the source's next
+ * frame or the next frame expiry, instead of waiting on a timer.
+ */
+struct frame_source {
+	/* time of the next frame it has, false when it has no more */
+	bool (*next)(struct frame_source *src, struct timespec *when);
+	/* queue that frame, with vtime_queue_frame() or process_nlh() */
+	void (*inject)(struct frame_source *src, struct wmediumd *ctx);
+	/*
+	 * A frame was received at @dst.  Without rx and tx_status, the
+	 * netlink messages go out through the tx batches instead.
+	 */
+	void (*rx)(struct frame_source *src, struct station *dst,
+		   const u8 *data, int data_len, int rate_idx, int signal,
+		   int freq);
+	/* the transmit status of @frame, as HWSIM_CMD_TX_INFO_FRAME has it */
+	void (*tx_status)(struct frame_source *src, struct frame *frame);
+	void *priv;
+};
+
+/*
+ * Queue a frame sent by the station with address addr2 of @data at the
+ * current virtual time.  Returns 0, or -ENOENT for an unknown sender.
+ */
+int vtime_queue_frame(struct wmediumd *ctx, const u8 *data, int data_len,
+		      unsigned int flags, const struct hwsim_tx_rate *tx_rates,
+		      int tx_rates_count, u64 cookie, u32 freq);
+
+/*
+ * Run the simulation of @ctx on virtual time, starting at @start, until
+ * @src has no more frames and every queued frame is delivered.  Needs a
+ * single shard without workers.
+ */
+void vtime_run(struct wmediumd *ctx, struct frame_source *src,
+	       const struct timespec *start);
+
+#endif /* VTIME_H_ */
@@ -42,6 +42,12 @@
 #include "wserver.h"
 #include "wmediumd_dynamic.h"
 #include "wserver_messages.h"
+#include "vtime.h"
+#include "fake_hwsim.h"
+#include "replay.h"
+
+/* what drand48() starts from without srand48() */
+#define DEFAULT_SEED	0x1234abcd
 
 static inline int div_round(int a, int b)
 {
@@ -79,6 +85,7 @@ static void wqueue_init(struct wqueue *wqueue, int cw_min, int cw_max)
 	INIT_LIST_HEAD(&wqueue->frames);
 	wqueue->cw_min = cw_min;
 	wqueue->cw_max = cw_max;
+	wqueue->sched_idx = -1;
 }
 
 void station_init_queues(struct station *station)
@@ -104,6 +111,72 @@ void timespec_add_usec(struct timespec *t, int usec)
 	}
 }
 
+u64 timespec_to_ns(const struct timespec *t)
+{
+	return (u64)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+void ns_to_timespec(u64 ns, struct timespec *t)
+{
+	t->tv_sec = ns / 1000000000;
+	t->tv_nsec = ns % 1000000000;
+}
+
+/* The simulation clock: CLOCK_MONOTONIC, or vtime_run()'s virtual one */
+void w_clock_gettime(struct wmediumd *ctx, struct timespec *now)
+{
+	if (ctx->source)
+		*now = ctx->vnow;
+	else
+		clock_gettime(CLOCK_MONOTONIC, now);
+}
+
+/* Record a frame event in the trace file, see trace.h */
+static void trace_frame(struct wmediumd *ctx, u8 type, struct frame *frame,
+			const u8 *receiver, int signal, int ac,
+			const struct timespec *now)
+{
+	struct ieee80211_hdr *hdr = (void *)frame->data;
+	struct trace_record *rec;
+	uint64_t n;
+	int i;
+
+	n = trace_claim(ctx->trace, 1);
+	rec = trace_slot(ctx->trace, n);
+	rec->type = type;
+	rec->ac = ac;
+	rec->signal = signal;
+	rec->time_ns = timespec_to_ns(now);
+	rec->expires_ns = timespec_to_ns(&frame->expires);
+	rec->cookie = frame->cookie;
+	rec->duration = frame->duration;
+	rec->flags = frame->flags;
+	rec->freq = frame->freq;
+	rec->data_len = frame->data_len;
+	memcpy(rec->sender, frame->sender->addr, ETH_ALEN);
+	memcpy(rec->receiver, receiver ? receiver : hdr->addr1, ETH_ALEN);
+	for (i = 0; i < TRACE_MAX_RATES; i++) {
+		if (i < frame->tx_rates_count) {
+			rec->rates[i].idx = frame->tx_rates[i].idx;
+			rec->rates[i].count = frame->tx_rates[i].count;
+		} else {
+			rec->rates[i].idx = -1;
+			rec->rates[i].count = 0;
+		}
+	}
+	trace_commit(rec, n);
+}
+
+static inline void trace_frame_now(struct wmediumd *ctx, u8 type,
+				   struct frame *frame, const u8 *receiver,
+				   int signal)
+{
+	struct timespec now;
+
+	w_clock_gettime(ctx, &now);
+	trace_frame(ctx, type, frame, receiver, signal, 0, &now);
+}
+
 // a - b = c
 static int timespec_sub(struct timespec *a, struct timespec *b,
 			struct timespec *c)
@@ -120,40 +193,24 @@ static int timespec_sub(struct timespec *a, struct timespec *b,
 	return 0;
 }
 
-void rearm_timer(struct wmediumd *ctx)
+void rearm_timer(struct shard *shard)
 {
-	struct timespec min_expires;
 	struct itimerspec expires;
-	struct station *station;
+	struct wqueue *queue;
 	struct frame *frame;
-	int i;
-
-	bool set_min_expires = false;
 
 	/*
-	 * Iterate over all the interfaces to find the next frame that
-	 * will be delivered, and set the timerfd accordingly.
+	 * The scheduler keeps the queue holding the next frame that
+	 * will be delivered on top; set the timerfd accordingly.
 	 */
-	list_for_each_entry(station, &ctx->stations, list) {
-		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
-			frame = list_first_entry_or_null(&station->queues[i].frames,
-							 struct frame, list);
-
-			if (frame && (!set_min_expires ||
-				      timespec_before(&frame->expires,
-						      &min_expires))) {
-				set_min_expires = true;
-				min_expires = frame->expires;
-			}
-		}
-	}
+	queue = sched_peek(&shard->sched);
+	if (!queue || shard->ctx->source)
+		return;
 
-	if (set_min_expires) {
-		memset(&expires, 0, sizeof(expires));
-		expires.it_value = min_expires;
-		timerfd_settime(ctx->timerfd, TFD_TIMER_ABSTIME, &expires,
-				NULL);
-	}
+	frame = list_first_entry(&queue->frames, struct frame, list);
+	memset(&expires, 0, sizeof(expires));
+	expires.it_value = frame->expires;
+	timerfd_settime(shard->timerfd, TFD_TIMER_ABSTIME, &expires, NULL);
 }
 
 static inline bool frame_has_a4(struct frame *frame)
@@ -232,10 +289,26 @@ static double milliwatt_to_dBm(double value)
 	return 10.0 * log10(value);
 }
 
+/*
+ * The intf entries towards a station are written by its shard but read
+ * by the shard of every transmitter reaching it; relaxed atomics keep
+ * those reads defined when shards run on their own threads.
+ */
+#define intf_load(field) ({					\
+	__typeof__(field) _v;						\
+	__atomic_load(&(field), &_v, __ATOMIC_RELAXED);			\
+	_v;								\
+})
+#define intf_store(field, val) do {					\
+	__typeof__(field) _v = (val);					\
+	__atomic_store(&(field), &_v, __ATOMIC_RELAXED);		\
+} while (0)
+
 static int set_interference_duration(struct wmediumd *ctx, int src_idx,
 				     int duration, int signal)
 {
-	int i, medium_id;
+	struct medium *medium = ctx->sta_array[src_idx]->medium;
+	int i, k;
 
 	if (!ctx->intf)
 		return 0;
@@ -243,13 +316,11 @@ static int set_interference_duration(struct wmediumd *ctx, int src_idx,
 	if (signal >= CCA_THRESHOLD)
 		return 0;
 
-    medium_id = ctx->sta_array[src_idx]->medium_id;
-	for (i = 0; i < ctx->num_stas; i++) {
-        if (medium_id != ctx->sta_array[i]->medium_id)
-            continue;
-		ctx->intf[ctx->num_stas * src_idx + i].duration += duration;
+	for (k = 0; medium && k < medium->num_members; k++) {
+		i = medium->members[k];
+		ctx->intf[ctx->link_stride * src_idx + i].duration += duration;
 		// use only latest value
-		ctx->intf[ctx->num_stas * src_idx + i].signal = signal;
+		intf_store(ctx->intf[ctx->link_stride * src_idx + i].signal, signal);
 	}
 
 	return 1;
@@ -258,22 +329,21 @@ static int set_interference_duration(struct wmediumd *ctx, int src_idx,
 static int get_signal_offset_by_interference(struct wmediumd *ctx, int src_idx,
 					     int dst_idx)
 {
-    int i, medium_id;
+	struct medium *medium = ctx->sta_array[dst_idx]->medium;
+	int i, k;
 	double intf_power;
 
 	if (!ctx->intf)
 		return 0;
 
 	intf_power = 0.0;
-    medium_id = ctx->sta_array[dst_idx]->medium_id;
-	for (i = 0; i < ctx->num_stas; i++) {
+	for (k = 0; medium && k < medium->num_members; k++) {
+		i = medium->members[k];
 		if (i == src_idx || i == dst_idx)
 			continue;
-        if (medium_id != ctx->sta_array[i]->medium_id)
-            continue;
-		if (drand48() < ctx->intf[i * ctx->num_stas + dst_idx].prob_col)
+		if (w_drand48() < intf_load(ctx->intf[i * ctx->link_stride + dst_idx].prob_col))
 			intf_power += dBm_to_milliwatt(
-				ctx->intf[i * ctx->num_stas + dst_idx].signal);
+				intf_load(ctx->intf[i * ctx->link_stride + dst_idx].signal));
 	}
 
 	if (intf_power <= 1.0)
@@ -287,15 +357,46 @@ bool is_multicast_ether_addr(const u8 *addr)
 	return 0x01 & addr[0];
 }
 
-static struct station *get_station_by_addr(struct wmediumd *ctx, u8 *addr)
+struct station *get_station_by_addr(struct wmediumd *ctx, const u8 *addr)
+{
+	return addr_index_lookup(&ctx->sta_by_addr, addr);
+}
+
+/*
+ * Make a new station reachable by its address.  A duplicate address
+ * keeps resolving to the station that was added first.
+ */
+int station_index_add(struct wmediumd *ctx, struct station *station)
+{
+	int ret;
+
+	ret = addr_index_insert(&ctx->sta_by_addr, station);
+	if (ret == -ENOMEM)
+		return ret;
+	return 0;
+}
+
+void station_index_del(struct wmediumd *ctx, struct station *station)
+{
+	addr_index_remove(&ctx->sta_by_addr, station);
+}
+
+/* Resize ctx->sta_table to num_stas and refresh every row */
+int station_table_sync(struct wmediumd *ctx)
 {
 	struct station *station;
 
-	list_for_each_entry(station, &ctx->stations, list) {
-		if (memcmp(station->addr, addr, ETH_ALEN) == 0)
-			return station;
-	}
-	return NULL;
+	if (sta_table_reserve(&ctx->sta_table, ctx->num_stas))
+		return -ENOMEM;
+	list_for_each_entry(station, &ctx->stations, list)
+		sta_table_set(&ctx->sta_table, station);
+	return 0;
+}
+
+/* Call after changing a field of @station mirrored in ctx->sta_table */
+void station_table_update(struct wmediumd *ctx, struct station *station)
+{
+	sta_table_set(&ctx->sta_table, station);
 }
 
 void detect_mediums(struct wmediumd *ctx, struct station *src, struct station *dest) {
@@ -319,29 +420,30 @@ void detect_mediums(struct wmediumd *ctx, struct station *src, struct station *d
         w_logf(ctx, LOG_DEBUG, "Setting medium id of " MAC_FMT "(%d|%s) to %d.\n",
                MAC_ARGS(src->addr), src->index, src->isap ? "AP" : "Sta",
                medium_id);
-        src-> medium_id = medium_id;
+        station_set_medium(ctx, src, medium_id);
     }
     if(medium_id!=dest->medium_id){
         w_logf(ctx, LOG_DEBUG, "Setting medium id of " MAC_FMT "(%d|%s) to %d.\n",
                MAC_ARGS(dest->addr), dest->index, dest->isap ? "AP" : "Sta",
                medium_id);
-        dest-> medium_id = medium_id;
+        station_set_medium(ctx, dest, medium_id);
     }
 }
-void queue_frame(struct wmediumd *ctx, struct station *station,
+void queue_frame(struct shard *shard, struct station *station,
 		 struct frame *frame)
 {
+	struct wmediumd *ctx = shard->ctx;
 	struct ieee80211_hdr *hdr = (void *)frame->data;
 	u8 *dest = hdr->addr1;
 	struct timespec now, target;
 	struct wqueue *queue;
-	struct frame *tail;
-	struct station *tmpsta, *deststa;
+	struct station *deststa;
 	int send_time;
 	int cw;
 	double error_prob;
 	bool is_acked = false;
 	bool noack = false;
+	struct medium *medium;
 	int i, j;
 	int rate_idx;
 	int ac;
@@ -353,7 +455,7 @@ void queue_frame(struct wmediumd *ctx, struct station *station,
 
 	int retries = 0;
 
-	clock_gettime(CLOCK_MONOTONIC, &now);
+	w_clock_gettime(ctx, &now);
 
 	int ack_time_usec = pkt_duration(ctx, 14, index_to_rate(0, frame->freq)) +
 			sifs;
@@ -390,12 +492,13 @@ void queue_frame(struct wmediumd *ctx, struct station *station,
 		}
 	}
 	frame->signal = snr + NOISE_LEVEL;
+	frame->receiver = deststa;
 
 	noack = frame_is_mgmt(frame) || is_multicast_ether_addr(dest);
 	double choice = -3.14;
 
 	if (use_fixed_random_value(ctx))
-		choice = drand48();
+		choice = w_drand48();
 
 	for (i = 0; i < frame->tx_rates_count && !is_acked; i++) {
 
@@ -430,7 +533,7 @@ void queue_frame(struct wmediumd *ctx, struct station *station,
 					cw = queue->cw_max;
 			}
 			if (!use_fixed_random_value(ctx))
-				choice = drand48();
+				choice = w_drand48();
 			if (choice > error_prob) {
 				is_acked = true;
 				break;
@@ -453,20 +556,10 @@ void queue_frame(struct wmediumd *ctx, struct station *station,
 	 */
 	target = now;
     w_logf(ctx, LOG_DEBUG, "Sta " MAC_FMT " medium is #%d\n", MAC_ARGS(station->addr), station->medium_id);
-    list_for_each_entry(tmpsta, &ctx->stations, list) {
-        if (station->medium_id == tmpsta->medium_id) {
-            w_logf(ctx, LOG_DEBUG, "Sta " MAC_FMT " medium is also #%d\n", MAC_ARGS(tmpsta->addr),
-                   tmpsta->medium_id);
-            for (i = 0; i <= ac; i++) {
-                tail = list_last_entry_or_null(&tmpsta->queues[i].frames,
-                                               struct frame, list);
-                if (tail && timespec_before(&target, &tail->expires))
-                    target = tail->expires;
-            }
-        } else {
-            w_logf(ctx, LOG_DEBUG, "Sta " MAC_FMT " medium is not #%d, it is #%d\n", MAC_ARGS(tmpsta->addr),
-                   station->medium_id, tmpsta->medium_id);
-        }
+    medium = station->medium;
+    for (i = 0; medium && i <= ac; i++) {
+        if (timespec_before(&target, &medium->last_expires[i]))
+            target = medium->last_expires[i];
     }
 
 	timespec_add_usec(&target, send_time);
@@ -474,18 +567,34 @@ void queue_frame(struct wmediumd *ctx, struct station *station,
 	frame->duration = send_time;
 	frame->expires = target;
 	list_add_tail(&frame->list, &queue->frames);
-	rearm_timer(ctx);
+	if (queue->sched_idx < 0 && sched_update(&shard->sched, queue)) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(sched)\n");
+		list_del(&frame->list);
+		frame_free(&shard->frame_pool, frame);
+		return;
+	}
+	if (medium)
+		medium_frame_queued(medium, ac, &frame->expires);
+	if (ctx->trace)
+		trace_frame(ctx, TRACE_QUEUED, frame, NULL, frame->signal, ac,
+			    &now);
+	rearm_timer(shard);
 }
 
 /*
  * Report transmit status to the kernel.
  */
-static int send_tx_info_frame_nl(struct wmediumd *ctx, struct frame *frame)
+static int send_tx_info_frame_nl(struct shard *shard, struct frame *frame)
 {
-	struct nl_sock *sock = ctx->sock;
+	struct wmediumd *ctx = shard->ctx;
 	struct nl_msg *msg;
 	int ret;
 
+	if (ctx->source && ctx->source->tx_status) {
+		ctx->source->tx_status(ctx->source, frame);
+		return 0;
+	}
+
 	msg = nlmsg_alloc();
 	if (!msg) {
 		w_logf(ctx, LOG_ERR, "Error allocating new message MSG!\n");
@@ -513,9 +622,9 @@ static int send_tx_info_frame_nl(struct wmediumd *ctx, struct frame *frame)
 			goto out;
 	}
 
-	ret = nl_send_auto_complete(sock, msg);
+	ret = nl_batch_add(&shard->tx_batch, msg);
 	if (ret < 0) {
-		w_logf(ctx, LOG_ERR, "%s: nl_send_auto failed\n", __func__);
+		w_logf(ctx, LOG_ERR, "%s: nl_batch_add failed\n", __func__);
 		ret = -1;
 		goto out;
 	}
@@ -527,201 +636,289 @@ out:
 }
 
 /*
- * Send a data frame to the kernel for reception at a specific radio.
+ * Build the HWSIM_CMD_FRAME message for one frame once.  Only the
+ * receiver address and the signal differ between receivers; both are
+ * patched in place by send_frame_msg_tmpl().  HWSIM_ATTR_FRAME is put
+ * last so that the batch can send the frame body straight from the
+ * template instead of copying it for every receiver.
  */
-int send_cloned_frame_msg(struct wmediumd *ctx, struct station *dst,
-			  u8 *data, int data_len, int rate_idx, int signal,
-			  int freq)
+static int frame_msg_tmpl_init(struct wmediumd *ctx,
+			       struct frame_msg_tmpl *tmpl, u8 *data,
+			       int data_len, int rate_idx, int freq)
 {
-	struct nl_msg *msg;
-	struct nl_sock *sock = ctx->sock;
-	int ret;
+	struct nlattr *frame_attr, *receiver_attr, *signal_attr;
+	size_t size;
 
-	msg = nlmsg_alloc();
-	if (!msg) {
+	size = GENL_HDRLEN + nla_total_size(ETH_ALEN) +
+	       3 * nla_total_size(sizeof(u32)) + nla_total_size(data_len);
+	tmpl->msg = nlmsg_alloc_size(nlmsg_total_size(size));
+	if (!tmpl->msg) {
 		w_logf(ctx, LOG_ERR, "Error allocating new message MSG!\n");
 		return -1;
 	}
 
-	if (genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, ctx->family_id,
+	if (genlmsg_put(tmpl->msg, NL_AUTO_PID, NL_AUTO_SEQ, ctx->family_id,
 			0, NLM_F_REQUEST, HWSIM_CMD_FRAME,
 			VERSION_NR) == NULL) {
 		w_logf(ctx, LOG_ERR, "%s: genlmsg_put failed\n", __func__);
-		ret = -1;
-		goto out;
+		goto err;
 	}
 
-	if (nla_put(msg, HWSIM_ATTR_ADDR_RECEIVER, ETH_ALEN,
-		    dst->hwaddr) ||
-	    nla_put(msg, HWSIM_ATTR_FRAME, data_len, data) ||
-	    nla_put_u32(msg, HWSIM_ATTR_RX_RATE, rate_idx) ||
-	    nla_put_u32(msg, HWSIM_ATTR_FREQ, freq) ||
-	    nla_put_u32(msg, HWSIM_ATTR_SIGNAL, signal)) {
-			w_logf(ctx, LOG_ERR, "%s: Failed to fill a payload\n", __func__);
-			ret = -1;
-			goto out;
+	receiver_attr = nla_reserve(tmpl->msg, HWSIM_ATTR_ADDR_RECEIVER,
+				    ETH_ALEN);
+	signal_attr = nla_reserve(tmpl->msg, HWSIM_ATTR_SIGNAL, sizeof(u32));
+	if (!receiver_attr || !signal_attr ||
+	    nla_put_u32(tmpl->msg, HWSIM_ATTR_RX_RATE, rate_idx) ||
+	    nla_put_u32(tmpl->msg, HWSIM_ATTR_FREQ, freq) ||
+	    !(frame_attr = nla_reserve(tmpl->msg, HWSIM_ATTR_FRAME,
+				       data_len))) {
+		w_logf(ctx, LOG_ERR, "%s: Failed to fill a payload\n", __func__);
+		goto err;
 	}
+	memcpy(nla_data(frame_attr), data, data_len);
+
+	tmpl->receiver = nla_data(receiver_attr);
+	tmpl->signal = nla_data(signal_attr);
+	tmpl->head_len = (u8 *)nla_data(frame_attr) -
+			 (u8 *)nlmsg_hdr(tmpl->msg);
+	tmpl->data_len = data_len;
+	return 0;
+
+err:
+	nlmsg_free(tmpl->msg);
+	tmpl->msg = NULL;
+	return -1;
+}
+
+static void frame_msg_tmpl_free(struct frame_msg_tmpl *tmpl)
+{
+	/* the batch keeps its own reference until it is flushed */
+	nlmsg_free(tmpl->msg);
+	tmpl->msg = NULL;
+}
+
+static int send_frame_msg_tmpl(struct shard *shard,
+			       struct frame_msg_tmpl *tmpl,
+			       struct station *dst, int signal)
+{
+	struct wmediumd *ctx = shard->ctx;
+	u32 sig = signal;
+
+	memcpy(tmpl->receiver, dst->hwaddr, ETH_ALEN);
+	memcpy(tmpl->signal, &sig, sizeof(sig));
 
 	w_logf(ctx, LOG_DEBUG, "cloned msg dest " MAC_FMT " (radio: " MAC_FMT ") len %d\n",
-		   MAC_ARGS(dst->addr), MAC_ARGS(dst->hwaddr), data_len);
+		   MAC_ARGS(dst->addr), MAC_ARGS(dst->hwaddr), tmpl->data_len);
 
-	ret = nl_send_auto_complete(sock, msg);
-	if (ret < 0) {
-		w_logf(ctx, LOG_ERR, "%s: nl_send_auto failed\n", __func__);
-		ret = -1;
-		goto out;
+	if (nl_batch_add_split(&shard->tx_batch, tmpl->msg,
+			       tmpl->head_len) < 0) {
+		w_logf(ctx, LOG_ERR, "%s: nl_batch_add_split failed\n", __func__);
+		return -1;
 	}
-	ret = 0;
+	return 0;
+}
 
-out:
-	nlmsg_free(msg);
+/*
+ * Send a data frame to the kernel for reception at a specific radio.
+ */
+int send_cloned_frame_msg(struct shard *shard, struct station *dst,
+			  u8 *data, int data_len, int rate_idx, int signal,
+			  int freq)
+{
+	struct frame_msg_tmpl tmpl;
+	int ret;
+
+	if (shard->ctx->source && shard->ctx->source->rx) {
+		shard->ctx->source->rx(shard->ctx->source, dst, data, data_len,
+				       rate_idx, signal, freq);
+		return 0;
+	}
+	if (frame_msg_tmpl_init(shard->ctx, &tmpl, data, data_len, rate_idx,
+				freq))
+		return -1;
+	ret = send_frame_msg_tmpl(shard, &tmpl, dst, signal);
+	frame_msg_tmpl_free(&tmpl);
 	return ret;
 }
 
-void deliver_frame(struct wmediumd *ctx, struct frame *frame)
+void deliver_frame(struct shard *shard, struct frame *frame)
 {
+	struct wmediumd *ctx = shard->ctx;
 	struct ieee80211_hdr *hdr = (void *) frame->data;
 	struct station *station;
 	u8 *dest = hdr->addr1;
 	u8 *src = frame->sender->addr;
+	struct frame_msg_tmpl tmpl = { .msg = NULL };
+	u64 start = lat_now();
+	int receivers = 0;
 
-	if (frame->flags & HWSIM_TX_STAT_ACK) {
-		/* rx the frame on the dest interface */
+	if (!(frame->flags & HWSIM_TX_STAT_ACK)) {
+		set_interference_duration(ctx, frame->sender->index,
+					  frame->duration, frame->signal);
+	} else if (!is_multicast_ether_addr(dest)) {
+		/* unicast: the receiver was resolved in queue_frame() */
+		station = frame->receiver;
+		if (station && station != frame->sender &&
+		    !set_interference_duration(ctx, frame->sender->index,
+					       frame->duration, frame->signal)) {
+			if (ctx->trace)
+				trace_frame_now(ctx, TRACE_RX, frame,
+						station->addr, frame->signal);
+			receivers++;
+			send_cloned_frame_msg(shard, station,
+					      frame->data,
+					      frame->data_len,
+					      frame->tx_rates[0].idx,
+					      frame->signal,
+					      frame->freq);
+		}
+	} else {
+		/* rx the frame on every other interface */
 		list_for_each_entry(station, &ctx->stations, list) {
+			int snr, signal, rate_idx;
+			double error_prob;
+
 			if (memcmp(src, station->addr, ETH_ALEN) == 0)
 				continue;
 
-			int rate_idx;
-			if (is_multicast_ether_addr(dest)) {
-				int snr, signal;
-				double error_prob;
-				/*
-				 * we may or may not receive this based on
-				 * reverse link from sender -- check for
-				 * each receiver.
-				 */
-				snr = ctx->get_link_snr(ctx, frame->sender,
-							station);
-				snr += ctx->get_fading_signal(ctx);
-				signal = snr + NOISE_LEVEL;
-				if (signal < CCA_THRESHOLD)
-					continue;
+			/*
+			 * we may or may not receive this based on
+			 * reverse link from sender -- check for
+			 * each receiver.
+			 */
+			snr = ctx->get_link_snr(ctx, frame->sender,
+						station);
+			snr += ctx->get_fading_signal(ctx);
+			signal = snr + NOISE_LEVEL;
+			if (signal < CCA_THRESHOLD)
+				continue;
 
-				if (set_interference_duration(ctx,
-					frame->sender->index, frame->duration,
-					signal))
-					continue;
+			if (set_interference_duration(ctx,
+				frame->sender->index, frame->duration,
+				signal))
+				continue;
 
-				snr -= get_signal_offset_by_interference(ctx,
-					frame->sender->index, station->index);
-				rate_idx = frame->tx_rates[0].idx;
-				error_prob = ctx->get_error_prob(ctx,
-					(double)snr, rate_idx, frame->freq,
-					frame->data_len, frame->sender,
-					station);
-
-				if (drand48() <= error_prob) {
-					w_logf(ctx, LOG_INFO, "Dropped mcast from "
-						   MAC_FMT " to " MAC_FMT " at receiver\n",
-						   MAC_ARGS(src), MAC_ARGS(station->addr));
-					continue;
-				}
+			snr -= get_signal_offset_by_interference(ctx,
+				frame->sender->index, station->index);
+			rate_idx = frame->tx_rates[0].idx;
+			error_prob = ctx->get_error_prob(ctx,
+				(double)snr, rate_idx, frame->freq,
+				frame->data_len, frame->sender,
+				station);
+
+			if (w_drand48() <= error_prob) {
+				w_logf(ctx, LOG_INFO, "Dropped mcast from "
+					   MAC_FMT " to " MAC_FMT " at receiver\n",
+					   MAC_ARGS(src), MAC_ARGS(station->addr));
+				continue;
+			}
 
-				send_cloned_frame_msg(ctx, station,
-						      frame->data,
-						      frame->data_len,
-						      rate_idx, signal,
-						      frame->freq);
-			} else if (memcmp(dest, station->addr, ETH_ALEN) == 0) {
-				if (set_interference_duration(ctx,
-					frame->sender->index, frame->duration,
-					frame->signal))
-					continue;
-				rate_idx = frame->tx_rates[0].idx;
-				send_cloned_frame_msg(ctx, station,
-						      frame->data,
-						      frame->data_len,
-						      rate_idx, frame->signal,
-						      frame->freq);
-  			}
+			if (ctx->trace)
+				trace_frame_now(ctx, TRACE_RX, frame,
+						station->addr, signal);
+			receivers++;
+			if (ctx->source && ctx->source->rx) {
+				ctx->source->rx(ctx->source, station,
+						frame->data, frame->data_len,
+						rate_idx, signal, frame->freq);
+				continue;
+			}
+			/* build the message once, for the first receiver */
+			if (!tmpl.msg &&
+			    frame_msg_tmpl_init(ctx, &tmpl, frame->data,
+						frame->data_len, rate_idx,
+						frame->freq))
+				break;
+			send_frame_msg_tmpl(shard, &tmpl, station, signal);
 		}
-	} else
-		set_interference_duration(ctx, frame->sender->index,
-					  frame->duration, frame->signal);
-
-	send_tx_info_frame_nl(ctx, frame);
-
-	free(frame);
-}
+		if (tmpl.msg)
+			frame_msg_tmpl_free(&tmpl);
+	}
 
-void deliver_expired_frames_queue(struct wmediumd *ctx,
-				  struct list_head *queue,
-				  struct timespec *now)
-{
-	struct frame *frame, *tmp;
+	if (ctx->trace)
+		trace_frame_now(ctx, TRACE_TX_STATUS, frame, NULL,
+				frame->signal);
+	send_tx_info_frame_nl(shard, frame);
 
-	list_for_each_entry_safe(frame, tmp, queue, list) {
-		if (timespec_before(&frame->expires, now)) {
-			list_del(&frame->list);
-			deliver_frame(ctx, frame);
-		} else {
-			break;
-		}
-	}
+	frame_free(&shard->frame_pool, frame);
+	/* the sender's tx status is on the bill of its receivers */
+	lat_record(&shard->lat.delivery,
+		   (lat_now() - start) / (receivers ? receivers : 1));
 }
 
-void deliver_expired_frames(struct wmediumd *ctx)
+void deliver_expired_frames(struct shard *shard)
 {
+	struct wmediumd *ctx = shard->ctx;
 	struct timespec now, _diff;
 	struct station *station;
+	struct wqueue *queue;
+	struct frame *frame;
 	struct list_head *l;
-    int i, j, duration;
-    int sta1_medium_id;
-
-	clock_gettime(CLOCK_MONOTONIC, &now);
-	list_for_each_entry(station, &ctx->stations, list) {
-		int q_ct[IEEE80211_NUM_ACS] = {};
-		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
-			list_for_each(l, &station->queues[i].frames) {
-				q_ct[i]++;
+	struct medium *medium;
+	int i, j, m, a, b, duration;
+
+	w_clock_gettime(ctx, &now);
+	/* per-station queue dump walks every frame; only pay for it if shown */
+	if (ctx->log_lvl >= LOG_DEBUG)
+		list_for_each_entry(station, &ctx->stations, list) {
+			int q_ct[IEEE80211_NUM_ACS] = {};
+
+			if (station_shard(ctx, station) != shard)
+				continue;
+			for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+				list_for_each(l, &station->queues[i].frames) {
+					q_ct[i]++;
+				}
 			}
+			w_logf(ctx, LOG_DEBUG, "[" TIME_FMT "] Station " MAC_FMT
+						   " BK %d BE %d VI %d VO %d\n",
+				   TIME_ARGS(&now), MAC_ARGS(station->addr),
+				   q_ct[IEEE80211_AC_BK], q_ct[IEEE80211_AC_BE],
+				   q_ct[IEEE80211_AC_VI], q_ct[IEEE80211_AC_VO]);
 		}
-		w_logf(ctx, LOG_DEBUG, "[" TIME_FMT "] Station " MAC_FMT
-					   " BK %d BE %d VI %d VO %d\n",
-			   TIME_ARGS(&now), MAC_ARGS(station->addr),
-			   q_ct[IEEE80211_AC_BK], q_ct[IEEE80211_AC_BE],
-			   q_ct[IEEE80211_AC_VI], q_ct[IEEE80211_AC_VO]);
-
-		for (i = 0; i < IEEE80211_NUM_ACS; i++)
-			deliver_expired_frames_queue(ctx, &station->queues[i].frames, &now);
+
+	while ((queue = sched_peek(&shard->sched))) {
+		frame = list_first_entry(&queue->frames, struct frame, list);
+		if (!timespec_before(&frame->expires, &now))
+			break;
+		lat_record(&shard->lat.lateness, timespec_to_ns(&now) -
+			   timespec_to_ns(&frame->expires));
+		list_del(&frame->list);
+		sched_update(&shard->sched, queue);
+		deliver_frame(shard, frame);
 	}
-	w_logf(ctx, LOG_DEBUG, "\n\n");
+	if (ctx->log_lvl >= LOG_DEBUG)
+		w_logf(ctx, LOG_DEBUG, "\n\n");
 
 	if (!ctx->intf)
 		return;
 
-	timespec_sub(&now, &ctx->intf_updated, &_diff);
+	timespec_sub(&now, &shard->intf_updated, &_diff);
 	duration = (_diff.tv_sec * 1000000) + (_diff.tv_nsec / 1000);
 	if (duration < 10000) // calc per 10 msec
 		return;
 
-	// update interference
-	for (i = 0; i < ctx->num_stas; i++){
-        sta1_medium_id = ctx->sta_array[i]->medium_id;
-        for (j = 0; j < ctx->num_stas; j++) {
-            if (i == j)
-                continue;
-            if (sta1_medium_id != ctx->sta_array[j]->medium_id)
-                continue;
-            // probability is used for next calc
-            ctx->intf[i * ctx->num_stas + j].prob_col =
-                    ctx->intf[i * ctx->num_stas + j].duration /
-                    (double)duration;
-            ctx->intf[i * ctx->num_stas + j].duration = 0;
-        }
-    }
+	// update interference, pairs within each medium of this shard
+	for (m = 0; m < ctx->mediums.num; m++) {
+		medium = ctx->mediums.mediums[m];
+		if (medium->shard != shard)
+			continue;
+		for (a = 0; a < medium->num_members; a++) {
+			i = medium->members[a];
+			for (b = 0; b < medium->num_members; b++) {
+				j = medium->members[b];
+				if (i == j)
+					continue;
+				// probability is used for next calc
+				intf_store(ctx->intf[i * ctx->link_stride + j].prob_col,
+					   ctx->intf[i * ctx->link_stride + j].duration /
+					   (double)duration);
+				ctx->intf[i * ctx->link_stride + j].duration = 0;
+			}
+		}
+	}
 
-	clock_gettime(CLOCK_MONOTONIC, &ctx->intf_updated);
+	w_clock_gettime(ctx, &shard->intf_updated);
 }
 
 static
@@ -736,82 +933,238 @@ int nl_err_cb(struct sockaddr_nl *nla, struct nlmsgerr *nlerr, void *arg)
 	return NL_SKIP;
 }
 
+/*
+ * Parse a HWSIM_CMD_FRAME message into @attrs and find its sender.
+ */
+static struct station *parse_frame_nlh(struct wmediumd *ctx,
+				       struct nlmsghdr *nlh,
+				       struct nlattr **attrs)
+{
+	struct station *sender;
+	struct ieee80211_hdr *hdr;
+	u8 *src;
+
+	/* we get the attributes*/
+	genlmsg_parse(nlh, 0, attrs, HWSIM_ATTR_MAX, NULL);
+	if (!attrs[HWSIM_ATTR_ADDR_TRANSMITTER])
+		return NULL;
+
+	hdr = (struct ieee80211_hdr *)nla_data(attrs[HWSIM_ATTR_FRAME]);
+	src = hdr->addr2;
+
+	if (nla_len(attrs[HWSIM_ATTR_FRAME]) < 6 + 6 + 4)
+		return NULL;
+
+	sender = get_station_by_addr(ctx, src);
+	if (!sender)
+		w_flogf(ctx, LOG_ERR, stderr, "Unable to find sender station " MAC_FMT "\n", MAC_ARGS(src));
+	return sender;
+}
+
+/* Record a frame as it came in, for replay, see trace.h */
+static void trace_ingress(struct wmediumd *ctx, struct station *sender,
+			  const u8 *data, unsigned int data_len,
+			  unsigned int flags,
+			  const struct hwsim_tx_rate *tx_rates,
+			  unsigned int tx_rates_count, u64 cookie, u32 freq)
+{
+	const struct ieee80211_hdr *hdr = (const void *)data;
+	unsigned int len = min(data_len, TRACE_HEADER_BYTES);
+	struct trace_record *rec;
+	struct timespec now;
+	uint64_t n;
+	unsigned int i;
+
+	w_clock_gettime(ctx, &now);
+	n = trace_claim(ctx->trace, 1 + trace_data_records(len));
+	trace_put_data(ctx->trace, n + 1, data, len);
+
+	rec = trace_slot(ctx->trace, n);
+	memset(rec, 0, sizeof(*rec));
+	rec->type = TRACE_INGRESS;
+	rec->time_ns = timespec_to_ns(&now);
+	rec->cookie = cookie;
+	rec->flags = flags;
+	rec->freq = freq;
+	rec->data_len = data_len;
+	memcpy(rec->sender, sender->addr, ETH_ALEN);
+	memcpy(rec->receiver, hdr->addr1, ETH_ALEN);
+	for (i = 0; i < TRACE_MAX_RATES; i++) {
+		rec->rates[i].idx = i < tx_rates_count ? tx_rates[i].idx : -1;
+		rec->rates[i].count = i < tx_rates_count ? tx_rates[i].count : 0;
+	}
+	trace_commit(rec, n);
+}
+
+/* Record a server request as it was sent, for replay, see trace.h */
+static void trace_request(struct wmediumd *ctx, const u8 *buf, size_t len)
+{
+	struct trace_record *rec;
+	struct timespec now;
+	uint64_t n;
+
+	w_clock_gettime(ctx, &now);
+	n = trace_claim(ctx->trace, 1 + trace_data_records(len));
+	trace_put_data(ctx->trace, n + 1, buf, len);
+
+	rec = trace_slot(ctx->trace, n);
+	memset(rec, 0, sizeof(*rec));
+	rec->type = TRACE_CONTROL;
+	rec->time_ns = timespec_to_ns(&now);
+	rec->data_len = len;
+	trace_commit(rec, n);
+}
+
+/*
+ * Copy a frame and queue it for later delivery with the scheduler of
+ * @shard, which owns @sender.
+ */
+void queue_frame_data(struct shard *shard, struct station *sender,
+		      const u8 *data, unsigned int data_len,
+		      unsigned int flags, const struct hwsim_tx_rate *tx_rates,
+		      unsigned int tx_rates_count, u64 cookie, u32 freq)
+{
+	struct frame *frame;
+
+	if (shard->ctx->trace)
+		trace_ingress(shard->ctx, sender, data, data_len, flags,
+			      tx_rates, tx_rates_count, cookie, freq);
+
+	frame = frame_alloc(&shard->frame_pool, data_len);
+	if (!frame)
+		return;
+
+	memcpy(frame->data, data, data_len);
+	frame->data_len = data_len;
+	frame->flags = flags;
+	frame->cookie = cookie;
+	frame->freq = freq;
+	frame->sender = sender;
+	sender->freq = freq;
+	frame->tx_rates_count = tx_rates_count;
+	memcpy(frame->tx_rates, tx_rates,
+	       min(tx_rates_count * sizeof(*tx_rates),
+		   sizeof(frame->tx_rates)));
+	queue_frame(shard, sender, frame);
+}
+
+/* @ingest_ns is when the message was received, see latency.h */
+static void queue_frame_attrs(struct shard *shard, struct station *sender,
+			      struct nlattr **attrs, u64 ingest_ns)
+{
+	unsigned int tx_rates_len = nla_len(attrs[HWSIM_ATTR_TX_INFO]);
+	u32 freq;
+
+	freq = attrs[HWSIM_ATTR_FREQ] ?
+		nla_get_u32(attrs[HWSIM_ATTR_FREQ]) : 2412;
+
+	queue_frame_data(shard, sender, nla_data(attrs[HWSIM_ATTR_FRAME]),
+			 nla_len(attrs[HWSIM_ATTR_FRAME]),
+			 nla_get_u32(attrs[HWSIM_ATTR_FLAGS]),
+			 nla_data(attrs[HWSIM_ATTR_TX_INFO]),
+			 tx_rates_len / sizeof(struct hwsim_tx_rate),
+			 nla_get_u64(attrs[HWSIM_ATTR_COOKIE]), freq);
+	lat_record(&shard->lat.ingest, lat_now() - ingest_ns);
+}
+
 /*
  * Handle events from the kernel.  Process CMD_FRAME events and queue them
- * for later delivery with the scheduler.
+ * for later delivery with the scheduler, or hand them to the worker
+ * thread of the sender's shard.
  */
-static int process_messages_cb(struct nl_msg *msg, void *arg)
+static void process_frame_nlh(struct wmediumd *ctx, struct nlmsghdr *nlh)
 {
-	struct wmediumd *ctx = arg;
 	struct nlattr *attrs[HWSIM_ATTR_MAX+1];
-	/* netlink header */
-	struct nlmsghdr *nlh = nlmsg_hdr(msg);
 	/* generic netlink header*/
 	struct genlmsghdr *gnlh = nlmsg_data(nlh);
-
 	struct station *sender;
-	struct frame *frame;
-	struct ieee80211_hdr *hdr;
-	u8 *src;
+	struct shard *shard = NULL;
+	struct lat_hist *wait;
 
-	if (gnlh->cmd == HWSIM_CMD_FRAME) {
-		pthread_rwlock_rdlock(&snr_lock);
-		/* we get the attributes*/
-		genlmsg_parse(nlh, 0, attrs, HWSIM_ATTR_MAX, NULL);
-		if (attrs[HWSIM_ATTR_ADDR_TRANSMITTER]) {
-			u8 *hwaddr = (u8 *)nla_data(attrs[HWSIM_ATTR_ADDR_TRANSMITTER]);
-
-			unsigned int data_len =
-				nla_len(attrs[HWSIM_ATTR_FRAME]);
-			char *data = (char *)nla_data(attrs[HWSIM_ATTR_FRAME]);
-			unsigned int flags =
-				nla_get_u32(attrs[HWSIM_ATTR_FLAGS]);
-			unsigned int tx_rates_len =
-				nla_len(attrs[HWSIM_ATTR_TX_INFO]);
-			struct hwsim_tx_rate *tx_rates =
-				(struct hwsim_tx_rate *)
-				nla_data(attrs[HWSIM_ATTR_TX_INFO]);
-			u64 cookie = nla_get_u64(attrs[HWSIM_ATTR_COOKIE]);
-			u32 freq;
-			freq = attrs[HWSIM_ATTR_FREQ] ?
-					nla_get_u32(attrs[HWSIM_ATTR_FREQ]) : 2412;
-
-			hdr = (struct ieee80211_hdr *)data;
-			src = hdr->addr2;
-
-			if (data_len < 6 + 6 + 4)
-				goto out;
-
-			sender = get_station_by_addr(ctx, src);
-			if (!sender) {
-				w_flogf(ctx, LOG_ERR, stderr, "Unable to find sender station " MAC_FMT "\n", MAC_ARGS(src));
-				goto out;
-			}
-			memcpy(sender->hwaddr, hwaddr, ETH_ALEN);
-
-			frame = malloc(sizeof(*frame) + data_len);
-			if (!frame)
-				goto out;
-
-			memcpy(frame->data, data, data_len);
-			frame->data_len = data_len;
-			frame->flags = flags;
-			frame->cookie = cookie;
-			frame->freq = freq;
-			frame->sender = sender;
-			sender->freq = freq;
-			frame->tx_rates_count =
-				tx_rates_len / sizeof(struct hwsim_tx_rate);
-			memcpy(frame->tx_rates, tx_rates,
-			       min(tx_rates_len, sizeof(frame->tx_rates)));
-			queue_frame(ctx, sender, frame);
-		}
-out:
+	if (gnlh->cmd != HWSIM_CMD_FRAME)
+		return;
+
+	/* the main thread runs shard 0 unless there are workers */
+	wait = ctx->shard_workers ? &ctx->control_lock_wait :
+				    &ctx->shards[0].lat.snr_lock;
+	snr_rdlock(wait);
+	sender = parse_frame_nlh(ctx, nlh, attrs);
+	if (sender && memcmp(sender->hwaddr,
+			     nla_data(attrs[HWSIM_ATTR_ADDR_TRANSMITTER]),
+			     ETH_ALEN)) {
+		/*
+		 * The shards read any station's hwaddr with the read lock
+		 * held, so a new one is only stored under the write lock.
+		 * This happens once per radio; the sender has to be looked
+		 * up again as the lock was dropped.
+		 */
 		pthread_rwlock_unlock(&snr_lock);
-		return 0;
+		snr_wrlock(wait);
+		sender = parse_frame_nlh(ctx, nlh, attrs);
+		if (sender)
+			memcpy(sender->hwaddr,
+			       nla_data(attrs[HWSIM_ATTR_ADDR_TRANSMITTER]),
+			       ETH_ALEN);
+	}
+	if (sender) {
+		shard = station_shard(ctx, sender);
+		if (!ctx->shard_workers) {
+			links_read_lock(&ctx->links);
+			queue_frame_attrs(shard, sender, attrs,
+					  ctx->rx.stamp_ns);
+			links_read_unlock(&ctx->links);
+		}
+	}
+	pthread_rwlock_unlock(&snr_lock);
+
+	if (shard && ctx->shard_workers)
+		shard_dispatch(shard, nlh, ctx->rx.stamp_ns);
+}
+
+/*
+ * Worker side of process_frame_nlh(), with the snr_lock read lock held.
+ */
+void shard_queue_nlh(struct shard *shard, struct nlmsghdr *nlh,
+		     u64 ingest_ns)
+{
+	struct nlattr *attrs[HWSIM_ATTR_MAX+1];
+	struct station *sender;
+
+	sender = parse_frame_nlh(shard->ctx, nlh, attrs);
+	if (!sender)
+		return;
 
+	/* a wserver medium update moved it since it was dispatched */
+	if (station_shard(shard->ctx, sender) != shard) {
+		shard->misrouted++;
+		w_logf(shard->ctx, LOG_INFO, "Dropped frame from " MAC_FMT
+		       ", it changed shards\n", MAC_ARGS(sender->addr));
+		return;
 	}
-	return 0;
+	queue_frame_attrs(shard, sender, attrs, ingest_ns);
+}
+
+/*
+ * Handle one message from hwsim, read from the socket or made up by
+ * fake_hwsim.
+ */
+void process_nlh(struct nlmsghdr *nlh, void *arg)
+{
+	struct wmediumd *ctx = arg;
+
+	if (nlh->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr *nlerr = nlmsg_data(nlh);
+
+		/* plain ACKs for the frames and reports we sent */
+		if (nlerr->error)
+			nl_err_cb(NULL, nlerr, ctx);
+		return;
+	}
+	if (nlh->nlmsg_type != ctx->family_id ||
+	    !genlmsg_valid_hdr(nlh, 0))
+		return;
+
+	process_frame_nlh(ctx, nlh);
 }
 
 /*
@@ -854,7 +1207,11 @@ static void sock_event_cb(int fd, short what, void *data)
 {
 	struct wmediumd *ctx = data;
 
-	nl_recvmsgs_default(ctx->sock);
+	if (nl_rx_drain(&ctx->rx, process_nlh, ctx) < 0)
+		w_logf(ctx, LOG_ERR, "%s: recvmmsg failed: %s\n", __func__,
+		       strerror(errno));
+	if (ctx->shard_workers)
+		shards_wake(ctx);
 }
 
 /*
@@ -891,19 +1248,51 @@ static int init_netlink(struct wmediumd *ctx)
 		return -1;
 	}
 
-	nl_cb_set(ctx->cb, NL_CB_MSG_IN, NL_CB_CUSTOM, process_messages_cb, ctx);
 	nl_cb_err(ctx->cb, NL_CB_CUSTOM, nl_err_cb, ctx);
 
 	return 0;
 }
 
+/*
+ * Read the hwsim socket from the main event loop.
+ */
+static int start_netlink_rx(struct wmediumd *ctx, unsigned long rcvbuf,
+			    struct event *ev_cmd)
+{
+	int ret;
+
+	if (nl_rx_init(&ctx->rx, nl_socket_get_fd(ctx->sock))) {
+		w_flogf(ctx, LOG_ERR, stderr, "Out of memory(nl rx)\n");
+		return -1;
+	}
+	if (rcvbuf) {
+		ret = nl_rx_set_rcvbuf(&ctx->rx, rcvbuf);
+		if (ret < 0)
+			w_logf(ctx, LOG_ERR, "Failed to set receive buffer: %s\n",
+			       strerror(-ret));
+		else if ((unsigned long)ret < rcvbuf)
+			w_logf(ctx, LOG_WARNING, "Receive buffer is only %d "
+			       "bytes, raise net.core.rmem_max\n", ret);
+		else
+			w_logf(ctx, LOG_NOTICE, "Receive buffer: %d bytes\n",
+			       ret);
+	}
+
+	event_set(ev_cmd, nl_socket_get_fd(ctx->sock), EV_READ | EV_PERSIST,
+		  sock_event_cb, ctx);
+	event_add(ev_cmd, NULL);
+	return 0;
+}
+
 /*
  *	Print the CLI help
  */
 void print_help(int exval)
 {
 	printf("wmediumd v%s - a wireless medium simulator\n", VERSION_STR);
-	printf("wmediumd [-h] [-V] [-s] [-l LOG_LVL] [-x FILE] -c FILE\n\n");
+	printf("wmediumd [-h] [-V] [-s] [-l LOG_LVL] [-x FILE] [-b N] [-r BYTES] [-j N]\n"
+	       "         [-H FPS [-t SECONDS] [-T]] [-w FILE [-W N]] [-R FILE [-p]]\n"
+	       "         [-S SEED] -c FILE\n\n");
 
 	printf("  -h              print this help and exit\n");
 	printf("  -V              print version and exit\n\n");
@@ -919,6 +1308,33 @@ void print_help(int exval)
 	printf("  -s              start the server on a socket\n");
 	printf("  -d              use the dynamic complex mode\n");
 	printf("                  (server only with matrices for each connection)\n");
+	printf("  -b N            send at most N netlink messages per syscall\n");
+	printf("                  (default %d, 1 disables batching)\n",
+	       NL_BATCH_DEFAULT_MSGS);
+	printf("  -r BYTES        netlink receive buffer size\n");
+	printf("                  (default %d, 0 keeps the system default)\n",
+	       NL_RX_DEFAULT_RCVBUF);
+	printf("  -j N            deliver frames on N threads, mediums spread\n");
+	printf("                  over them (default 0, all on the main loop;\n");
+	printf("                  disables medium detection)\n");
+	printf("  -H FPS          run without mac80211_hwsim: an in-process fake\n");
+	printf("                  hwsim sends FPS frames per second between\n");
+	printf("                  random stations, then the throughput is printed\n");
+	printf("  -t SECONDS      how long the fake hwsim sends (default %d)\n",
+	       FAKE_HWSIM_DEFAULT_SECONDS);
+	printf("  -T              run the fake hwsim on virtual time, as fast\n");
+	printf("                  as the CPU allows (not with -j)\n");
+	printf("  -w FILE         record every frame in a binary trace file,\n");
+	printf("                  see trace_dump\n");
+	printf("  -W N            keep the last N frame events in the trace\n");
+	printf("                  file (default %d)\n", TRACE_DEFAULT_RECORDS);
+	printf("  -R FILE         replay the frames and server requests of a\n");
+	printf("                  trace file on virtual time, without the\n");
+	printf("                  kernel module (not with -H, -j or -s)\n");
+	printf("  -p              replay at the recorded pace, not flat out\n");
+	printf("  -S SEED         seed the random numbers (default 0x%x, or\n",
+	       DEFAULT_SEED);
+	printf("                  the seed of the trace to replay)\n");
 
 	exit(exval);
 }
@@ -926,21 +1342,89 @@ void print_help(int exval)
 static void timer_cb(int fd, short what, void *data)
 {
 	struct wmediumd *ctx = data;
+	struct shard *shard = &ctx->shards[0];
 	uint64_t u;
 
-	pthread_rwlock_rdlock(&snr_lock);
+	snr_rdlock(&shard->lat.snr_lock);
 	read(fd, &u, sizeof(u));
+	/* publishes new links, so not from inside a read section */
+	ctx->move_stations(ctx);
+	links_read_lock(&ctx->links);
+	deliver_expired_frames(shard);
+	links_read_unlock(&ctx->links);
+	rearm_timer(shard);
+	pthread_rwlock_unlock(&snr_lock);
+
+	if (nl_batch_flush(&shard->tx_batch) < 0)
+		w_logf(ctx, LOG_ERR, "%s: nl_batch_flush failed\n", __func__);
+}
+
+/*
+ * With shard workers, stations are moved from the main thread.  The new
+ * SNR matrix is published to the workers without stopping them.
+ */
+static void move_cb(int fd, short what, void *data)
+{
+	struct wmediumd *ctx = data;
+
+	snr_rdlock(&ctx->control_lock_wait);
 	ctx->move_stations(ctx);
-	deliver_expired_frames(ctx);
-	rearm_timer(ctx);
 	pthread_rwlock_unlock(&snr_lock);
 }
 
+/*
+ * Dump internal counters on SIGUSR1.
+ */
+static void stats_cb(int sig, short what, void *data)
+{
+	struct wmediumd *ctx = data;
+	int i;
+
+	pthread_rwlock_rdlock(&snr_lock);
+	for (i = 0; i < ctx->num_shards; i++) {
+		struct shard *shard = &ctx->shards[i];
+
+		if (ctx->num_shards > 1)
+			printf("shard %d: %llu msgs dispatched, %llu dropped "
+			       "on a full ring, %llu misrouted\n",
+			       i, (unsigned long long)shard->dispatched,
+			       (unsigned long long)shard->ring_dropped,
+			       (unsigned long long)shard->misrouted);
+		frame_pool_print_stats(&shard->frame_pool, stdout);
+		printf("nl tx: %llu msgs in %llu sendto() calls (%llu saved, "
+		       "%llu failed), batch limit %u\n",
+		       (unsigned long long)shard->tx_batch.msgs,
+		       (unsigned long long)shard->tx_batch.syscalls,
+		       (unsigned long long)(shard->tx_batch.msgs -
+					    shard->tx_batch.syscalls),
+		       (unsigned long long)shard->tx_batch.errors,
+		       shard->tx_batch.max_msgs);
+	}
+	printf("nl rx: %llu datagrams in %llu recvmmsg() calls over %llu "
+	       "wakeups, %llu overruns (ENOBUFS), %llu truncated\n",
+	       (unsigned long long)ctx->rx.datagrams,
+	       (unsigned long long)ctx->rx.syscalls,
+	       (unsigned long long)ctx->rx.wakeups,
+	       (unsigned long long)ctx->rx.overruns,
+	       (unsigned long long)ctx->rx.truncated);
+	pthread_mutex_lock(&ctx->links.writer);
+	printf("links: version %llu, %llu publishes (%llu full copies)\n",
+	       (unsigned long long)ctx->links.cur->version,
+	       (unsigned long long)ctx->links.publishes,
+	       (unsigned long long)ctx->links.full_copies);
+	pthread_mutex_unlock(&ctx->links.writer);
+	pthread_rwlock_unlock(&snr_lock);
+	latency_print(ctx, stdout);
+}
+
 int main(int argc, char *argv[])
 {
 	int opt;
 	struct event ev_cmd;
 	struct event ev_timer;
+	struct event ev_stats;
+	struct event ev_move;
+	struct timeval move_interval = { .tv_sec = MOVE_INTERVAL };
 	struct wmediumd ctx;
 	char *config_file = NULL;
 	char *per_file = NULL;
@@ -952,13 +1436,30 @@ int main(int argc, char *argv[])
 		print_help(EXIT_FAILURE);
 	}
 
+	memset(&ctx, 0, sizeof(ctx));
 	ctx.log_lvl = 6;
 	unsigned long int parse_log_lvl;
 	char* parse_end_token;
 	bool start_server = false;
 	bool full_dynamic = false;
+	unsigned long int batch_msgs = NL_BATCH_DEFAULT_MSGS;
+	unsigned long int rcvbuf = NL_RX_DEFAULT_RCVBUF;
+	unsigned long int workers = 0;
+	unsigned long int fake_rate = 0;
+	unsigned long int fake_seconds = FAKE_HWSIM_DEFAULT_SECONDS;
+	bool virtual_time = false;
+	struct fake_hwsim fake;
+	const char *trace_file = NULL;
+	unsigned long int trace_records = TRACE_DEFAULT_RECORDS;
+	struct trace trace;
+	const char *replay_file = NULL;
+	bool replay_paced = false;
+	struct replay replay;
+	unsigned long long seed = DEFAULT_SEED;
+	bool seed_set = false;
+	int ret;
 
-	while ((opt = getopt(argc, argv, "hVc:l:x:sd")) != -1) {
+	while ((opt = getopt(argc, argv, "hVc:l:x:sdb:r:j:H:t:Tw:W:R:pS:")) != -1) {
 		switch (opt) {
 		case 'h':
 			print_help(EXIT_SUCCESS);
@@ -993,6 +1494,83 @@ int main(int argc, char *argv[])
 		case 'd':
 			full_dynamic = true;
 			break;
+		case 'b':
+			batch_msgs = strtoul(optarg, &parse_end_token, 10);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    batch_msgs == 0 || batch_msgs > UINT_MAX) {
+				printf("wmediumd: Error - Invalid batch size: "
+				       "%s\n\n", optarg);
+				print_help(EXIT_FAILURE);
+			}
+			break;
+		case 'r':
+			rcvbuf = strtoul(optarg, &parse_end_token, 10);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    rcvbuf > INT_MAX) {
+				printf("wmediumd: Error - Invalid receive buffer "
+				       "size: %s\n\n", optarg);
+				print_help(EXIT_FAILURE);
+			}
+			break;
+		case 'j':
+			workers = strtoul(optarg, &parse_end_token, 10);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    workers > SHARD_MAX_WORKERS) {
+				printf("wmediumd: Error - Invalid number of "
+				       "workers: %s\n\n", optarg);
+				print_help(EXIT_FAILURE);
+			}
+			break;
+		case 'H':
+			fake_rate = strtoul(optarg, &parse_end_token, 10);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    fake_rate == 0 || fake_rate > UINT_MAX) {
+				printf("wmediumd: Error - Invalid frame rate: "
+				       "%s\n\n", optarg);
+				print_help(EXIT_FAILURE);
+			}
+			break;
+		case 't':
+			fake_seconds = strtoul(optarg, &parse_end_token, 10);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    fake_seconds > UINT_MAX) {
+				printf("wmediumd: Error - Invalid duration: "
+				       "%s\n\n", optarg);
+				print_help(EXIT_FAILURE);
+			}
+			break;
+		case 'T':
+			virtual_time = true;
+			break;
+		case 'w':
+			trace_file = optarg;
+			break;
+		case 'W':
+			trace_records = strtoul(optarg, &parse_end_token, 10);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    trace_records == 0 || trace_records > UINT_MAX) {
+				printf("wmediumd: Error - Invalid number of trace "
+				       "records: %s\n\n", optarg);
+				print_help(EXIT_FAILURE);
+			}
+			break;
+		case 'R':
+			replay_file = optarg;
+			break;
+		case 'p':
+			replay_paced = true;
+			break;
+		case 'S':
+			errno = 0;
+			seed = strtoull(optarg, &parse_end_token, 0);
+			if (optarg == parse_end_token || *parse_end_token ||
+			    errno == ERANGE) {
+				printf("wmediumd: Error - Invalid seed: %s\n\n",
+				       optarg);
+				print_help(EXIT_FAILURE);
+			}
+			seed_set = true;
+			break;
 		case 's':
 			start_server = true;
 			break;
@@ -1008,13 +1586,27 @@ int main(int argc, char *argv[])
 	if (optind < argc)
 		print_help(EXIT_FAILURE);
 
+	if (virtual_time && (!fake_rate || workers)) {
+		printf("%s: virtual time needs -H and no -j\n", argv[0]);
+		print_help(EXIT_FAILURE);
+	}
+
+	if (replay_file && (fake_rate || workers || start_server)) {
+		printf("%s: replay needs no -H, -j or -s\n", argv[0]);
+		print_help(EXIT_FAILURE);
+	}
+	if (replay_file && trace_file && !strcmp(replay_file, trace_file)) {
+		printf("%s: cannot trace into the trace to replay\n", argv[0]);
+		print_help(EXIT_FAILURE);
+	}
+
 	if (full_dynamic) {
 		if (config_file) {
 			printf("%s: cannot use dynamic complex mode with config file\n", argv[0]);
 			print_help(EXIT_FAILURE);
 		}
 
-		if (!start_server) {
+		if (!start_server && !replay_file) {
 			printf("%s: dynamic complex mode requires the server option\n", argv[0]);
 			print_help(EXIT_FAILURE);
 		}
@@ -1028,47 +1620,143 @@ int main(int argc, char *argv[])
 
 		w_logf(&ctx, LOG_NOTICE, "Input configuration file: %s\n", config_file);
 	}
+	if (replay_file) {
+		ret = replay_open(&replay, replay_file, replay_paced);
+		if (ret) {
+			w_flogf(&ctx, LOG_ERR, stderr, "Failed to open trace "
+				"file %s: %s\n", replay_file, strerror(-ret));
+			return EXIT_FAILURE;
+		}
+		if (!seed_set)
+			seed = replay_seed(&replay);
+	}
+	srand48(seed);
+
 	INIT_LIST_HEAD(&ctx.stations);
+	if (shards_init(&ctx, workers ? workers : 1)) {
+		w_flogf(&ctx, LOG_ERR, stderr, "Out of memory(shards)\n");
+		return EXIT_FAILURE;
+	}
+	path_loss_soa_init(&ctx.path_loss_soa);
+	sta_table_init(&ctx.sta_table);
+	medium_table_init(&ctx.mediums);
+	addr_index_init(&ctx.sta_by_addr, offsetof(struct station, addr));
 	if (load_config(&ctx, config_file, per_file, full_dynamic))
 		return EXIT_FAILURE;
+	if (links_init(&ctx))
+		return EXIT_FAILURE;
+
+	if (trace_file) {
+		ret = trace_open(&trace, trace_file, trace_records, seed);
+		if (ret) {
+			w_flogf(&ctx, LOG_ERR, stderr, "Failed to open trace "
+				"file %s: %s\n", trace_file, strerror(-ret));
+			return EXIT_FAILURE;
+		}
+		ctx.trace = &trace;
+		ctx.record_request = trace_request;
+		w_logf(&ctx, LOG_NOTICE, "Tracing frames to %s\n", trace_file);
+	}
+
+	/* detection regroups stations from the data path, across shards */
+	if (workers && ctx.enable_medium_detection) {
+		w_logf(&ctx, LOG_NOTICE, "Medium detection is disabled with -j\n");
+		ctx.enable_medium_detection = false;
+	}
 
 	/* init libevent */
 	event_init();
 
-	/* init netlink */
-	if (init_netlink(&ctx) < 0)
+	/* init netlink, or what stands in for it */
+	if (fake_rate || replay_file) {
+		if (fake_hwsim_init(&ctx, &fake, fake_rate, fake_seconds))
+			return EXIT_FAILURE;
+	} else if (init_netlink(&ctx) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	ret = shards_start(&ctx, workers, batch_msgs);
+	if (ret) {
+		w_flogf(&ctx, LOG_ERR, stderr, "Failed to start shards: %s\n",
+			strerror(-ret));
 		return EXIT_FAILURE;
+	}
+	if (workers)
+		w_logf(&ctx, LOG_NOTICE, "%lu medium workers\n", workers);
 
-	event_set(&ev_cmd, nl_socket_get_fd(ctx.sock), EV_READ | EV_PERSIST,
-		  sock_event_cb, &ctx);
-	event_add(&ev_cmd, NULL);
+	if (!fake_rate && !replay_file && start_netlink_rx(&ctx, rcvbuf, &ev_cmd))
+		return EXIT_FAILURE;
 
 	/* setup timers */
-	ctx.timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
-	clock_gettime(CLOCK_MONOTONIC, &ctx.intf_updated);
-	clock_gettime(CLOCK_MONOTONIC, &ctx.next_move);
+	w_clock_gettime(&ctx, &ctx.next_move);
 	ctx.next_move.tv_sec += MOVE_INTERVAL;
-	event_set(&ev_timer, ctx.timerfd, EV_READ | EV_PERSIST, timer_cb, &ctx);
-	event_add(&ev_timer, NULL);
+	if (workers) {
+		event_set(&ev_move, -1, EV_PERSIST, move_cb, &ctx);
+		event_add(&ev_move, &move_interval);
+	} else {
+		event_set(&ev_timer, ctx.shards[0].timerfd, EV_READ | EV_PERSIST,
+			  timer_cb, &ctx);
+		event_add(&ev_timer, NULL);
+	}
+
+	signal_set(&ev_stats, SIGUSR1, stats_cb, &ctx);
+	signal_add(&ev_stats, NULL);
 
 	/* register for new frames */
-	if (send_register_msg(&ctx) == 0) {
+	if (!fake_rate && !replay_file && send_register_msg(&ctx) == 0) {
 		w_logf(&ctx, LOG_NOTICE, "REGISTER SENT!\n");
 	}
 
 	if (start_server == true)
 		start_wserver(&ctx);
 
+	if (fake_rate) {
+		ret = fake_hwsim_start(&fake, virtual_time);
+		if (ret) {
+			w_flogf(&ctx, LOG_ERR, stderr, "Failed to start the fake "
+				"hwsim: %s\n", strerror(-ret));
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (replay_file) {
+		ret = replay_run(&replay, &ctx, &fake);
+		if (ret) {
+			w_flogf(&ctx, LOG_ERR, stderr, "Failed to replay: %s\n",
+				strerror(-ret));
+			return EXIT_FAILURE;
+		}
+	}
+
 	/* enter libevent main loop */
-	event_dispatch();
+	if (!virtual_time && !replay_file)
+		event_dispatch();
 
 	if (start_server == true)
 		stop_wserver();
+	shards_stop(&ctx);
+	if (replay_file) {
+		replay_report(&replay);
+		replay_free(&replay);
+	}
+	if (fake_rate || replay_file) {
+		fake_hwsim_report(&fake);
+		fake_hwsim_free(&fake);
+	}
 
+	if (ctx.trace)
+		trace_close(ctx.trace);
+	nl_rx_free(&ctx.rx);
 	free(ctx.sock);
 	free(ctx.cb);
 	free(ctx.intf);
 	free(ctx.per_matrix);
+	links_free(&ctx);
+	shards_free(&ctx);
+	path_loss_soa_free(&ctx.path_loss_soa);
+	sta_table_free(&ctx.sta_table);
+	medium_table_free(&ctx.mediums);
+	addr_index_free(&ctx.sta_by_addr);
 
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -113,6 +113,18 @@ enum {
 
 #include "list.h"
 #include "ieee80211.h"
+#include "sched.h"
+#include "addr_index.h"
+#include "sta_table.h"
+#include "medium.h"
+#include "shard.h"
+#include "links.h"
+#include "frame_pool.h"
+#include "nl_batch.h"
+#include "nl_rx.h"
+#include "path_loss.h"
+#include "latency.h"
+#include "trace.h"
 
 typedef uint8_t u8;
 typedef uint32_t u32;
@@ -136,6 +148,7 @@ struct wqueue {
 	struct list_head frames;
 	int cw_min;
 	int cw_max;
+	int sched_idx;			/* position in ctx->sched, -1 if idle */
 };
 
 struct station {
@@ -153,24 +166,40 @@ struct station {
 	struct wqueue queues[IEEE80211_NUM_ACS];
 	struct list_head list;
     int medium_id;
+	struct medium *medium;		/* members sharing medium_id */
 };
 
 struct wmediumd {
-	int timerfd;
+	struct shard *shards;
+	int num_shards;
+	bool shard_workers;		/* shards run on their own threads */
 
 	struct nl_sock *sock;
+	struct nl_rx rx;
+	struct frame_source *source;	/* instead of sock, see vtime.h */
+	struct timespec vnow;		/* virtual time, with a source */
+	struct trace *trace;		/* frame trace file, NULL if off */
+	/* called with each server request as it was sent, NULL if off */
+	void (*record_request)(struct wmediumd *ctx, const u8 *buf, size_t len);
+	struct lat_hist control_lock_wait;	/* snr_lock, off the shards */
     bool enable_medium_detection;
 	int num_stas;
+	int link_stride;		/* row length of link matrices, >= num_stas */
 	struct list_head stations;
 	struct station **sta_array;
+	struct sta_table sta_table;
+	struct medium_table mediums;
+	struct addr_index sta_by_addr;
+	/* the writers' copy; the data path reads links_current(&links) */
 	int *snr_matrix;
 	double *error_prob_matrix;
 	double **station_err_matrix;
+	struct links links;
 	struct intf_info *intf;
-	struct timespec intf_updated;
 #define MOVE_INTERVAL	(3) /* station movement interval [sec] */
 	struct timespec next_move;
 	void *path_loss_param;
+	struct path_loss_soa path_loss_soa;
 	float *per_matrix;
 	int per_matrix_row_num;
 	int per_matrix_signal_min;
@@ -208,11 +237,21 @@ struct frame {
 	int duration;
 	int tx_rates_count;
 	struct station *sender;
+	struct station *receiver;	/* unicast dest, NULL if mcast/unknown */
 	struct hwsim_tx_rate tx_rates[IEEE80211_TX_MAX_RATES];
 	size_t data_len;
 	u8 data[0];			/* frame contents */
 };
 
+/* HWSIM_CMD_FRAME message shared by all receivers of one frame */
+struct frame_msg_tmpl {
+	struct nl_msg *msg;
+	u8 *receiver;			/* HWSIM_ATTR_ADDR_RECEIVER payload */
+	void *signal;			/* HWSIM_ATTR_SIGNAL payload */
+	size_t head_len;		/* offset of the HWSIM_ATTR_FRAME payload */
+	int data_len;
+};
+
 struct log_distance_model_param {
 	double path_loss_exponent;
 	double Xg;
@@ -243,15 +282,41 @@ struct intf_info {
 	double prob_col;
 };
 
+/* The shard owning the queues of @station */
+static inline struct shard *station_shard(struct wmediumd *ctx,
+					  struct station *station)
+{
+	return station->medium ? station->medium->shard : &ctx->shards[0];
+}
+
 void station_init_queues(struct station *station);
+void rearm_timer(struct shard *shard);
+void deliver_expired_frames(struct shard *shard);
+void shard_queue_nlh(struct shard *shard, struct nlmsghdr *nlh,
+		     u64 ingest_ns);
+void process_nlh(struct nlmsghdr *nlh, void *arg);
 double get_error_prob_from_snr(double snr, unsigned int rate_idx, u32 freq,
 			       int frame_len);
+double get_error_prob_from_snr_analytic(double snr, unsigned int rate_idx,
+					u32 freq, int frame_len);
 bool timespec_before(struct timespec *t1, struct timespec *t2);
+u64 timespec_to_ns(const struct timespec *t);
+void ns_to_timespec(u64 ns, struct timespec *t);
+void w_clock_gettime(struct wmediumd *ctx, struct timespec *now);
+void queue_frame_data(struct shard *shard, struct station *sender,
+		      const u8 *data, unsigned int data_len,
+		      unsigned int flags, const struct hwsim_tx_rate *tx_rates,
+		      unsigned int tx_rates_count, u64 cookie, u32 freq);
 int set_default_per(struct wmediumd *ctx);
 int read_per_file(struct wmediumd *ctx, const char *file_name);
 int w_logf(struct wmediumd *ctx, u8 level, const char *format, ...);
 int w_flogf(struct wmediumd *ctx, u8 level, FILE *stream, const char *format, ...);
 int index_to_rate(size_t index, u32 freq);
 void detect_mediums(struct wmediumd *ctx, struct station *src, struct station *dest);
+struct station *get_station_by_addr(struct wmediumd *ctx, const u8 *addr);
+int station_index_add(struct wmediumd *ctx, struct station *station);
+void station_index_del(struct wmediumd *ctx, struct station *station);
+int station_table_sync(struct wmediumd *ctx);
+void station_table_update(struct wmediumd *ctx, struct station *station);
 
 #endif /* WMEDIUMD_H_ */
@@ -26,232 +26,501 @@
 #define DEFAULT_DYNAMIC_SNR -10
 #define DEFAULT_DYNAMIC_ERRPROB 1.0
 #define DEFAULT_FULL_DYNAMIC_ERRPROB 1.0
+#define LINK_STRIDE_MIN 16
+#define SPECIFIC_MATRIX_LEN (SPECIFIC_MATRIX_MAX_SIZE_IDX * SPECIFIC_MATRIX_MAX_RATE_IDX)
 
 pthread_rwlock_t snr_lock = PTHREAD_RWLOCK_INITIALIZER;
 
-#define swap_matrix(matrix_ptr, oldsize, newsize, elem_type, backup_ptr) \
-    backup_ptr = malloc(sizeof(elem_type) * oldsize * oldsize); \
-    memcpy(backup_ptr, matrix_ptr, sizeof(elem_type) * oldsize * oldsize); \
-    free(matrix_ptr); \
-    matrix_ptr = malloc(sizeof(elem_type) * newsize * newsize);
+// Copy the first num rows and columns of matrix into rows of stride entries
+static void *restride_matrix(const void *matrix, size_t size, int old_stride,
+                             int stride, int num) {
+    char *grown = calloc((size_t) stride * stride, size);
+    if (!grown) {
+        return NULL;
+    }
+    for (int x = 0; x < num; x++) {
+        memcpy(grown + size * ((size_t) x * stride),
+               (const char *) matrix + size * ((size_t) x * old_stride), size * num);
+    }
+    return grown;
+}
 
-int add_station(struct wmediumd *ctx, const u8 addr[]) {
-    struct station *sta_loop;
-    list_for_each_entry(sta_loop, &ctx->stations, list) {
-        if (memcmp(sta_loop->addr, addr, ETH_ALEN) == 0)
-            return -EEXIST;
-    }
-
-    pthread_rwlock_wrlock(&snr_lock);
-    size_t oldnum = (size_t) ctx->num_stas;
-    size_t newnum = oldnum + 1;
-
-    // Save old matrix and init new matrix
-    union {
-        int *old_snr_matrix;
-        double *old_errprob_matrix;
-        double **old_station_err_matrix;
-    } matrizes;
-    int ret;
-    if (ctx->station_err_matrix != NULL) {
-        swap_matrix(ctx->station_err_matrix, oldnum, newnum, double*, matrizes.old_station_err_matrix);
-    } else if (ctx->error_prob_matrix != NULL) {
-        swap_matrix(ctx->error_prob_matrix, oldnum, newnum, double, matrizes.old_errprob_matrix);
-    } else {
-        swap_matrix(ctx->snr_matrix, oldnum, newnum, int, matrizes.old_snr_matrix);
-    }
-
-    // Copy old matrix
-    for (size_t x = 0; x < oldnum; x++) {
-        for (size_t y = 0; y < oldnum; y++) {
-            if (ctx->station_err_matrix != NULL) {
-                ctx->station_err_matrix[x * newnum + y] = matrizes.old_station_err_matrix[x * oldnum + y];
-            } else if (ctx->error_prob_matrix != NULL) {
-                ctx->error_prob_matrix[x * newnum + y] = matrizes.old_errprob_matrix[x * oldnum + y];
-            } else {
-                ctx->snr_matrix[x * newnum + y] = matrizes.old_snr_matrix[x * oldnum + y];
-            }
+/*
+ * Make room for count more stations.  sta_array and the link matrices keep
+ * rows of ctx->link_stride entries and double it when full, so adding N
+ * stations copies O(N^2) entries in total instead of O(N^3).
+ */
+static int reserve_stations(struct wmediumd *ctx, int count) {
+    int num = ctx->num_stas;
+    int stride = ctx->link_stride;
+    struct station **sta_array;
+
+    if (sta_table_reserve(&ctx->sta_table, num + count)) {
+        return -ENOMEM;
+    }
+    if (num + count <= stride) {
+        return 0;
+    }
+    if (stride < LINK_STRIDE_MIN) {
+        stride = LINK_STRIDE_MIN;
+    }
+    while (stride < num + count) {
+        stride *= 2;
+    }
+
+    sta_array = realloc(ctx->sta_array, stride * sizeof(*sta_array));
+    if (!sta_array) {
+        return -ENOMEM;
+    }
+    ctx->sta_array = sta_array;
+
+    int *snr = NULL, *old_snr = ctx->snr_matrix;
+    double *errprob = NULL, *old_errprob = ctx->error_prob_matrix;
+    double **station_err = NULL, **old_station_err = ctx->station_err_matrix;
+    struct intf_info *intf = NULL, *old_intf = ctx->intf;
+    int old_stride = ctx->link_stride;
+
+    if (old_snr) {
+        snr = restride_matrix(old_snr, sizeof(*snr), old_stride, stride, num);
+    }
+    if (old_errprob) {
+        errprob = restride_matrix(old_errprob, sizeof(*errprob), old_stride, stride, num);
+    }
+    if (old_station_err) {
+        station_err = restride_matrix(old_station_err, sizeof(*station_err), old_stride, stride, num);
+    }
+    if (old_intf) {
+        intf = restride_matrix(old_intf, sizeof(*intf), old_stride, stride, num);
+    }
+    if ((old_snr && !snr) || (old_errprob && !errprob) ||
+        (old_station_err && !station_err) || (old_intf && !intf)) {
+        goto nomem;
+    }
+
+    ctx->snr_matrix = snr;
+    ctx->error_prob_matrix = errprob;
+    ctx->station_err_matrix = station_err;
+    ctx->intf = intf;
+    ctx->link_stride = stride;
+    // Readers are held off by the write lock, republish both copies
+    if (links_reset(ctx)) {
+        ctx->snr_matrix = old_snr;
+        ctx->error_prob_matrix = old_errprob;
+        ctx->station_err_matrix = old_station_err;
+        ctx->intf = old_intf;
+        ctx->link_stride = old_stride;
+        goto nomem;
+    }
+    free(old_snr);
+    free(old_errprob);
+    free(old_station_err);
+    free(old_intf);
+    return 0;
+
+    nomem:
+    free(snr);
+    free(errprob);
+    free(station_err);
+    free(intf);
+    return -ENOMEM;
+}
+
+static double *new_specific_matrix(void) {
+    double *mat = malloc(SPECIFIC_MATRIX_LEN * sizeof(*mat));
+    if (mat) {
+        for (int i = 0; i < SPECIFIC_MATRIX_LEN; i++) {
+            mat[i] = DEFAULT_FULL_DYNAMIC_ERRPROB;
         }
     }
+    return mat;
+}
+
+// Default links between the station at index and the ones before it
+static int init_links(struct wmediumd *ctx, int index) {
+    size_t stride = (size_t) ctx->link_stride;
+
+    for (size_t x = 0; x <= (size_t) index; x++) {
+        size_t col = x * stride + index, row = index * stride + x;
 
-    // Fill last lines with default snr
-    for (size_t x = 0; x < newnum; x++) {
         if (ctx->station_err_matrix != NULL) {
-            ctx->station_err_matrix[x * newnum + oldnum] = malloc(
-                    SPECIFIC_MATRIX_MAX_SIZE_IDX * SPECIFIC_MATRIX_MAX_RATE_IDX * sizeof(double));
-            for (int i = 0; i < SPECIFIC_MATRIX_MAX_SIZE_IDX * SPECIFIC_MATRIX_MAX_RATE_IDX; i++) {
-                ctx->station_err_matrix[x * newnum + oldnum][i] = DEFAULT_FULL_DYNAMIC_ERRPROB;
+            ctx->station_err_matrix[col] = new_specific_matrix();
+            if (!ctx->station_err_matrix[col]) {
+                return -ENOMEM;
             }
-        } else if (ctx->error_prob_matrix != NULL) {
-            ctx->error_prob_matrix[x * newnum + oldnum] = DEFAULT_DYNAMIC_ERRPROB;
-        } else {
-            ctx->snr_matrix[x * newnum + oldnum] = DEFAULT_DYNAMIC_SNR;
+            if (row != col) {
+                ctx->station_err_matrix[row] = new_specific_matrix();
+                if (!ctx->station_err_matrix[row]) {
+                    return -ENOMEM;
+                }
+            }
+        }
+        if (ctx->error_prob_matrix != NULL) {
+            ctx->error_prob_matrix[col] = ctx->error_prob_matrix[row] = DEFAULT_DYNAMIC_ERRPROB;
+        }
+        if (ctx->snr_matrix != NULL) {
+            ctx->snr_matrix[col] = ctx->snr_matrix[row] = DEFAULT_DYNAMIC_SNR;
+        }
+        if (ctx->intf != NULL) {
+            memset(&ctx->intf[col], 0, sizeof(*ctx->intf));
+            memset(&ctx->intf[row], 0, sizeof(*ctx->intf));
+            ctx->intf[col].signal = ctx->intf[row].signal = -200;
         }
     }
-    for (size_t y = 0; y < newnum; y++) {
-        if (ctx->station_err_matrix != NULL) {
-            ctx->station_err_matrix[oldnum * newnum + y] = malloc(
-                    SPECIFIC_MATRIX_MAX_SIZE_IDX * SPECIFIC_MATRIX_MAX_RATE_IDX * sizeof(double));
-            for (int i = 0; i < SPECIFIC_MATRIX_MAX_SIZE_IDX * SPECIFIC_MATRIX_MAX_RATE_IDX; i++) {
-                ctx->station_err_matrix[oldnum * newnum + y][i] = DEFAULT_FULL_DYNAMIC_ERRPROB;
-            }
-        } else if (ctx->error_prob_matrix != NULL) {
-            ctx->error_prob_matrix[oldnum * newnum + y] = DEFAULT_DYNAMIC_ERRPROB;
-        } else {
-            ctx->snr_matrix[oldnum * newnum + y] = DEFAULT_DYNAMIC_SNR;
+    links_touch_station(ctx, index);
+    return 0;
+}
+
+// Free the specific matrices of the links of the station at index
+static void free_specific_matrices(struct wmediumd *ctx, int index) {
+    size_t stride = (size_t) ctx->link_stride;
+
+    for (size_t x = 0; x < (size_t) ctx->num_stas; x++) {
+        free(ctx->station_err_matrix[x * stride + index]);
+        ctx->station_err_matrix[x * stride + index] = NULL;
+        if (x != (size_t) index) {
+            free(ctx->station_err_matrix[index * stride + x]);
+            ctx->station_err_matrix[index * stride + x] = NULL;
         }
     }
+}
 
-    if (ctx->station_err_matrix != NULL) {
-        free(matrizes.old_station_err_matrix);
-    } else if (ctx->error_prob_matrix != NULL) {
-        free(matrizes.old_errprob_matrix);
-    } else {
-        free(matrizes.old_snr_matrix);
+/*
+ * The station at from takes index to: its row and column replace those of
+ * the station at to, and the links between the two are dropped.
+ */
+static void move_links(void *matrix, size_t size, size_t stride, int num,
+                       int from, int to) {
+    char *m = matrix;
+
+    if (!m) {
+        return;
+    }
+    for (int y = 0; y < num; y++) {
+        if (y != from) {
+            memcpy(m + size * (to * stride + y),
+                   m + size * (from * stride + (y == to ? from : y)), size);
+        }
+    }
+    for (int x = 0; x < num; x++) {
+        if (x != to && x != from) {
+            memcpy(m + size * (x * stride + to), m + size * (x * stride + from), size);
+        }
+    }
+}
+
+// Create a station at the next index, space reserved and links write section held
+static int create_station(struct wmediumd *ctx, const u8 addr[]) {
+    int index = ctx->num_stas;
+
+    if (init_links(ctx, index)) {
+        return -ENOMEM;
     }
 
     // Init new station object
     struct station *station;
     station = malloc(sizeof(*station));
     if (!station) {
-        ret = -ENOMEM;
-        goto out;
+        return -ENOMEM;
     }
-    station->index = (int) oldnum;
+    station->index = index;
     memcpy(station->addr, addr, ETH_ALEN);
     memcpy(station->hwaddr, addr, ETH_ALEN);
     station->isap = AP_DEFAULT;
     station->gain = GAIN_DEFAULT;
     station->tx_power = SNR_DEFAULT;
     station->medium_id = MEDIUM_ID_DEFAULT;
+    station->medium = NULL;
     station_init_queues(station);
-    list_add_tail(&station->list, &ctx->stations);
-    //realloc(ctx->sta_array, 1);
+    if (station_index_add(ctx, station)) {
+        free(station);
+        return -ENOMEM;
+    }
     ctx->sta_array[station->index] = station;
-    ctx->num_stas = (int) newnum;
-    ret = station->index;
+    station_table_update(ctx, station);
+    if (station_set_medium(ctx, station, station->medium_id)) {
+        station_index_del(ctx, station);
+        free(station);
+        return -ENOMEM;
+    }
+    list_add_tail(&station->list, &ctx->stations);
+    ctx->num_stas = index + 1;
+    return index;
+}
 
-    out:
+int add_station(struct wmediumd *ctx, const u8 addr[]) {
+    snr_wrlock(&ctx->control_lock_wait);
+    if (get_station_by_addr(ctx, addr)) {
+        pthread_rwlock_unlock(&snr_lock);
+        return -EEXIST;
+    }
+
+    if (reserve_stations(ctx, 1)) {
+        pthread_rwlock_unlock(&snr_lock);
+        return -ENOMEM;
+    }
+
+    links_write_begin(ctx);
+    int ret = create_station(ctx, addr);
+    links_write_end(ctx);
     pthread_rwlock_unlock(&snr_lock);
     return ret;
 }
 
-int del_station(struct wmediumd *ctx, struct station *station) {
-    if (ctx->num_stas == 0) {
-        return -ENXIO;
+int add_stations(struct wmediumd *ctx, const u8 (*addrs)[ETH_ALEN], int count, i32 *ids) {
+    snr_wrlock(&ctx->control_lock_wait);
+    if (reserve_stations(ctx, count)) {
+        pthread_rwlock_unlock(&snr_lock);
+        return -ENOMEM;
+    }
+
+    int ret = 0;
+
+    links_write_begin(ctx);
+    for (int i = 0; i < count; i++) {
+        if (ret) {
+            ids[i] = ret;
+        } else if (get_station_by_addr(ctx, addrs[i])) {
+            ids[i] = -EEXIST;
+        } else {
+            ids[i] = create_station(ctx, addrs[i]);
+            if (ids[i] < 0) {
+                ret = ids[i];
+            }
+        }
     }
-    size_t oldnum = (size_t) ctx->num_stas;
-    size_t newnum = oldnum - 1;
+    links_write_end(ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    return ret;
+}
+
+// Unlink and free a station, links write section held; mediums are left stale
+static void remove_station(struct wmediumd *ctx, struct station *station) {
+    int index = station->index;
+    int last = ctx->num_stas - 1;
 
-    // Save old matrix and init new matrix
-    union {
-        int *old_snr_matrix;
-        double *old_errprob_matrix;
-        double **old_station_err_matrix;
-    } matrizes;
     if (ctx->station_err_matrix != NULL) {
-        swap_matrix(ctx->station_err_matrix, oldnum, newnum, double*, matrizes.old_station_err_matrix);
-    } else if (ctx->error_prob_matrix != NULL) {
-        swap_matrix(ctx->error_prob_matrix, oldnum, newnum, double, matrizes.old_errprob_matrix);
-    } else {
-        swap_matrix(ctx->snr_matrix, oldnum, newnum, int, matrizes.old_snr_matrix);
+        free_specific_matrices(ctx, index);
     }
 
-    size_t index = (size_t) station->index;
+    // The last station takes the freed index, nothing else moves
+    if (index != last) {
+        struct station *moved = ctx->sta_array[last];
+        size_t stride = (size_t) ctx->link_stride;
 
-    // Decreasing index of stations following deleted station
-    struct station *sta_loop = station;
-    list_for_each_entry_from(sta_loop, &ctx->stations, list) {
-        sta_loop->index = sta_loop->index - 1;
+        move_links(ctx->snr_matrix, sizeof(*ctx->snr_matrix), stride, last + 1, last, index);
+        move_links(ctx->error_prob_matrix, sizeof(*ctx->error_prob_matrix), stride, last + 1, last, index);
+        move_links(ctx->station_err_matrix, sizeof(*ctx->station_err_matrix), stride, last + 1, last, index);
+        move_links(ctx->intf, sizeof(*ctx->intf), stride, last + 1, last, index);
+        links_touch_station(ctx, index);
+
+        moved->index = index;
+        ctx->sta_array[index] = moved;
+        station_table_update(ctx, moved);
     }
 
-    if (ctx->station_err_matrix != NULL) {
-        for (size_t x = 0; x < oldnum; x++) {
-            // free old specific matrices
-            if (matrizes.old_station_err_matrix[x * oldnum + index] != NULL) {
-                free(matrizes.old_station_err_matrix[x * oldnum + index]);
-            }
-        }
+    // Drop frames still queued for the station
+    struct shard *shard = station_shard(ctx, station);
+    for (int ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+        struct frame *frame, *tmp;
 
-        for (size_t y = 0; y < oldnum; y++) {
-            if(y == index){
-                continue;
-            }
-            // free old specific matrices
-            if (matrizes.old_station_err_matrix[index * oldnum + y] != NULL) {
-                free(matrizes.old_station_err_matrix[index * oldnum + y]);
-            }
+        sched_remove(&shard->sched, &station->queues[ac]);
+        list_for_each_entry_safe(frame, tmp, &station->queues[ac].frames, list) {
+            list_del(&frame->list);
+            frame_free(&shard->frame_pool, frame);
         }
     }
 
-    // Copy all values not related to deleted station
-    int xnew = 0;
-    for (size_t x = 0; x < oldnum; x++) {
-        if (x == index) {
-            continue;
-        }
-        int ynew = 0;
-        for (size_t y = 0; y < oldnum; y++) {
-            if (y == index) {
-                continue;
-            }
-            if (ctx->station_err_matrix != NULL) {
-                ctx->station_err_matrix[xnew * newnum + ynew] = matrizes.old_station_err_matrix[x * oldnum + y];
-            } else if (ctx->error_prob_matrix != NULL) {
-                ctx->error_prob_matrix[xnew * newnum + ynew] = matrizes.old_errprob_matrix[x * oldnum + y];
-            } else {
-                ctx->snr_matrix[xnew * newnum + ynew] = matrizes.old_snr_matrix[x * oldnum + y];
+    // Frames from other stations must not be delivered to it any more
+    struct station *sta;
+    list_for_each_entry(sta, &ctx->stations, list) {
+        for (int ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+            struct frame *frame;
+
+            list_for_each_entry(frame, &sta->queues[ac].frames, list) {
+                if (frame->receiver == station)
+                    frame->receiver = NULL;
             }
-            ynew++;
         }
-        xnew++;
-    }
-
-    if (ctx->station_err_matrix != NULL) {
-        free(matrizes.old_station_err_matrix);
-    } else if (ctx->error_prob_matrix != NULL) {
-        free(matrizes.old_errprob_matrix);
-    } else {
-        free(matrizes.old_snr_matrix);
     }
 
+    station_index_del(ctx, station);
     list_del(&station->list);
-    ctx->num_stas = (int) newnum;
-
+    ctx->num_stas = last;
     free(station);
+}
+
+int del_station(struct wmediumd *ctx, struct station *station) {
+    if (ctx->num_stas == 0) {
+        return -ENXIO;
+    }
+
+    links_write_begin(ctx);
+    remove_station(ctx, station);
+    medium_rebuild(ctx);
+    links_write_end(ctx);
     return 0;
 }
 
 int del_station_by_id(struct wmediumd *ctx, const i32 id) {
-    pthread_rwlock_wrlock(&snr_lock);
+    snr_wrlock(&ctx->control_lock_wait);
     int ret;
-    struct station *station;
-    list_for_each_entry(station, &ctx->stations, list) {
-        if (station->index == id) {
-            ret = del_station(ctx, station);
-            goto out;
-        }
+    if (id >= 0 && id < ctx->num_stas) {
+        ret = del_station(ctx, ctx->sta_array[id]);
+    } else {
+        ret = -ENODEV;
     }
-
-    out:
-    ret = -ENODEV;
     pthread_rwlock_unlock(&snr_lock);
     return ret;
 }
 
 int del_station_by_mac(struct wmediumd *ctx, const u8 *addr) {
-    pthread_rwlock_wrlock(&snr_lock);
+    snr_wrlock(&ctx->control_lock_wait);
     int ret;
-    struct station *station;
-    list_for_each_entry(station, &ctx->stations, list) {
-        if (memcmp(addr, station->addr, ETH_ALEN) == 0) {
-            ret = del_station(ctx, station);
-            goto out;
+    struct station *station = get_station_by_addr(ctx, addr);
+    if (station) {
+        ret = del_station(ctx, station);
+    } else {
+        ret = -ENODEV;
+    }
+    pthread_rwlock_unlock(&snr_lock);
+    return ret;
+}
+
+int del_stations_by_mac(struct wmediumd *ctx, const u8 (*addrs)[ETH_ALEN], int count, int *results) {
+    int removed = 0;
+
+    snr_wrlock(&ctx->control_lock_wait);
+    links_write_begin(ctx);
+    for (int i = 0; i < count; i++) {
+        struct station *station = get_station_by_addr(ctx, addrs[i]);
+        if (station) {
+            remove_station(ctx, station);
+            results[i] = 0;
+            removed++;
+        } else {
+            results[i] = -ENODEV;
+        }
+    }
+    // Member lists are rebuilt once for the whole batch
+    if (removed) {
+        medium_rebuild(ctx);
+    }
+    links_write_end(ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    return 0;
+}
+
+// Stations moved by a link batch whose links are not recomputed yet
+struct moved_stations {
+    int *index;
+    bool *mark;
+    int num;
+};
+
+static void recalc_moved(struct wmediumd *ctx, struct moved_stations *moved) {
+    if (!moved->num) {
+        return;
+    }
+    // Half of the stations or more: one pass over the matrix is cheaper
+    if (2 * moved->num >= ctx->num_stas) {
+        recalc_path_loss(ctx);
+        links_touch_all(ctx);
+    } else {
+        for (int i = 0; i < moved->num; i++) {
+            recalc_path_loss_station(ctx, ctx->sta_array[moved->index[i]]);
+            links_touch_station(ctx, moved->index[i]);
+        }
+    }
+    for (int i = 0; i < moved->num; i++) {
+        moved->mark[moved->index[i]] = false;
+    }
+    moved->num = 0;
+}
+
+int update_links(struct wmediumd *ctx, const link_update_record *records, int count,
+                 link_update_batch_response *response) {
+    struct moved_stations moved = { .num = 0 };
+    int ret = 0;
+
+    response->count = count;
+    response->applied = 0;
+    response->not_found = 0;
+    response->wrong_mode = 0;
+    response->invalid = 0;
+
+    snr_rdlock(&ctx->control_lock_wait);
+    links_write_begin(ctx);
+    moved.index = malloc(sizeof(*moved.index) * (ctx->num_stas ? ctx->num_stas : 1));
+    moved.mark = calloc(ctx->num_stas ? ctx->num_stas : 1, sizeof(*moved.mark));
+    if (!moved.index || !moved.mark) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const link_update_record *record = &records[i];
+        struct station *from = get_station_by_addr(ctx, record->from_addr);
+        struct station *to = NULL;
+        size_t stride = (size_t) ctx->link_stride;
+
+        if (record->kind == WLINK_SNR || record->kind == WLINK_ERRPROB) {
+            to = get_station_by_addr(ctx, record->to_addr);
+        }
+        switch (record->kind) {
+            case WLINK_SNR:
+                if (ctx->snr_matrix == NULL) {
+                    response->wrong_mode++;
+                } else if (!from || !to) {
+                    response->not_found++;
+                } else {
+                    // Keep the order of the records: an explicit SNR wins over earlier moves
+                    recalc_moved(ctx, &moved);
+                    ctx->snr_matrix[from->index * stride + to->index] = record->value.snr;
+                    ctx->snr_matrix[to->index * stride + from->index] = record->value.snr;
+                    links_touch_pair(ctx, from->index, to->index);
+                    response->applied++;
+                }
+                break;
+            case WLINK_ERRPROB:
+                if (ctx->error_prob_matrix == NULL) {
+                    response->wrong_mode++;
+                } else if (!from || !to) {
+                    response->not_found++;
+                } else {
+                    double errprob = custom_fixed_point_to_floating_point(record->value.errprob);
+                    ctx->error_prob_matrix[from->index * stride + to->index] = errprob;
+                    ctx->error_prob_matrix[to->index * stride + from->index] = errprob;
+                    links_touch_pair(ctx, from->index, to->index);
+                    response->applied++;
+                }
+                break;
+            case WLINK_POSITION:
+                if (ctx->error_prob_matrix != NULL) {
+                    response->wrong_mode++;
+                } else if (!from) {
+                    response->not_found++;
+                } else {
+                    from->x = record->value.pos[0];
+                    from->y = record->value.pos[1];
+                    from->z = record->value.pos[2];
+                    station_table_update(ctx, from);
+                    if (!moved.mark[from->index]) {
+                        moved.mark[from->index] = true;
+                        moved.index[moved.num++] = from->index;
+                    }
+                    response->applied++;
+                }
+                break;
+            default:
+                response->invalid++;
         }
     }
-    ret = -ENODEV;
+    recalc_moved(ctx, &moved);
 
     out:
+    links_write_end(ctx);
     pthread_rwlock_unlock(&snr_lock);
+    free(moved.index);
+    free(moved.mark);
     return ret;
 }
@@ -27,6 +27,7 @@
 #include <stdint.h>
 #include <pthread.h>
 #include "wmediumd.h"
+#include "wserver_messages.h"
 
 typedef uint8_t u8;
 typedef int32_t i32;
@@ -39,6 +40,17 @@ typedef int32_t i32;
  */
 int add_station(struct wmediumd *ctx, const u8 addr[]);
 
+/**
+ * Add several stations, resizing the link matrices at most once
+ * @param ctx The wmediumd context
+ * @param addrs The MAC addresses of the stations
+ * @param count The number of stations
+ * @param ids Where to store the station ID or negative errno value per address
+ * @return 0 on success, otherwise a negative errno value; stations already
+ * created keep their IDs
+ */
+int add_stations(struct wmediumd *ctx, const u8 (*addrs)[ETH_ALEN], int count, i32 *ids);
+
 /**
  * Delete a station
  * @param ctx The wmediumd context
@@ -63,9 +75,63 @@ int del_station_by_id(struct wmediumd *ctx, const i32 id);
  */
 int del_station_by_mac(struct wmediumd *ctx, const u8 *addr);
 
+/**
+ * Delete several stations by their addresses, rebuilding the mediums once
+ * @param ctx The wmediumd context
+ * @param addrs The MAC addresses of the stations
+ * @param count The number of stations
+ * @param results Where to store 0 or -ENODEV per address
+ * @return 0
+ */
+int del_stations_by_mac(struct wmediumd *ctx, const u8 (*addrs)[ETH_ALEN], int count, int *results);
+
+/**
+ * Apply a batch of link updates in order under one lock acquisition and one
+ * links write section; moved stations get their links recomputed once
+ * @param ctx The wmediumd context
+ * @param records The updates
+ * @param count The number of updates
+ * @param response Where to count the outcome of the updates
+ * @return 0 on success otherwise a negative errno value
+ */
+int update_links(struct wmediumd *ctx, const link_update_record *records, int count,
+                 link_update_batch_response *response);
+
 /**
  * Lock for the snr matrix/station list
  */
 extern pthread_rwlock_t snr_lock;
 
+/**
+ * Read lock snr_lock, recording the time waited for it
+ * @param wait The histogram to record in, 0 if the lock was free
+ */
+static inline void snr_rdlock(struct lat_hist *wait) {
+    uint64_t start;
+
+    if (!pthread_rwlock_tryrdlock(&snr_lock)) {
+        lat_record(wait, 0);
+        return;
+    }
+    start = lat_now();
+    pthread_rwlock_rdlock(&snr_lock);
+    lat_record(wait, lat_now() - start);
+}
+
+/**
+ * Write lock snr_lock, recording the time waited for it
+ * @param wait The histogram to record in, 0 if the lock was free
+ */
+static inline void snr_wrlock(struct lat_hist *wait) {
+    uint64_t start;
+
+    if (!pthread_rwlock_trywrlock(&snr_lock)) {
+        lat_record(wait, 0);
+        return;
+    }
+    start = lat_now();
+    pthread_rwlock_wrlock(&snr_lock);
+    lat_record(wait, lat_now() - start);
+}
+
 #endif //WMEDIUMD_WMEDIUMD_DYNAMIC_H
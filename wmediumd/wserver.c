@@ -32,10 +32,22 @@
 #include "wserver.h"
 #include "wmediumd_dynamic.h"
 #include "wserver_messages.h"
+#include "wserver_messages_network.h"
+#include "path_loss.h"
 
 
 #define LOG_PREFIX "W_SRV: "
 
+/* Read buffer of a client, grown for larger requests */
+#define WSERVER_RBUF_SIZE 4096
+
+/* Queued responses above which a client's requests wait, and the most kept */
+#define WSERVER_WBUF_CAP (64 * 1024)
+#define WSERVER_WBUF_MAX (1024 * 1024)
+
+/* How long a client may leave all of its responses unread, in ms */
+#define WSERVER_SEND_TIMEOUT 1000
+
 /**
  * Global listen socket
  */
@@ -66,34 +78,100 @@ void handle_sigint(int param) {
     exit(EXIT_SUCCESS);
 }
 
-/* Existing link is from from -> to; copy to other dir */
-static void mirror_link_(struct request_ctx *ctx, int from, int to, int signal)
-{
-	ctx->ctx->snr_matrix[ctx->ctx->num_stas * to + from] = signal;
-	ctx->ctx->snr_matrix[ctx->ctx->num_stas * from + to] = signal;
+/* Make room for len more bytes of responses, up to WSERVER_WBUF_MAX */
+static int reserve_wbuf(struct request_ctx *ctx, size_t len) {
+    u8 *wbuf;
+    size_t cap;
+
+    if (ctx->woff && ctx->wlen + len > ctx->wcap) {
+        ctx->wlen -= ctx->woff;
+        memmove(ctx->wbuf, ctx->wbuf + ctx->woff, ctx->wlen);
+        ctx->woff = 0;
+    }
+    if (ctx->wlen + len <= ctx->wcap) {
+        return 0;
+    }
+    if (ctx->wlen + len > WSERVER_WBUF_MAX) {
+        return -ENOBUFS;
+    }
+    cap = ctx->wcap ? ctx->wcap : WSERVER_RBUF_SIZE;
+    while (cap < ctx->wlen + len) {
+        cap *= 2;
+    }
+    wbuf = realloc(ctx->wbuf, cap);
+    if (!wbuf) {
+        return -ENOMEM;
+    }
+    ctx->wbuf = wbuf;
+    ctx->wcap = cap;
+    return 0;
+}
+
+static int queued(struct request_ctx *ctx, size_t len) {
+    ctx->wlen += len;
+    return WACTION_CONTINUE;
+}
+
+/*
+ * Queue a response for the client, to be sent by send_responses()
+ * @return WACTION_CONTINUE, or a negative errno value
+ */
+#define wserver_queue_msg(ctx, elem, type) \
+    (reserve_wbuf(ctx, sizeof(type)) ?: \
+     queued(ctx, wserver_encode_msg((ctx)->wbuf + (ctx)->wlen, elem, type)))
+
+#define wserver_queue_msg_bulk(ctx, entries, count, type) \
+    (reserve_wbuf(ctx, sizeof(station_bulk_response) + sizeof(*(entries)) * (count)) ?: \
+     queued(ctx, wserver_encode_msg_bulk((ctx)->wbuf + (ctx)->wlen, entries, count, type)))
+
+/*
+ * Send the response to an update, or in async mode only report it if the
+ * update failed; async clients learn about the rest from the acks.
+ */
+#define wserver_respond(ctx, elem, type) \
+    ((ctx)->async ? async_result(ctx, (elem)->update_result) : \
+     wserver_queue_msg(ctx, elem, type))
+
+static int async_result(struct request_ctx *ctx, u8 update_result) {
+    async_error error;
+
+    if (update_result == WUPDATE_SUCCESS) {
+        return WACTION_CONTINUE;
+    }
+    error.seq = ctx->seq;
+    error.request_type = ctx->request_type;
+    error.update_result = update_result;
+    return wserver_queue_msg(ctx, &error, async_error);
+}
+
+static int async_send_ack(struct request_ctx *ctx) {
+    async_ack ack;
+
+    ack.seq = ctx->seq;
+    ctx->acked = ctx->seq;
+    return wserver_queue_msg(ctx, &ack, async_ack);
 }
 
+/* Ack before waiting for more input, on top of every ack_interval requests */
+static int async_maybe_ack(struct request_ctx *ctx) {
+    char c;
+
+    if (ctx->seq == ctx->acked ||
+        recv(ctx->sock_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) > 0) {
+        return WACTION_CONTINUE;
+    }
+    return async_send_ack(ctx);
+}
 
-static void calc_signal(struct request_ctx *ctx)
+/* Existing link is from from -> to; copy to other dir */
+static void mirror_link_(struct request_ctx *ctx, int from, int to, int signal)
 {
-	int txpower, path_loss, gains, signal, from, to;
-
-	for (from = 0; from < ctx->ctx->num_stas; from++) {
-		for (to = 0; to < ctx->ctx->num_stas; to++) {
-			if (from == to)
-				continue;
-			txpower = ctx->ctx->sta_array[from]->tx_power;
-			if (ctx->ctx->sta_array[to]->isap == 1)
-				txpower = ctx->ctx->sta_array[to]->tx_power;
-			path_loss = ctx->ctx->calc_path_loss(ctx->ctx->path_loss_param,
-					ctx->ctx->sta_array[to], ctx->ctx->sta_array[from]);
-			gains = (txpower + ctx->ctx->sta_array[from]->gain + ctx->ctx->sta_array[to]->gain);
-			signal = gains - path_loss - ctx->ctx->noise_threshold;
-			mirror_link_(ctx, from, to, signal);
-		}
-	}
+	ctx->ctx->snr_matrix[ctx->ctx->link_stride * to + from] = signal;
+	ctx->ctx->snr_matrix[ctx->ctx->link_stride * from + to] = signal;
+	links_touch_pair(ctx->ctx, from, to);
 }
 
+
 /**
  * Create the listening socket
  * @param ctx The wmediumd context
@@ -153,21 +231,14 @@ int handle_snr_update_request(struct request_ctx *ctx, const snr_update_request
     snr_update_response response;
     response.request = *request;
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->snr_matrix != NULL) {
     	struct station *sender = NULL;
     	struct station *receiver = NULL;
-    	struct station *station;
 
-        pthread_rwlock_wrlock(&snr_lock);
-
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-            if (memcmp(&request->from_addr, station->addr, ETH_ALEN) == 0) {
-                sender = station;
-            }
-            if (memcmp(&request->to_addr, station->addr, ETH_ALEN) == 0) {
-                receiver = station;
-            }
-        }
+        sender = get_station_by_addr(ctx->ctx, request->from_addr);
+        receiver = get_station_by_addr(ctx->ctx, request->to_addr);
 
         if (!sender || !receiver) {
             w_logf(ctx->ctx, LOG_WARNING,
@@ -181,11 +252,12 @@ int handle_snr_update_request(struct request_ctx *ctx, const snr_update_request
             mirror_link_(ctx, sender->index, receiver->index, request->snr);
             response.update_result = WUPDATE_SUCCESS;
         }
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, snr_update_response);
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, snr_update_response);
     if (ret < 0) {
         w_logf(ctx->ctx, LOG_ERR, "Error on SNR update response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
@@ -197,32 +269,31 @@ int handle_position_update_request(struct request_ctx *ctx, const position_updat
     position_update_response response;
     response.request = *request;
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->error_prob_matrix == NULL) {
     	struct station *sender = NULL;
-    	struct station *station;
 
-        pthread_rwlock_wrlock(&snr_lock);
-
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-			if (memcmp(&request->sta_addr, station->addr, ETH_ALEN) == 0) {
-				sender = station;
-				sender->x = request->posX;
-				sender->y = request->posY;
-				sender->z = request->posZ;
-			}
+        sender = get_station_by_addr(ctx->ctx, request->sta_addr);
+        if (sender) {
+            sender->x = request->posX;
+            sender->y = request->posY;
+            sender->z = request->posZ;
+            station_table_update(ctx->ctx, sender);
+            recalc_path_loss_station(ctx->ctx, sender);
+            links_touch_station(ctx->ctx, sender->index);
         }
 
         w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Performing Position update: for=" MAC_FMT ", position=%f,%f,%f\n",
 			   MAC_ARGS(request->sta_addr), request->posX, request->posY, request->posZ);
 
-		calc_signal(ctx);
 		response.update_result = WUPDATE_SUCCESS;
-
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, position_update_response);
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, position_update_response);
     return ret;
 }
 
@@ -230,30 +301,29 @@ int handle_txpower_update_request(struct request_ctx *ctx, const txpower_update_
     txpower_update_response response;
     response.request = *request;
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->error_prob_matrix == NULL) {
     	struct station *sender = NULL;
-    	struct station *station;
-
-        pthread_rwlock_wrlock(&snr_lock);
 
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-			if (memcmp(&request->sta_addr, station->addr, ETH_ALEN) == 0) {
-				sender = station;
-				sender->tx_power = request->txpower_;
-			}
+        sender = get_station_by_addr(ctx->ctx, request->sta_addr);
+        if (sender) {
+            sender->tx_power = request->txpower_;
+            station_table_update(ctx->ctx, sender);
+            recalc_path_loss_station(ctx->ctx, sender);
+            links_touch_station(ctx->ctx, sender->index);
         }
 
 		w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Performing TxPower update: for=" MAC_FMT ", txpower=%d\n",
 			   MAC_ARGS(request->sta_addr), request->txpower_);
 
-		calc_signal(ctx);
 		response.update_result = WUPDATE_SUCCESS;
-
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, txpower_update_response);
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, txpower_update_response);
     return ret;
 }
 
@@ -261,30 +331,28 @@ int handle_gaussian_random_update_request(struct request_ctx *ctx, const gaussia
 	gaussian_random_update_response response;
     response.request = *request;
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->error_prob_matrix == NULL) {
     	struct station *sender = NULL;
-    	struct station *station;
-
-        pthread_rwlock_wrlock(&snr_lock);
 
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-			if (memcmp(&request->sta_addr, station->addr, ETH_ALEN) == 0) {
-				sender = station;
-				sender->gRandom = request->gaussian_random_;
-			}
+        sender = get_station_by_addr(ctx->ctx, request->sta_addr);
+        if (sender) {
+            sender->gRandom = request->gaussian_random_;
+            recalc_path_loss_station(ctx->ctx, sender);
+            links_touch_station(ctx->ctx, sender->index);
         }
 
 		w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Performing Gaussian Random update: for=" MAC_FMT ", gRandom=%d\n",
 			   MAC_ARGS(request->sta_addr), request->gaussian_random_);
 
-		calc_signal(ctx);
 		response.update_result = WUPDATE_SUCCESS;
-
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, gaussian_random_update_response);
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, gaussian_random_update_response);
     return ret;
 }
 
@@ -292,30 +360,29 @@ int handle_gain_update_request(struct request_ctx *ctx, const gain_update_reques
 	gain_update_response response;
     response.request = *request;
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->error_prob_matrix == NULL) {
     	struct station *sender = NULL;
-    	struct station *station;
-
-        pthread_rwlock_wrlock(&snr_lock);
 
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-			if (memcmp(&request->sta_addr, station->addr, ETH_ALEN) == 0) {
-				sender = station;
-				sender->gain = request->gain_;
-			}
+        sender = get_station_by_addr(ctx->ctx, request->sta_addr);
+        if (sender) {
+            sender->gain = request->gain_;
+            station_table_update(ctx->ctx, sender);
+            recalc_path_loss_station(ctx->ctx, sender);
+            links_touch_station(ctx->ctx, sender->index);
         }
 
         w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Performing Gain update: for=" MAC_FMT ", gain=%d\n",
 			   MAC_ARGS(request->sta_addr), request->gain_);
 
-        calc_signal(ctx);
 		response.update_result = WUPDATE_SUCCESS;
-
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, gain_update_response);
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, gain_update_response);
     return ret;
 }
 
@@ -324,21 +391,14 @@ int handle_errprob_update_request(struct request_ctx *ctx, const errprob_update_
     errprob_update_response response;
     response.request = *request;
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->error_prob_matrix != NULL) {
         struct station *sender = NULL;
         struct station *receiver = NULL;
-        struct station *station;
 
-        pthread_rwlock_wrlock(&snr_lock);
-
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-            if (memcmp(&request->from_addr, station->addr, ETH_ALEN) == 0) {
-                sender = station;
-            }
-            if (memcmp(&request->to_addr, station->addr, ETH_ALEN) == 0) {
-                receiver = station;
-            }
-        }
+        sender = get_station_by_addr(ctx->ctx, request->from_addr);
+        receiver = get_station_by_addr(ctx->ctx, request->to_addr);
 
         double errprob = custom_fixed_point_to_floating_point(request->errprob);
 
@@ -351,15 +411,17 @@ int handle_errprob_update_request(struct request_ctx *ctx, const errprob_update_
             w_logf(ctx->ctx, LOG_NOTICE,
                    LOG_PREFIX "Performing ERRPROB update: from=" MAC_FMT ", to=" MAC_FMT ", errprob=%f\n",
                    MAC_ARGS(sender->addr), MAC_ARGS(receiver->addr), errprob);
-            ctx->ctx->error_prob_matrix[sender->index * ctx->ctx->num_stas + receiver->index] = errprob;
-            ctx->ctx->error_prob_matrix[receiver->index * ctx->ctx->num_stas + sender->index] = errprob;
+            ctx->ctx->error_prob_matrix[sender->index * ctx->ctx->link_stride + receiver->index] = errprob;
+            ctx->ctx->error_prob_matrix[receiver->index * ctx->ctx->link_stride + sender->index] = errprob;
+            links_touch_pair(ctx->ctx, sender->index, receiver->index);
             response.update_result = WUPDATE_SUCCESS;
         }
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, errprob_update_response);
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, errprob_update_response);
     if (ret < 0) {
         w_logf(ctx->ctx, LOG_ERR, "Error on ERRPROB update response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
@@ -372,21 +434,14 @@ int handle_specprob_update_request(struct request_ctx *ctx, const specprob_updat
     memcpy(response.from_addr, request->from_addr, ETH_ALEN);
     memcpy(response.to_addr, request->to_addr, ETH_ALEN);
 
+    snr_rdlock(&ctx->ctx->control_lock_wait);
+    links_write_begin(ctx->ctx);
     if (ctx->ctx->station_err_matrix != NULL) {
         struct station *sender = NULL;
         struct station *receiver = NULL;
-        struct station *station;
-
-        pthread_rwlock_wrlock(&snr_lock);
 
-        list_for_each_entry(station, &ctx->ctx->stations, list) {
-            if (memcmp(&request->from_addr, station->addr, ETH_ALEN) == 0) {
-                sender = station;
-            }
-            if (memcmp(&request->to_addr, station->addr, ETH_ALEN) == 0) {
-                receiver = station;
-            }
-        }
+        sender = get_station_by_addr(ctx->ctx, request->from_addr);
+        receiver = get_station_by_addr(ctx->ctx, request->to_addr);
 
         if (!sender || !receiver) {
             w_logf(ctx->ctx, LOG_WARNING,
@@ -407,18 +462,21 @@ int handle_specprob_update_request(struct request_ctx *ctx, const specprob_updat
             for (int i = 0; i < SPECIFIC_MATRIX_MAX_SIZE_IDX * SPECIFIC_MATRIX_MAX_RATE_IDX; i++) {
                 specific_mat[i] = custom_fixed_point_to_floating_point(request->errprob[i]);
             }
-            if (ctx->ctx->station_err_matrix[sender->index * ctx->ctx->num_stas + receiver->index] != NULL) {
-                free(ctx->ctx->station_err_matrix[sender->index * ctx->ctx->num_stas + receiver->index]);
+            // Readers may still use the old one, free it once they moved on
+            if (ctx->ctx->station_err_matrix[sender->index * ctx->ctx->link_stride + receiver->index] != NULL) {
+                links_retire(ctx->ctx, ctx->ctx->station_err_matrix[sender->index * ctx->ctx->link_stride + receiver->index]);
             }
-            ctx->ctx->station_err_matrix[sender->index * ctx->ctx->num_stas + receiver->index] = specific_mat;
+            ctx->ctx->station_err_matrix[sender->index * ctx->ctx->link_stride + receiver->index] = specific_mat;
+            links_touch_pair(ctx->ctx, sender->index, receiver->index);
             response.update_result = WUPDATE_SUCCESS;
         }
-out:
-        pthread_rwlock_unlock(&snr_lock);
     } else {
         response.update_result = WUPDATE_WRONG_MODE;
     }
-    int ret = wserver_send_msg(ctx->sock_fd, &response, specprob_update_response);
+out:
+    links_write_end(ctx->ctx);
+    pthread_rwlock_unlock(&snr_lock);
+    int ret = wserver_respond(ctx, &response, specprob_update_response);
     if (ret < 0) {
         w_logf(ctx->ctx, LOG_ERR, "Error on SPECPROB update response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
@@ -444,7 +502,7 @@ int handle_delete_by_id_request(struct request_ctx *ctx, station_del_by_id_reque
                 "Station with ID %d successfully deleted\n", request->id);
         response.update_result = WUPDATE_SUCCESS;
     }
-    ret = wserver_send_msg(ctx->sock_fd, &response, station_del_by_id_response);
+    ret = wserver_respond(ctx, &response, station_del_by_id_response);
     if (ret < 0) {
         w_logf(ctx->ctx, LOG_ERR, "Error on delete by id response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
@@ -470,7 +528,7 @@ int handle_delete_by_mac_request(struct request_ctx *ctx, station_del_by_mac_req
                 "Station with MAC " MAC_FMT " successfully deleted\n", MAC_ARGS(request->addr));
         response.update_result = WUPDATE_SUCCESS;
     }
-    ret = wserver_send_msg(ctx->sock_fd, &response, station_del_by_mac_response);
+    ret = wserver_respond(ctx, &response, station_del_by_mac_response);
     if (ret < 0) {
         w_logf(ctx->ctx, LOG_ERR, "Error on delete by mac response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
@@ -498,7 +556,7 @@ int handle_add_request(struct request_ctx *ctx, station_add_request *request) {
         response.created_id = ret;
         response.update_result = WUPDATE_SUCCESS;
     }
-    ret = wserver_send_msg(ctx->sock_fd, &response, station_add_response);
+    ret = wserver_queue_msg(ctx, &response, station_add_response);
     if (ret < 0) {
         w_logf(ctx->ctx, LOG_ERR, "Error on add response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
@@ -506,192 +564,533 @@ int handle_add_request(struct request_ctx *ctx, station_add_request *request) {
     return ret;
 }
 
+int handle_bulk_add_request(struct request_ctx *ctx, const station_bulk_request *request, const u8 (*addrs)[ETH_ALEN]) {
+    i32 *ids = malloc(sizeof(*ids) * (request->count ? request->count : 1));
+    station_bulk_add_entry *entries = malloc(sizeof(*entries) * (request->count ? request->count : 1));
+    int ret;
+    if (!ids || !entries) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on bulk add request: %s\n", strerror(ENOMEM));
+        ret = WACTION_ERROR;
+        goto out;
+    }
+    ret = add_stations(ctx->ctx, addrs, request->count, ids);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on bulk add request: %s\n", strerror(abs(ret)));
+        ret = WACTION_ERROR;
+        goto out;
+    }
+    u32 added = 0;
+    for (u32 i = 0; i < request->count; i++) {
+        memcpy(entries[i].addr, addrs[i], ETH_ALEN);
+        if (ids[i] < 0) {
+            w_logf(ctx->ctx, LOG_WARNING, LOG_PREFIX
+                    "Station with MAC " MAC_FMT " already exists\n", MAC_ARGS(addrs[i]));
+            entries[i].created_id = 0;
+            entries[i].update_result = WUPDATE_INTF_DUPLICATE;
+        } else {
+            entries[i].created_id = ids[i];
+            entries[i].update_result = WUPDATE_SUCCESS;
+            added++;
+        }
+    }
+    w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Added %u of %u stations\n", added, request->count);
+    ret = wserver_queue_msg_bulk(ctx, entries, request->count, station_bulk_add_response);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on bulk add response: %s\n", strerror(abs(ret)));
+        ret = WACTION_ERROR;
+    }
+
+    out:
+    free(ids);
+    free(entries);
+    return ret;
+}
+
+int handle_bulk_del_request(struct request_ctx *ctx, const station_bulk_request *request, const u8 (*addrs)[ETH_ALEN]) {
+    int *results = malloc(sizeof(*results) * (request->count ? request->count : 1));
+    station_bulk_del_entry *entries = malloc(sizeof(*entries) * (request->count ? request->count : 1));
+    int ret;
+    if (!results || !entries) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on bulk delete request: %s\n", strerror(ENOMEM));
+        ret = WACTION_ERROR;
+        goto out;
+    }
+    del_stations_by_mac(ctx->ctx, addrs, request->count, results);
+    u32 deleted = 0;
+    for (u32 i = 0; i < request->count; i++) {
+        memcpy(entries[i].addr, addrs[i], ETH_ALEN);
+        if (results[i]) {
+            w_logf(ctx->ctx, LOG_WARNING, LOG_PREFIX
+                    "Station with MAC " MAC_FMT " could not be found\n", MAC_ARGS(addrs[i]));
+            entries[i].update_result = WUPDATE_INTF_NOTFOUND;
+        } else {
+            entries[i].update_result = WUPDATE_SUCCESS;
+            deleted++;
+        }
+    }
+    w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Deleted %u of %u stations\n", deleted, request->count);
+    ret = wserver_queue_msg_bulk(ctx, entries, request->count, station_bulk_del_response);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on bulk delete response: %s\n", strerror(abs(ret)));
+        ret = WACTION_ERROR;
+    }
+
+    out:
+    free(results);
+    free(entries);
+    return ret;
+}
+
+int handle_link_batch_request(struct request_ctx *ctx, const link_update_batch_request *request,
+                              const link_update_record *records) {
+    link_update_batch_response response;
+    int ret = update_links(ctx->ctx, records, request->count, &response);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on link batch request: %s\n", strerror(abs(ret)));
+        return WACTION_ERROR;
+    }
+    w_logf(ctx->ctx, response.not_found || response.wrong_mode || response.invalid ? LOG_WARNING : LOG_NOTICE,
+           LOG_PREFIX "Performed link batch: %u updates, %u applied, %u not found, %u wrong mode, %u invalid\n",
+           response.count, response.applied, response.not_found, response.wrong_mode, response.invalid);
+    if (ctx->async) {
+        // the first kind of failure stands for the batch
+        ret = async_result(ctx, response.not_found ? WUPDATE_INTF_NOTFOUND :
+                                response.wrong_mode ? WUPDATE_WRONG_MODE :
+                                response.invalid ? WUPDATE_INVALID : WUPDATE_SUCCESS);
+    } else {
+        ret = wserver_queue_msg(ctx, &response, link_update_batch_response);
+    }
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on link batch response: %s\n", strerror(abs(ret)));
+        return WACTION_ERROR;
+    }
+    return ret;
+}
+
 int handle_medium_update_request(struct request_ctx *ctx, const medium_update_request *request) {
     medium_update_response response;
     response.request = *request;
-    struct station *sender = NULL;
-    struct station *station;
+    struct station *sender;
 
-    list_for_each_entry(station, &ctx->ctx->stations, list) {
-        if (memcmp(&request->sta_addr, station->addr, ETH_ALEN) == 0) {
-            sender = station;
-        }
-    }
     w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Performing Medium update: for=" MAC_FMT " to #%d\n",
            MAC_ARGS(request->sta_addr), request->medium_id_);
+    snr_wrlock(&ctx->ctx->control_lock_wait);
+    sender = get_station_by_addr(ctx->ctx, request->sta_addr);
     if(sender!=NULL){
         response.update_result = WUPDATE_SUCCESS;
-        pthread_rwlock_wrlock(&snr_lock);
-        sender->medium_id = request->medium_id_;
-        pthread_rwlock_unlock(&snr_lock);
+        station_set_medium(ctx->ctx, sender, request->medium_id_);
     }else{
         response.update_result = WUPDATE_INTF_NOTFOUND;
     }
+    pthread_rwlock_unlock(&snr_lock);
 
-    int ret = wserver_send_msg(ctx->sock_fd, &response, medium_update_response);
+    int ret = wserver_respond(ctx, &response, medium_update_response);
     return ret;
 }
 
-int parse_recv_msg_rest_error(struct wmediumd *ctx, int value) {
-    if (value > 0) {
-        return value;
-    } else {
-        w_logf(ctx, LOG_ERR, "Error on receive msg rest: %s\n", strerror(abs(value)));
+int handle_async_mode_request(struct request_ctx *ctx, const async_mode_request *request) {
+    async_mode_response response;
+    response.request = *request;
+    int ret;
+
+    // Whatever came before the switch is acked under the old numbering
+    if (ctx->async && (ret = async_send_ack(ctx))) {
+        return ret < 0 ? WACTION_ERROR : ret;
+    }
+    ctx->async = request->enable;
+    if (ctx->async) {
+        ctx->seq = request->first_seq - 1;
+        ctx->acked = ctx->seq;
+        ctx->ack_interval = request->ack_interval ? request->ack_interval : WSERVER_ASYNC_ACK_INTERVAL;
+    }
+    w_logf(ctx->ctx, LOG_NOTICE, LOG_PREFIX "Async mode %s, first sequence number %u, ack interval %u\n",
+           ctx->async ? "on" : "off", request->first_seq, ctx->ack_interval);
+    response.update_result = WUPDATE_SUCCESS;
+    ret = wserver_queue_msg(ctx, &response, async_mode_response);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on async mode response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
     }
+    return ret;
 }
 
-int receive_handle_request(struct request_ctx *ctx) {
-    wserver_msg base;
-    int recv_type;
-    int ret = wserver_recv_msg_base(ctx->sock_fd, &base, &recv_type);
-    if (ret > 0) {
-        return ret;
-    } else if (ret < 0) {
-        w_logf(ctx->ctx, LOG_ERR, "Error on receive base request: %s\n", strerror(abs(ret)));
+_Static_assert(WLAT_INGEST == LAT_INGEST && WLAT_LATENESS == LAT_LATENESS &&
+               WLAT_DELIVERY == LAT_DELIVERY && WLAT_SNR_LOCK == LAT_SNR_LOCK &&
+               WLAT_SNR_LOCK_CONTROL == LAT_SNR_LOCK_CONTROL && WLAT_STAGES == LAT_STAGES,
+               "latency stages");
+
+int handle_latency_request(struct request_ctx *ctx, const latency_request *request) {
+    latency_response response;
+    struct lat_hist *stages;
+    int ret;
+
+    stages = malloc(LAT_STAGES * sizeof(*stages));
+    if (!stages) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on latency request: %s\n", strerror(ENOMEM));
+        return WACTION_ERROR;
+    }
+    latency_collect(ctx->ctx, stages);
+    if (request->reset) {
+        latency_reset(ctx->ctx);
+    }
+    response.request = *request;
+    for (int i = 0; i < LAT_STAGES; i++) {
+        const struct lat_hist *h = &stages[i];
+
+        response.stages[i].count = h->count;
+        response.stages[i].mean_ns = h->count ? h->sum_ns / h->count : 0;
+        response.stages[i].p50_ns = lat_hist_percentile(h, 0.5);
+        response.stages[i].p90_ns = lat_hist_percentile(h, 0.9);
+        response.stages[i].p99_ns = lat_hist_percentile(h, 0.99);
+        response.stages[i].p999_ns = lat_hist_percentile(h, 0.999);
+        response.stages[i].max_ns = h->max_ns;
+    }
+    free(stages);
+
+    // carries data, so it is answered in async mode too
+    ret = wserver_queue_msg(ctx, &response, latency_response);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on latency response: %s\n", strerror(abs(ret)));
         return WACTION_ERROR;
     }
+    return ret;
+}
+
+int handle_request(struct request_ctx *ctx, const u8 *buf, size_t len) {
+    int recv_type = buf[0];
+
+    if (ctx->ctx->record_request) {
+        ctx->ctx->record_request(ctx->ctx, buf, len);
+    }
     if (recv_type == WSERVER_SHUTDOWN_REQUEST_TYPE) {
         return WACTION_CLOSE;
     } else if (recv_type == WSERVER_SNR_UPDATE_REQUEST_TYPE) {
         snr_update_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, snr_update_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_snr_update_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, snr_update_request);
+        return handle_snr_update_request(ctx, &request);
     } else if (recv_type == WSERVER_ERRPROB_UPDATE_REQUEST_TYPE) {
         errprob_update_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, errprob_update_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_errprob_update_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, errprob_update_request);
+        return handle_errprob_update_request(ctx, &request);
     } else if (recv_type == WSERVER_SPECPROB_UPDATE_REQUEST_TYPE) {
         specprob_update_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, specprob_update_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_specprob_update_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, specprob_update_request);
+        return handle_specprob_update_request(ctx, &request);
     } else if (recv_type == WSERVER_DEL_BY_MAC_REQUEST_TYPE) {
         station_del_by_mac_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, station_del_by_mac_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_delete_by_mac_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, station_del_by_mac_request);
+        return handle_delete_by_mac_request(ctx, &request);
     } else if (recv_type == WSERVER_DEL_BY_ID_REQUEST_TYPE) {
         station_del_by_id_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, station_del_by_id_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_delete_by_id_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, station_del_by_id_request);
+        return handle_delete_by_id_request(ctx, &request);
     } else if (recv_type == WSERVER_ADD_REQUEST_TYPE) {
         station_add_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, station_add_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_add_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, station_add_request);
+        return handle_add_request(ctx, &request);
     } else if (recv_type == WSERVER_POSITION_UPDATE_REQUEST_TYPE) {
         position_update_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, position_update_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
-        } else {
-            return handle_position_update_request(ctx, &request);
-        }
+        wserver_decode_msg(buf, &request, position_update_request);
+        return handle_position_update_request(ctx, &request);
     } else if (recv_type == WSERVER_TXPOWER_UPDATE_REQUEST_TYPE) {
 		txpower_update_request request;
-		if ((ret = wserver_recv_msg(ctx->sock_fd, &request, txpower_update_request))) {
-			return parse_recv_msg_rest_error(ctx->ctx, ret);
-		} else {
-			return handle_txpower_update_request(ctx, &request);
-		}
+		wserver_decode_msg(buf, &request, txpower_update_request);
+		return handle_txpower_update_request(ctx, &request);
     } else if (recv_type == WSERVER_GAIN_UPDATE_REQUEST_TYPE) {
 		gain_update_request request;
-		if ((ret = wserver_recv_msg(ctx->sock_fd, &request, gain_update_request))) {
-			return parse_recv_msg_rest_error(ctx->ctx, ret);
-		} else {
-			return handle_gain_update_request(ctx, &request);
-		}
+		wserver_decode_msg(buf, &request, gain_update_request);
+		return handle_gain_update_request(ctx, &request);
     } else if (recv_type == WSERVER_GAUSSIAN_RANDOM_UPDATE_REQUEST_TYPE) {
 		gaussian_random_update_request request;
-		if ((ret = wserver_recv_msg(ctx->sock_fd, &request, gaussian_random_update_request))) {
-			return parse_recv_msg_rest_error(ctx->ctx, ret);
-		} else {
-			return handle_gaussian_random_update_request(ctx, &request);
-		}
+		wserver_decode_msg(buf, &request, gaussian_random_update_request);
+		return handle_gaussian_random_update_request(ctx, &request);
     } else if (recv_type == WSERVER_MEDIUM_UPDATE_REQUEST_TYPE) {
         medium_update_request request;
-        if ((ret = wserver_recv_msg(ctx->sock_fd, &request, medium_update_request))) {
-            return parse_recv_msg_rest_error(ctx->ctx, ret);
+        wserver_decode_msg(buf, &request, medium_update_request);
+        return handle_medium_update_request(ctx, &request);
+    } else if (recv_type == WSERVER_BULK_ADD_REQUEST_TYPE || recv_type == WSERVER_BULK_DEL_REQUEST_TYPE) {
+        station_bulk_request request;
+        wserver_decode_msg(buf, &request, station_bulk_request);
+        // addresses need no conversion, hand them out of the read buffer
+        const u8 (*addrs)[ETH_ALEN] = (const u8 (*)[ETH_ALEN]) (buf + sizeof(request));
+        if (recv_type == WSERVER_BULK_ADD_REQUEST_TYPE) {
+            return handle_bulk_add_request(ctx, &request, addrs);
         } else {
-            return handle_medium_update_request(ctx, &request);
+            return handle_bulk_del_request(ctx, &request, addrs);
+        }
+    } else if (recv_type == WSERVER_LINK_BATCH_REQUEST_TYPE) {
+        link_update_batch_request request;
+        wserver_decode_msg(buf, &request, link_update_batch_request);
+        link_update_record *records = malloc(sizeof(*records) * (request.count ? request.count : 1));
+        if (!records) {
+            w_logf(ctx->ctx, LOG_ERR, "Error on link batch request: %s\n", strerror(ENOMEM));
+            return WACTION_ERROR;
         }
+        memcpy(records, buf + sizeof(request), sizeof(*records) * request.count);
+        for (u32 i = 0; i < request.count; i++) {
+            ntoh_link_update_record(&records[i]);
+        }
+        int ret = handle_link_batch_request(ctx, &request, records);
+        free(records);
+        return ret;
+    } else if (recv_type == WSERVER_ASYNC_MODE_REQUEST_TYPE) {
+        async_mode_request request;
+        wserver_decode_msg(buf, &request, async_mode_request);
+        return handle_async_mode_request(ctx, &request);
+    } else if (recv_type == WSERVER_LATENCY_REQUEST_TYPE) {
+        latency_request request;
+        wserver_decode_msg(buf, &request, latency_request);
+        return handle_latency_request(ctx, &request);
     }
     else {
-        return -1;
+        w_logf(ctx->ctx, LOG_ERR, "Error on request: unknown type %d\n", recv_type);
+        return WACTION_ERROR;
     }
 }
 
-struct accept_context {
-    struct wmediumd *wctx;
-    int server_socket;
-    int client_socket;
-    pthread_t *thread;
-};
-
-void *handle_accepted_connection(void *d_ptr) {
-    struct accept_context *actx = d_ptr;
-    struct request_ctx rctx;
-    rctx.ctx = actx->wctx;
-    rctx.sock_fd = actx->client_socket;
-    w_logf(rctx.ctx, LOG_INFO, LOG_PREFIX "Client connected\n");
-    while (1) {
-        int action_resp;
-        w_logf(rctx.ctx, LOG_INFO, LOG_PREFIX "Waiting for request...\n");
-        action_resp = receive_handle_request(&rctx);
-        if (action_resp == WACTION_DISCONNECTED) {
-            w_logf(rctx.ctx, LOG_INFO, LOG_PREFIX "Client has disconnected\n");
-            break;
-        } else if (action_resp == WACTION_ERROR) {
-            w_logf(rctx.ctx, LOG_INFO, LOG_PREFIX "Disconnecting client because of error\n");
-            break;
-        } else if (action_resp == WACTION_CLOSE) {
-            w_logf(rctx.ctx, LOG_INFO, LOG_PREFIX "Closing server\n");
-            event_base_loopbreak(server_event_base);
+/* Make room for a message of len bytes in the read buffer */
+static int reserve_rbuf(struct request_ctx *ctx, size_t len) {
+    u8 *rbuf;
+
+    if (len <= ctx->rcap) {
+        return 0;
+    }
+    if (len < WSERVER_RBUF_SIZE) {
+        len = WSERVER_RBUF_SIZE;
+    }
+    rbuf = realloc(ctx->rbuf, len);
+    if (!rbuf) {
+        return -ENOMEM;
+    }
+    ctx->rbuf = rbuf;
+    ctx->rcap = len;
+    return 0;
+}
+
+/* Handle every complete request in the read buffer */
+static int handle_buffered_requests(struct request_ctx *ctx) {
+    size_t off = 0;
+    int ret = WACTION_CONTINUE;
+
+    // the rest waits until the client has read most of the responses
+    while (ret == WACTION_CONTINUE && ctx->wlen - ctx->woff < WSERVER_WBUF_CAP) {
+        ssize_t len = wserver_msg_len(ctx->rbuf + off, ctx->rlen - off);
+        if (len < 0) {
+            w_logf(ctx->ctx, LOG_ERR, "Error on request: unknown type or too large\n");
+            return WACTION_ERROR;
+        } else if (len == 0 || (size_t) len > ctx->rlen - off) {
+            if (reserve_rbuf(ctx, len)) {
+                w_logf(ctx->ctx, LOG_ERR, "Error on request: %s\n", strerror(ENOMEM));
+                return WACTION_ERROR;
+            }
             break;
         }
+
+        int recv_type = ctx->rbuf[off];
+        if (ctx->async) {
+            ctx->seq++;
+            ctx->request_type = recv_type;
+        }
+        ret = handle_request(ctx, ctx->rbuf + off, len);
+        off += len;
+        if (ret == WACTION_CONTINUE && ctx->async && ctx->seq - ctx->acked >= ctx->ack_interval) {
+            ret = async_send_ack(ctx);
+        }
     }
-    close(rctx.sock_fd);
-    free(actx);
-    return NULL;
+    ctx->rlen -= off;
+    memmove(ctx->rbuf, ctx->rbuf + off, ctx->rlen);
+    if (ret < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on response: %s\n", strerror(abs(ret)));
+        return WACTION_ERROR;
+    }
+    return ret;
 }
 
-void on_listen_event(int fd, short what, void *wctx) {
+/*
+ * Watch the socket for room while responses are queued, and stop reading
+ * requests while too many of them are; sent tells whether any went out.
+ * Connections driven by hand, without events, are left alone.
+ */
+static void watch_client(struct request_ctx *ctx, bool sent) {
+    struct timeval timeout = {
+        .tv_sec = WSERVER_SEND_TIMEOUT / 1000,
+        .tv_usec = WSERVER_SEND_TIMEOUT % 1000 * 1000,
+    };
+
+    if (!ctx->ev) {
+        return;
+    }
+    if (ctx->woff == ctx->wlen) {
+        event_del(ctx->wev);
+    } else if (sent || !event_pending(ctx->wev, EV_WRITE, NULL)) {
+        // (re)starts the timeout
+        event_add(ctx->wev, &timeout);
+    }
+    if (ctx->wlen - ctx->woff >= WSERVER_WBUF_CAP) {
+        event_del(ctx->ev);
+    } else {
+        event_add(ctx->ev, NULL);
+    }
+}
+
+int send_responses(struct request_ctx *ctx) {
+    bool sent = false;
+
+    while (ctx->woff < ctx->wlen) {
+        ssize_t n = send(ctx->sock_fd, ctx->wbuf + ctx->woff, ctx->wlen - ctx->woff,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno == EPIPE || errno == ECONNRESET) {
+                return WACTION_DISCONNECTED;
+            }
+            w_logf(ctx->ctx, LOG_ERR, "Error on response: %s\n", strerror(errno));
+            return WACTION_ERROR;
+        }
+        ctx->woff += n;
+        sent = true;
+    }
+    if (ctx->woff == ctx->wlen) {
+        ctx->woff = 0;
+        ctx->wlen = 0;
+        // a large response is done with, don't keep its buffer around
+        if (ctx->wcap > WSERVER_RBUF_SIZE) {
+            free(ctx->wbuf);
+            ctx->wbuf = NULL;
+            ctx->wcap = 0;
+        }
+    }
+    watch_client(ctx, sent);
+    return WACTION_CONTINUE;
+}
+
+/* Handle what was received as far as the responses leave room, then send these */
+static int serve_requests(struct request_ctx *ctx) {
+    int ret = WACTION_CONTINUE;
+
+    if (ctx->rlen) {
+        ret = handle_buffered_requests(ctx);
+    }
+    if (ret == WACTION_CONTINUE && ctx->async && (ret = async_maybe_ack(ctx)) < 0) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on async ack: %s\n", strerror(abs(ret)));
+        return WACTION_ERROR;
+    }
+    // a large request is done with, don't keep its buffer around
+    if (!ctx->rlen && ctx->rcap > WSERVER_RBUF_SIZE) {
+        free(ctx->rbuf);
+        ctx->rbuf = NULL;
+        ctx->rcap = 0;
+    }
+    if (ret == WACTION_CONTINUE) {
+        ret = send_responses(ctx);
+    }
+    return ret;
+}
+
+int receive_handle_requests(struct request_ctx *ctx) {
+    ssize_t received;
+
+    if (reserve_rbuf(ctx, ctx->rlen + 1)) {
+        w_logf(ctx->ctx, LOG_ERR, "Error on receive request: %s\n", strerror(ENOMEM));
+        return WACTION_ERROR;
+    }
+    received = recv(ctx->sock_fd, ctx->rbuf + ctx->rlen, ctx->rcap - ctx->rlen, 0);
+    if (received == 0) {
+        return WACTION_DISCONNECTED;
+    } else if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return WACTION_CONTINUE;
+        } else if (errno == ECONNRESET) {
+            return WACTION_DISCONNECTED;
+        }
+        w_logf(ctx->ctx, LOG_ERR, "Error on receive request: %s\n", strerror(errno));
+        return WACTION_ERROR;
+    }
+    ctx->rlen += received;
+    return serve_requests(ctx);
+}
+
+/**
+ * Connected clients, so they can be closed with the server
+ */
+static LIST_HEAD(connections);
+
+static void close_connection(struct request_ctx *rctx) {
+    list_del(&rctx->list);
+    event_free(rctx->ev);
+    event_free(rctx->wev);
+    close(rctx->sock_fd);
+    free(rctx->rbuf);
+    free(rctx->wbuf);
+    free(rctx);
+}
+
+static void client_event_done(struct request_ctx *rctx, int action_resp) {
+    if (action_resp == WACTION_CONTINUE) {
+        return;
+    } else if (action_resp == WACTION_DISCONNECTED) {
+        w_logf(rctx->ctx, LOG_INFO, LOG_PREFIX "Client has disconnected\n");
+    } else if (action_resp == WACTION_ERROR) {
+        w_logf(rctx->ctx, LOG_INFO, LOG_PREFIX "Disconnecting client because of error\n");
+    } else if (action_resp == WACTION_CLOSE) {
+        w_logf(rctx->ctx, LOG_INFO, LOG_PREFIX "Closing server\n");
+        event_base_loopbreak(server_event_base);
+    }
+    close_connection(rctx);
+}
+
+void on_client_event(int fd, short what, void *arg) {
     UNUSED(fd);
     UNUSED(what);
-    struct accept_context *actx = malloc(sizeof(struct accept_context));
-    if (!actx) {
-        w_logf(wctx, LOG_ERR, "Error during allocation of memory in on_listen_event wmediumd/wserver.c\n");
+    struct request_ctx *rctx = arg;
+    client_event_done(rctx, receive_handle_requests(rctx));
+}
+
+void on_client_write(int fd, short what, void *arg) {
+    UNUSED(fd);
+    struct request_ctx *rctx = arg;
+    if (what & EV_TIMEOUT) {
+        w_logf(rctx->ctx, LOG_INFO, LOG_PREFIX "Disconnecting client that does not read its responses\n");
+        close_connection(rctx);
         return;
     }
-    actx->wctx = wctx;
-    actx->server_socket = fd;
-    actx->thread = malloc(sizeof(pthread_t));
-    if (!actx->thread) {
-        w_logf(wctx, LOG_ERR, "Error during allocation of memory in on_listen_event wmediumd/wserver.c\n");
-        free(actx);
+    // requests held back for their responses are handled as room is made
+    client_event_done(rctx, serve_requests(rctx));
+}
+
+void on_listen_event(int fd, short what, void *wctx) {
+    UNUSED(what);
+    struct request_ctx *rctx;
+    int client_socket = accept_connection(fd);
+    if (client_socket < 0) {
+        w_logf(wctx, LOG_ERR, LOG_PREFIX "Accept failed: %s\n", strerror(errno));
         return;
     }
-    actx->client_socket = accept_connection(actx->server_socket);
-    if (actx->client_socket < 0) {
-        w_logf(actx->wctx, LOG_ERR, LOG_PREFIX "Accept failed: %s\n", strerror(errno));
-    } else {
-        pthread_create(actx->thread, NULL, handle_accepted_connection, actx);
+    evutil_make_socket_nonblocking(client_socket);
+    rctx = calloc(1, sizeof(*rctx));
+    if (rctx) {
+        rctx->ctx = wctx;
+        rctx->sock_fd = client_socket;
+        rctx->ev = event_new(server_event_base, client_socket, EV_READ | EV_PERSIST, on_client_event, rctx);
+        rctx->wev = event_new(server_event_base, client_socket, EV_WRITE | EV_PERSIST, on_client_write, rctx);
     }
+    if (!rctx || !rctx->ev || !rctx->wev || event_add(rctx->ev, NULL)) {
+        w_logf(wctx, LOG_ERR, "Error during allocation of memory in on_listen_event wmediumd/wserver.c\n");
+        if (rctx && rctx->ev) {
+            event_free(rctx->ev);
+        }
+        if (rctx && rctx->wev) {
+            event_free(rctx->wev);
+        }
+        free(rctx);
+        close(client_socket);
+        return;
+    }
+    list_add(&rctx->list, &connections);
+    w_logf(rctx->ctx, LOG_INFO, LOG_PREFIX "Client connected\n");
 }
 
 /**
@@ -718,6 +1117,10 @@ void *run_wserver(void *ctx) {
     w_logf(ctx, LOG_DEBUG, LOG_PREFIX "Waiting for client to connect...\n");
     event_base_dispatch(server_event_base);
 
+    struct request_ctx *rctx, *tmp;
+    list_for_each_entry_safe(rctx, tmp, &connections, list) {
+        close_connection(rctx);
+    }
     event_free(accept_event);
     event_base_free(server_event_base);
     stop_wserver();
@@ -27,6 +27,21 @@
 struct request_ctx {
     struct wmediumd *ctx;
     int sock_fd;
+    bool async; /* see async_mode_request */
+    u32 seq; /* sequence number of the current request */
+    u32 acked; /* sequence number of the last ack */
+    u32 ack_interval;
+    u8 request_type; /* type of the current request */
+    struct event *ev; /* read event of sock_fd */
+    struct event *wev; /* write event of sock_fd, while wbuf is not sent */
+    u8 *rbuf; /* received bytes not handled yet */
+    size_t rlen;
+    size_t rcap;
+    u8 *wbuf; /* responses, sent from woff to wlen */
+    size_t woff;
+    size_t wlen;
+    size_t wcap;
+    struct list_head list; /* in the server's connections */
 };
 
 /**
@@ -111,4 +126,68 @@ int handle_delete_by_mac_request(struct request_ctx *ctx, station_del_by_mac_req
  */
 int handle_add_request(struct request_ctx *ctx, station_add_request *request);
 
+/**
+ * Handle a bulk add request and pass it to wmediumd
+ * @param ctx The request_ctx context
+ * @param request The received request header
+ * @param addrs The request->count addresses following the header
+ */
+int handle_bulk_add_request(struct request_ctx *ctx, const station_bulk_request *request, const u8 (*addrs)[ETH_ALEN]);
+
+/**
+ * Handle a bulk delete request and pass it to wmediumd
+ * @param ctx The request_ctx context
+ * @param request The received request header
+ * @param addrs The request->count addresses following the header
+ */
+int handle_bulk_del_request(struct request_ctx *ctx, const station_bulk_request *request, const u8 (*addrs)[ETH_ALEN]);
+
+/**
+ * Handle a link batch request and pass it to wmediumd
+ * @param ctx The request_ctx context
+ * @param request The received request header
+ * @param records The request->count records following the header
+ */
+int handle_link_batch_request(struct request_ctx *ctx, const link_update_batch_request *request,
+                              const link_update_record *records);
+
+/**
+ * Handle an async_mode_request, switching the connection's mode
+ * @param ctx The request_ctx context
+ * @param request The received request
+ */
+int handle_async_mode_request(struct request_ctx *ctx, const async_mode_request *request);
+
+/**
+ * Handle a latency_request, answering with the pipeline's histograms
+ * @param ctx The request_ctx context
+ * @param request The received request
+ */
+int handle_latency_request(struct request_ctx *ctx, const latency_request *request);
+
+/**
+ * Handle a complete request, as received, recording it in the trace first
+ * @param ctx The request_ctx context
+ * @param buf The request, in network byte order, starting with its type
+ * @param len The length of the request
+ * @return A WACTION_* constant
+ */
+int handle_request(struct request_ctx *ctx, const u8 *buf, size_t len);
+
+/**
+ * Send what the non-blocking socket of ctx takes of the queued responses,
+ * keeping the rest for when it can take more
+ * @param ctx The request_ctx context
+ * @return A WACTION_* constant
+ */
+int send_responses(struct request_ctx *ctx);
+
+/**
+ * Receive what the non-blocking socket of ctx has, handle the complete
+ * requests and send their responses, keeping the rest for the next call
+ * @param ctx The request_ctx context
+ * @return A WACTION_* constant
+ */
+int receive_handle_requests(struct request_ctx *ctx);
+
 #endif //WMEDIUMD_SERVER_H
@@ -20,6 +20,8 @@
 
 #include <sys/socket.h>
 #include <memory.h>
+#include <stdlib.h>
+#include <errno.h>
 #include "wserver_messages.h"
 #include "wserver_messages_network.h"
 
@@ -31,6 +33,14 @@
     hton_type(&tosend, type);\
     return sendfull(sock_fd, &tosend, sizeof(type), 0, MSG_NOSIGNAL);
 
+#define align_encode_msg(buf, elem, elemtype, typeint) \
+    elemtype toencode; \
+    memcpy(&toencode, elem, sizeof(elemtype)); \
+    toencode.base.type = typeint; \
+    hton_type(&toencode, elemtype); \
+    memcpy(buf, &toencode, sizeof(elemtype)); \
+    return sizeof(elemtype);
+
 #define align_recv_msg(sock_fd, elem, elemtype, typeint) \
     int ret; \
     ret = recvfull(sock_fd, elem, sizeof(elemtype) - sizeof(wserver_msg), sizeof(wserver_msg), 0); \
@@ -43,6 +53,10 @@ int send_snr_update_request(int sock, const snr_update_request *elem) {
     align_send_msg(sock, elem, snr_update_request, WSERVER_SNR_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_snr_update_response(void *buf, const snr_update_response *elem) {
+    align_encode_msg(buf, elem, snr_update_response, WSERVER_SNR_UPDATE_RESPONSE_TYPE)
+}
+
 int send_snr_update_response(int sock, const snr_update_response *elem) {
     align_send_msg(sock, elem, snr_update_response, WSERVER_SNR_UPDATE_RESPONSE_TYPE)
 }
@@ -51,6 +65,10 @@ int send_position_update_request(int sock, const position_update_request *elem)
     align_send_msg(sock, elem, position_update_request, WSERVER_POSITION_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_position_update_response(void *buf, const position_update_response *elem) {
+    align_encode_msg(buf, elem, position_update_response, WSERVER_POSITION_UPDATE_RESPONSE_TYPE)
+}
+
 int send_position_update_response(int sock, const position_update_response *elem) {
     align_send_msg(sock, elem, position_update_response, WSERVER_POSITION_UPDATE_RESPONSE_TYPE)
 }
@@ -59,6 +77,10 @@ int send_txpower_update_request(int sock, const txpower_update_request *elem) {
     align_send_msg(sock, elem, txpower_update_request, WSERVER_TXPOWER_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_txpower_update_response(void *buf, const txpower_update_response *elem) {
+    align_encode_msg(buf, elem, txpower_update_response, WSERVER_TXPOWER_UPDATE_RESPONSE_TYPE)
+}
+
 int send_txpower_update_response(int sock, const txpower_update_response *elem) {
     align_send_msg(sock, elem, txpower_update_response, WSERVER_TXPOWER_UPDATE_RESPONSE_TYPE)
 }
@@ -67,6 +89,10 @@ int send_gaussian_random_update_request(int sock, const gaussian_random_update_r
     align_send_msg(sock, elem, gaussian_random_update_request, WSERVER_GAUSSIAN_RANDOM_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_gaussian_random_update_response(void *buf, const gaussian_random_update_response *elem) {
+    align_encode_msg(buf, elem, gaussian_random_update_response, WSERVER_GAUSSIAN_RANDOM_UPDATE_RESPONSE_TYPE)
+}
+
 int send_gaussian_random_update_response(int sock, const gaussian_random_update_response *elem) {
     align_send_msg(sock, elem, gaussian_random_update_response, WSERVER_GAUSSIAN_RANDOM_UPDATE_RESPONSE_TYPE)
 }
@@ -75,6 +101,10 @@ int send_gain_update_request(int sock, const gain_update_request *elem) {
     align_send_msg(sock, elem, gain_update_request, WSERVER_GAIN_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_gain_update_response(void *buf, const gain_update_response *elem) {
+    align_encode_msg(buf, elem, gain_update_response, WSERVER_GAIN_UPDATE_RESPONSE_TYPE)
+}
+
 int send_gain_update_response(int sock, const gain_update_response *elem) {
     align_send_msg(sock, elem, gain_update_response, WSERVER_GAIN_UPDATE_RESPONSE_TYPE)
 }
@@ -83,6 +113,10 @@ int send_errprob_update_request(int sock, const errprob_update_request *elem) {
     align_send_msg(sock, elem, errprob_update_request, WSERVER_ERRPROB_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_errprob_update_response(void *buf, const errprob_update_response *elem) {
+    align_encode_msg(buf, elem, errprob_update_response, WSERVER_ERRPROB_UPDATE_RESPONSE_TYPE)
+}
+
 int send_errprob_update_response(int sock, const errprob_update_response *elem) {
     align_send_msg(sock, elem, errprob_update_response, WSERVER_ERRPROB_UPDATE_RESPONSE_TYPE)
 }
@@ -91,6 +125,10 @@ int send_specprob_update_request(int sock, const specprob_update_request *elem)
     align_send_msg(sock, elem, specprob_update_request, WSERVER_SPECPROB_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_specprob_update_response(void *buf, const specprob_update_response *elem) {
+    align_encode_msg(buf, elem, specprob_update_response, WSERVER_SPECPROB_UPDATE_RESPONSE_TYPE)
+}
+
 int send_specprob_update_response(int sock, const specprob_update_response *elem) {
     align_send_msg(sock, elem, specprob_update_response, WSERVER_SPECPROB_UPDATE_RESPONSE_TYPE)
 }
@@ -99,6 +137,10 @@ int send_station_del_by_mac_request(int sock, const station_del_by_mac_request *
     align_send_msg(sock, elem, station_del_by_mac_request, WSERVER_DEL_BY_MAC_REQUEST_TYPE)
 }
 
+size_t encode_station_del_by_mac_response(void *buf, const station_del_by_mac_response *elem) {
+    align_encode_msg(buf, elem, station_del_by_mac_response, WSERVER_DEL_BY_MAC_RESPONSE_TYPE)
+}
+
 int send_station_del_by_mac_response(int sock, const station_del_by_mac_response *elem) {
     align_send_msg(sock, elem, station_del_by_mac_response, WSERVER_DEL_BY_MAC_RESPONSE_TYPE)
 }
@@ -107,6 +149,10 @@ int send_station_del_by_id_request(int sock, const station_del_by_id_request *el
     align_send_msg(sock, elem, station_del_by_id_request, WSERVER_DEL_BY_ID_REQUEST_TYPE)
 }
 
+size_t encode_station_del_by_id_response(void *buf, const station_del_by_id_response *elem) {
+    align_encode_msg(buf, elem, station_del_by_id_response, WSERVER_DEL_BY_ID_RESPONSE_TYPE)
+}
+
 int send_station_del_by_id_response(int sock, const station_del_by_id_response *elem) {
     align_send_msg(sock, elem, station_del_by_id_response, WSERVER_DEL_BY_ID_RESPONSE_TYPE)
 }
@@ -115,6 +161,10 @@ int send_station_add_request(int sock, const station_add_request *elem) {
     align_send_msg(sock, elem, station_add_request, WSERVER_ADD_REQUEST_TYPE)
 }
 
+size_t encode_station_add_response(void *buf, const station_add_response *elem) {
+    align_encode_msg(buf, elem, station_add_response, WSERVER_ADD_RESPONSE_TYPE)
+}
+
 int send_station_add_response(int sock, const station_add_response *elem) {
     align_send_msg(sock, elem, station_add_response, WSERVER_ADD_RESPONSE_TYPE)
 }
@@ -123,8 +173,12 @@ int send_medium_update_request(int sock, const medium_update_request *elem) {
     align_send_msg(sock, elem, medium_update_request , WSERVER_MEDIUM_UPDATE_REQUEST_TYPE)
 }
 
+size_t encode_medium_update_response(void *buf, const medium_update_response *elem) {
+    align_encode_msg(buf, elem, medium_update_response, WSERVER_MEDIUM_UPDATE_RESPONSE_TYPE)
+}
+
 int send_medium_update_response(int sock, const medium_update_response *elem) {
-    align_send_msg(sock, elem, medium_update_response , WSERVER_MEDIUM_UPDATE_RESPONSE_TYPE)
+    align_send_msg(sock, elem, medium_update_response, WSERVER_MEDIUM_UPDATE_RESPONSE_TYPE)
 }
 
 int recv_snr_update_request(int sock, snr_update_request *elem) {
@@ -215,6 +269,245 @@ int recv_medium_update_response(int sock, medium_update_response *elem) {
     align_recv_msg(sock, elem, medium_update_response , WSERVER_MEDIUM_UPDATE_RESPONSE_TYPE)
 }
 
+/*
+ * A bulk message with room for count entries of entry_size after the header.
+ * Bulk and link batch messages share the header layout of station_bulk_request.
+ */
+static void *bulk_msg_alloc(u8 type, size_t entry_size, u32 count) {
+    station_bulk_request *msg;
+
+    msg = malloc(sizeof(*msg) + entry_size * count);
+    if (msg) {
+        msg->base.type = type;
+        msg->count = count;
+        hton_station_bulk_request(msg);
+    }
+    return msg;
+}
+
+/* Write the header of a bulk message to buf, the count entries go after it */
+static void *bulk_msg_encode(void *buf, u8 type, u32 count) {
+    station_bulk_request header;
+
+    header.base.type = type;
+    header.count = count;
+    hton_station_bulk_request(&header);
+    memcpy(buf, &header, sizeof(header));
+    return (u8 *) buf + sizeof(header);
+}
+
+/* Send header and entries in one go, so a bulk message costs one round trip */
+static int bulk_msg_send(int sock, void *msg, size_t entry_size, u32 count) {
+    int ret = sendfull(sock, msg, sizeof(station_bulk_request) + entry_size * count, 0, MSG_NOSIGNAL);
+    free(msg);
+    return ret;
+}
+
+static int bulk_msg_recv(int sock, station_bulk_request *elem, size_t entry_size, u32 max, void **entries) {
+    int ret = recvfull(sock, elem, sizeof(*elem) - sizeof(wserver_msg), sizeof(wserver_msg), 0);
+    if (ret) {
+        return ret;
+    }
+    ntoh_station_bulk_request(elem);
+    if (elem->count > max) {
+        return -EMSGSIZE;
+    }
+    *entries = malloc(entry_size * (elem->count ? elem->count : 1));
+    if (!*entries) {
+        return -ENOMEM;
+    }
+    ret = recvfull(sock, *entries, entry_size * elem->count, 0, 0);
+    if (ret) {
+        free(*entries);
+        *entries = NULL;
+    }
+    return ret;
+}
+
+int send_station_bulk_request(int sock, u8 type, const u8 (*addrs)[ETH_ALEN], u32 count) {
+    if (count > WSERVER_BULK_MAX_STATIONS) {
+        return -EMSGSIZE;
+    }
+    station_bulk_request *msg = bulk_msg_alloc(type, ETH_ALEN, count);
+    if (!msg) {
+        return -ENOMEM;
+    }
+    memcpy(msg + 1, addrs, ETH_ALEN * count);
+    return bulk_msg_send(sock, msg, ETH_ALEN, count);
+}
+
+int recv_station_bulk_request(int sock, station_bulk_request *elem, u8 (**addrs)[ETH_ALEN]) {
+    return bulk_msg_recv(sock, elem, ETH_ALEN, WSERVER_BULK_MAX_STATIONS, (void **) addrs);
+}
+
+size_t encode_station_bulk_add_response(void *buf, const station_bulk_add_entry *entries, u32 count) {
+    station_bulk_add_entry *toencode = bulk_msg_encode(buf, WSERVER_BULK_ADD_RESPONSE_TYPE, count);
+    memcpy(toencode, entries, sizeof(*entries) * count);
+    for (u32 i = 0; i < count; i++) {
+        hton_station_bulk_add_entry(&toencode[i]);
+    }
+    return sizeof(station_bulk_response) + sizeof(*entries) * count;
+}
+
+int send_station_bulk_add_response(int sock, const station_bulk_add_entry *entries, u32 count) {
+    if (count > WSERVER_BULK_MAX_STATIONS) {
+        return -EMSGSIZE;
+    }
+    void *msg = malloc(sizeof(station_bulk_response) + sizeof(*entries) * count);
+    if (!msg) {
+        return -ENOMEM;
+    }
+    encode_station_bulk_add_response(msg, entries, count);
+    return bulk_msg_send(sock, msg, sizeof(*entries), count);
+}
+
+size_t encode_station_bulk_del_response(void *buf, const station_bulk_del_entry *entries, u32 count) {
+    station_bulk_del_entry *toencode = bulk_msg_encode(buf, WSERVER_BULK_DEL_RESPONSE_TYPE, count);
+    memcpy(toencode, entries, sizeof(*entries) * count);
+    for (u32 i = 0; i < count; i++) {
+        hton_station_bulk_del_entry(&toencode[i]);
+    }
+    return sizeof(station_bulk_response) + sizeof(*entries) * count;
+}
+
+int send_station_bulk_del_response(int sock, const station_bulk_del_entry *entries, u32 count) {
+    if (count > WSERVER_BULK_MAX_STATIONS) {
+        return -EMSGSIZE;
+    }
+    void *msg = malloc(sizeof(station_bulk_response) + sizeof(*entries) * count);
+    if (!msg) {
+        return -ENOMEM;
+    }
+    encode_station_bulk_del_response(msg, entries, count);
+    return bulk_msg_send(sock, msg, sizeof(*entries), count);
+}
+
+int recv_station_bulk_add_response(int sock, station_bulk_response *elem, station_bulk_add_entry **entries) {
+    int ret = bulk_msg_recv(sock, (station_bulk_request *) elem, sizeof(**entries), WSERVER_BULK_MAX_STATIONS, (void **) entries);
+    if (ret) {
+        return ret;
+    }
+    for (u32 i = 0; i < elem->count; i++) {
+        ntoh_station_bulk_add_entry(&(*entries)[i]);
+    }
+    return 0;
+}
+
+int recv_station_bulk_del_response(int sock, station_bulk_response *elem, station_bulk_del_entry **entries) {
+    int ret = bulk_msg_recv(sock, (station_bulk_request *) elem, sizeof(**entries), WSERVER_BULK_MAX_STATIONS, (void **) entries);
+    if (ret) {
+        return ret;
+    }
+    for (u32 i = 0; i < elem->count; i++) {
+        ntoh_station_bulk_del_entry(&(*entries)[i]);
+    }
+    return 0;
+}
+
+int send_link_update_batch_request(int sock, const link_update_record *records, u32 count) {
+    if (count > WSERVER_LINK_BATCH_MAX_RECORDS) {
+        return -EMSGSIZE;
+    }
+    link_update_batch_request *msg = bulk_msg_alloc(WSERVER_LINK_BATCH_REQUEST_TYPE, sizeof(*records), count);
+    if (!msg) {
+        return -ENOMEM;
+    }
+    link_update_record *tosend = (link_update_record *) (msg + 1);
+    memcpy(tosend, records, sizeof(*records) * count);
+    for (u32 i = 0; i < count; i++) {
+        hton_link_update_record(&tosend[i]);
+    }
+    return bulk_msg_send(sock, msg, sizeof(*records), count);
+}
+
+int recv_link_update_batch_request(int sock, link_update_batch_request *elem, link_update_record **records) {
+    int ret = bulk_msg_recv(sock, (station_bulk_request *) elem, sizeof(**records),
+                            WSERVER_LINK_BATCH_MAX_RECORDS, (void **) records);
+    if (ret) {
+        return ret;
+    }
+    for (u32 i = 0; i < elem->count; i++) {
+        ntoh_link_update_record(&(*records)[i]);
+    }
+    return 0;
+}
+
+size_t encode_link_update_batch_response(void *buf, const link_update_batch_response *elem) {
+    align_encode_msg(buf, elem, link_update_batch_response, WSERVER_LINK_BATCH_RESPONSE_TYPE)
+}
+
+int send_link_update_batch_response(int sock, const link_update_batch_response *elem) {
+    align_send_msg(sock, elem, link_update_batch_response, WSERVER_LINK_BATCH_RESPONSE_TYPE)
+}
+
+int recv_link_update_batch_response(int sock, link_update_batch_response *elem) {
+    align_recv_msg(sock, elem, link_update_batch_response, WSERVER_LINK_BATCH_RESPONSE_TYPE)
+}
+
+int send_async_mode_request(int sock, const async_mode_request *elem) {
+    align_send_msg(sock, elem, async_mode_request, WSERVER_ASYNC_MODE_REQUEST_TYPE)
+}
+
+size_t encode_async_mode_response(void *buf, const async_mode_response *elem) {
+    align_encode_msg(buf, elem, async_mode_response, WSERVER_ASYNC_MODE_RESPONSE_TYPE)
+}
+
+int send_async_mode_response(int sock, const async_mode_response *elem) {
+    align_send_msg(sock, elem, async_mode_response, WSERVER_ASYNC_MODE_RESPONSE_TYPE)
+}
+
+size_t encode_async_ack(void *buf, const async_ack *elem) {
+    align_encode_msg(buf, elem, async_ack, WSERVER_ASYNC_ACK_TYPE)
+}
+
+int send_async_ack(int sock, const async_ack *elem) {
+    align_send_msg(sock, elem, async_ack, WSERVER_ASYNC_ACK_TYPE)
+}
+
+size_t encode_async_error(void *buf, const async_error *elem) {
+    align_encode_msg(buf, elem, async_error, WSERVER_ASYNC_ERROR_TYPE)
+}
+
+int send_async_error(int sock, const async_error *elem) {
+    align_send_msg(sock, elem, async_error, WSERVER_ASYNC_ERROR_TYPE)
+}
+
+int recv_async_mode_request(int sock, async_mode_request *elem) {
+    align_recv_msg(sock, elem, async_mode_request, WSERVER_ASYNC_MODE_REQUEST_TYPE)
+}
+
+int recv_async_mode_response(int sock, async_mode_response *elem) {
+    align_recv_msg(sock, elem, async_mode_response, WSERVER_ASYNC_MODE_RESPONSE_TYPE)
+}
+
+int recv_async_ack(int sock, async_ack *elem) {
+    align_recv_msg(sock, elem, async_ack, WSERVER_ASYNC_ACK_TYPE)
+}
+
+int recv_async_error(int sock, async_error *elem) {
+    align_recv_msg(sock, elem, async_error, WSERVER_ASYNC_ERROR_TYPE)
+}
+
+int send_latency_request(int sock, const latency_request *elem) {
+    align_send_msg(sock, elem, latency_request, WSERVER_LATENCY_REQUEST_TYPE)
+}
+
+size_t encode_latency_response(void *buf, const latency_response *elem) {
+    align_encode_msg(buf, elem, latency_response, WSERVER_LATENCY_RESPONSE_TYPE)
+}
+
+int send_latency_response(int sock, const latency_response *elem) {
+    align_send_msg(sock, elem, latency_response, WSERVER_LATENCY_RESPONSE_TYPE)
+}
+
+int recv_latency_request(int sock, latency_request *elem) {
+    align_recv_msg(sock, elem, latency_request, WSERVER_LATENCY_REQUEST_TYPE)
+}
+
+int recv_latency_response(int sock, latency_response *elem) {
+    align_recv_msg(sock, elem, latency_response, WSERVER_LATENCY_RESPONSE_TYPE)
+}
+
 int wserver_recv_msg_base(int sock_fd, wserver_msg *base, int *recv_type) {
     int ret = recvfull(sock_fd, base, sizeof(wserver_msg), 0, 0);
     if (ret) {
@@ -262,15 +555,89 @@ ssize_t get_msg_size_by_type(int type) {
 			return sizeof(gain_update_request);
 		case WSERVER_GAIN_UPDATE_RESPONSE_TYPE:
 			return sizeof(gain_update_response);
+        case WSERVER_SPECPROB_UPDATE_REQUEST_TYPE:
+            return sizeof(specprob_update_request);
+        case WSERVER_SPECPROB_UPDATE_RESPONSE_TYPE:
+            return sizeof(specprob_update_response);
+        case WSERVER_GAUSSIAN_RANDOM_UPDATE_REQUEST_TYPE:
+            return sizeof(gaussian_random_update_request);
+        case WSERVER_GAUSSIAN_RANDOM_UPDATE_RESPONSE_TYPE:
+            return sizeof(gaussian_random_update_response);
         case WSERVER_MEDIUM_UPDATE_REQUEST_TYPE:
             return sizeof(medium_update_request);
         case WSERVER_MEDIUM_UPDATE_RESPONSE_TYPE:
             return sizeof(medium_update_response);
+        case WSERVER_BULK_ADD_REQUEST_TYPE:
+        case WSERVER_BULK_DEL_REQUEST_TYPE:
+            return sizeof(station_bulk_request);
+        case WSERVER_BULK_ADD_RESPONSE_TYPE:
+        case WSERVER_BULK_DEL_RESPONSE_TYPE:
+            return sizeof(station_bulk_response);
+        case WSERVER_LINK_BATCH_REQUEST_TYPE:
+            return sizeof(link_update_batch_request);
+        case WSERVER_LINK_BATCH_RESPONSE_TYPE:
+            return sizeof(link_update_batch_response);
+        case WSERVER_ASYNC_MODE_REQUEST_TYPE:
+            return sizeof(async_mode_request);
+        case WSERVER_ASYNC_MODE_RESPONSE_TYPE:
+            return sizeof(async_mode_response);
+        case WSERVER_ASYNC_ACK_TYPE:
+            return sizeof(async_ack);
+        case WSERVER_ASYNC_ERROR_TYPE:
+            return sizeof(async_error);
+        case WSERVER_LATENCY_REQUEST_TYPE:
+            return sizeof(latency_request);
+        case WSERVER_LATENCY_RESPONSE_TYPE:
+            return sizeof(latency_response);
         default:
             return -1;
     }
 }
 
+ssize_t wserver_msg_len(const void *buf, size_t len) {
+    station_bulk_request header;
+    size_t entry_size;
+    u32 max;
+
+    if (len < sizeof(wserver_msg)) {
+        return 0;
+    }
+    memcpy(&header.base, buf, sizeof(wserver_msg));
+    ntoh_base(&header.base);
+    ssize_t size = get_msg_size_by_type(header.base.type);
+    switch (header.base.type) {
+        case WSERVER_BULK_ADD_REQUEST_TYPE:
+        case WSERVER_BULK_DEL_REQUEST_TYPE:
+            entry_size = ETH_ALEN;
+            max = WSERVER_BULK_MAX_STATIONS;
+            break;
+        case WSERVER_BULK_ADD_RESPONSE_TYPE:
+            entry_size = sizeof(station_bulk_add_entry);
+            max = WSERVER_BULK_MAX_STATIONS;
+            break;
+        case WSERVER_BULK_DEL_RESPONSE_TYPE:
+            entry_size = sizeof(station_bulk_del_entry);
+            max = WSERVER_BULK_MAX_STATIONS;
+            break;
+        case WSERVER_LINK_BATCH_REQUEST_TYPE:
+            entry_size = sizeof(link_update_record);
+            max = WSERVER_LINK_BATCH_MAX_RECORDS;
+            break;
+        default:
+            return size;
+    }
+    if (len < sizeof(header)) {
+        return 0;
+    }
+    // every bulk header is laid out like a station_bulk_request
+    memcpy(&header, buf, sizeof(header));
+    ntoh_station_bulk_request(&header);
+    if (header.count > max) {
+        return -1;
+    }
+    return sizeof(header) + entry_size * header.count;
+}
+
 double custom_fixed_point_to_floating_point(u32 fixed_point) {
     u32 SHIFT_AMOUNT = 31;
     u32 SHIFT_MASK = 0x7fffffff; // ((1 << SHIFT_AMOUNT) - 1)
@@ -34,6 +34,7 @@
 #define WUPDATE_INTF_NOTFOUND 1 /* unknown interface */
 #define WUPDATE_INTF_DUPLICATE 2 /* interface already exists */
 #define WUPDATE_WRONG_MODE 3 /* tried to update snr in errprob mode or vice versa */
+#define WUPDATE_INVALID 4 /* malformed update, e.g. unknown link batch record */
 
 /* Socket location following FHS guidelines:
  * http://www.pathname.com/fhs/pub/fhs-2.3.html#PURPOSE46 */
@@ -64,12 +65,45 @@
 #define WSERVER_GAUSSIAN_RANDOM_UPDATE_RESPONSE_TYPE 22
 #define WSERVER_MEDIUM_UPDATE_REQUEST_TYPE 23
 #define WSERVER_MEDIUM_UPDATE_RESPONSE_TYPE 24
+#define WSERVER_BULK_ADD_REQUEST_TYPE 25
+#define WSERVER_BULK_ADD_RESPONSE_TYPE 26
+#define WSERVER_BULK_DEL_REQUEST_TYPE 27
+#define WSERVER_BULK_DEL_RESPONSE_TYPE 28
+#define WSERVER_LINK_BATCH_REQUEST_TYPE 29
+#define WSERVER_LINK_BATCH_RESPONSE_TYPE 30
+#define WSERVER_ASYNC_MODE_REQUEST_TYPE 31
+#define WSERVER_ASYNC_MODE_RESPONSE_TYPE 32
+#define WSERVER_ASYNC_ACK_TYPE 33
+#define WSERVER_ASYNC_ERROR_TYPE 34
+#define WSERVER_LATENCY_REQUEST_TYPE 35
+#define WSERVER_LATENCY_RESPONSE_TYPE 36
+
+#define WLINK_SNR 0 /* snr of from_addr <-> to_addr */
+#define WLINK_ERRPROB 1 /* errprob of from_addr <-> to_addr */
+#define WLINK_POSITION 2 /* position of from_addr */
 
 #define SPECIFIC_MATRIX_MAX_SIZE_IDX (12)
 #define SPECIFIC_MATRIX_MAX_RATE_IDX (12)
 
 #define MULTIMEDIUM_MAX_STATION_NUMBER 250
 
+/* Most stations a single bulk add or delete request may carry */
+#define WSERVER_BULK_MAX_STATIONS 4096
+
+/* Most records a single link batch request may carry */
+#define WSERVER_LINK_BATCH_MAX_RECORDS 65536
+
+/* Requests between cumulative acks in async mode, unless negotiated */
+#define WSERVER_ASYNC_ACK_INTERVAL 64
+
+/* Stages of a latency_response, see latency.h */
+#define WLAT_INGEST 0 /* frame received until queued */
+#define WLAT_LATENESS 1 /* frame expiry until delivered */
+#define WLAT_DELIVERY 2 /* delivery time per receiver */
+#define WLAT_SNR_LOCK 3 /* wait for snr_lock on the data path */
+#define WLAT_SNR_LOCK_CONTROL 4 /* wait for snr_lock elsewhere */
+#define WLAT_STAGES 5
+
 #ifndef __packed
 #define __packed __attribute__((packed))
 #endif
@@ -78,6 +112,7 @@ typedef uint8_t u8;
 typedef int32_t i32;
 typedef float f32;
 typedef uint32_t u32;
+typedef uint64_t u64;
 
 /*
  * Macro for unused parameters
@@ -238,6 +273,123 @@ typedef struct __packed {
     u8 update_result;
 } medium_update_response;
 
+/*
+ * Bulk requests and responses are a fixed header followed by count
+ * entries: MAC addresses in requests, station_bulk_add_entry or
+ * station_bulk_del_entry in responses, in the order of the request.
+ */
+typedef struct __packed {
+    wserver_msg base;
+    u32 count;
+} station_bulk_request;
+
+typedef struct __packed {
+    wserver_msg base;
+    u32 count;
+} station_bulk_response;
+
+typedef struct __packed {
+    u8 addr[ETH_ALEN];
+    i32 created_id;
+    u8 update_result;
+} station_bulk_add_entry;
+
+typedef struct __packed {
+    u8 addr[ETH_ALEN];
+    u8 update_result;
+} station_bulk_del_entry;
+
+/*
+ * A link batch request is a fixed header followed by count records, applied
+ * in order and answered by one link_update_batch_response.
+ */
+typedef struct __packed {
+    wserver_msg base;
+    u32 count;
+} link_update_batch_request;
+
+typedef struct __packed {
+    u8 kind; /* WLINK_* */
+    u8 from_addr[ETH_ALEN];
+    u8 to_addr[ETH_ALEN]; /* unused for WLINK_POSITION */
+    union __packed {
+        i32 snr;
+        u32 errprob;
+        f32 pos[3];
+        u32 raw[3];
+    } value;
+} link_update_record;
+
+typedef struct __packed {
+    wserver_msg base;
+    u32 count;
+    u32 applied;
+    u32 not_found; /* a station was unknown */
+    u32 wrong_mode; /* the record does not apply in this mode */
+    u32 invalid; /* unknown kind */
+} link_update_batch_response;
+
+/*
+ * Async mode: after a successful async_mode_request with enable set, the
+ * requests on the connection are numbered first_seq, first_seq + 1, ... in
+ * the order they are sent.  Update requests get no response; the server
+ * sends an async_ack for every ack_interval requests and whenever it has
+ * read all it was sent, and an async_error for each failed update.
+ * Requests answering with data (station add, bulk add and delete) still
+ * get their response.  A request with enable unset acks everything and
+ * returns to one response per request.
+ */
+typedef struct __packed {
+    wserver_msg base;
+    u8 enable;
+    u32 first_seq;
+    u32 ack_interval; /* 0 for WSERVER_ASYNC_ACK_INTERVAL */
+} async_mode_request;
+
+typedef struct __packed {
+    wserver_msg base;
+    async_mode_request request;
+    u8 update_result;
+} async_mode_response;
+
+typedef struct __packed {
+    wserver_msg base;
+    u32 seq; /* every request up to seq has been applied */
+} async_ack;
+
+typedef struct __packed {
+    wserver_msg base;
+    u32 seq;
+    u8 request_type; /* WSERVER_*_REQUEST_TYPE of the failed request */
+    u8 update_result; /* WUPDATE_* */
+} async_error;
+
+/*
+ * Latency histograms of the frame pipeline, summed over the shards since
+ * the start or the last request with reset set, which clears them after
+ * the response is taken.  Durations are in ns.
+ */
+typedef struct __packed {
+    wserver_msg base;
+    u8 reset;
+} latency_request;
+
+typedef struct __packed {
+    u64 count;
+    u64 mean_ns;
+    u64 p50_ns;
+    u64 p90_ns;
+    u64 p99_ns;
+    u64 p999_ns;
+    u64 max_ns;
+} latency_stage;
+
+typedef struct __packed {
+    wserver_msg base;
+    latency_request request;
+    latency_stage stages[WLAT_STAGES]; /* indexed by WLAT_* */
+} latency_response;
+
 /**
  * Receive the wserver_msg from a socket
  * @param sock_fd The socket file descriptor
@@ -257,6 +409,39 @@ int wserver_recv_msg_base(int sock_fd, wserver_msg *base, int *recv_type);
 #define wserver_send_msg(sock_fd, elem, type) \
     send_##type(sock_fd, elem)
 
+/**
+ * Send a bulk wserver response to a socket
+ * @param sock_fd The socket file descriptor
+ * @param entries The entries of the response
+ * @param count The number of entries
+ * @param type The response type struct
+ * @return 0 on success
+ */
+#define wserver_send_msg_bulk(sock_fd, entries, count, type) \
+    send_##type(sock_fd, entries, count)
+
+/**
+ * Convert a wserver response to network byte order into a buffer
+ * @param buf Where to store the response, with room for a type
+ * @param elem The response to convert
+ * @param type The response type struct
+ * @return The size of the response
+ */
+#define wserver_encode_msg(buf, elem, type) \
+    encode_##type(buf, elem)
+
+/**
+ * Convert a bulk wserver response to network byte order into a buffer
+ * @param buf Where to store the response, with room for the header and
+ * count entries
+ * @param entries The entries of the response
+ * @param count The number of entries
+ * @param type The response type struct
+ * @return The size of the response
+ */
+#define wserver_encode_msg_bulk(buf, entries, count, type) \
+    encode_##type(buf, entries, count)
+
 /**
  * Receive a wserver msg from a socket
  * @param sock_fd The socket file descriptor
@@ -270,30 +455,49 @@ int wserver_recv_msg_base(int sock_fd, wserver_msg *base, int *recv_type);
 /**
  * Get the size of a request/response based on its type
  * @param type The WSERVER_*_TYPE
- * @return The size or -1 if not found
+ * @return The size (of the header for bulk messages) or -1 if not found
  */
 ssize_t get_msg_size_by_type(int type);
 
+/**
+ * Get the size of the message starting at buf, bulk entries included
+ * @param buf The start of the message
+ * @param len The amount of bytes at buf
+ * @return The size, 0 if len is too short to tell or -1 if the type is
+ * unknown or the message too large
+ */
+ssize_t wserver_msg_len(const void *buf, size_t len);
+
 int send_snr_update_request(int sock, const snr_update_request *elem);
 
 int send_snr_update_response(int sock, const snr_update_response *elem);
 
+size_t encode_snr_update_response(void *buf, const snr_update_response *elem);
+
 int send_position_update_request(int sock, const position_update_request *elem);
 
 int send_position_update_response(int sock, const position_update_response *elem);
 
+size_t encode_position_update_response(void *buf, const position_update_response *elem);
+
 int send_txpower_update_request(int sock, const txpower_update_request *elem);
 
 int send_txpower_update_response(int sock, const txpower_update_response *elem);
 
+size_t encode_txpower_update_response(void *buf, const txpower_update_response *elem);
+
 int send_gaussian_random_update_request(int sock, const gaussian_random_update_request *elem);
 
 int send_gaussian_random_update_response(int sock, const gaussian_random_update_response *elem);
 
+size_t encode_gaussian_random_update_response(void *buf, const gaussian_random_update_response *elem);
+
 int send_gain_update_request(int sock, const gain_update_request *elem);
 
 int send_gain_update_response(int sock, const gain_update_response *elem);
 
+size_t encode_gain_update_response(void *buf, const gain_update_response *elem);
+
 int send_height_update_request(int sock, const height_update_request *elem);
 
 int send_height_update_response(int sock, const height_update_response *elem);
@@ -302,26 +506,38 @@ int send_errprob_update_request(int sock, const errprob_update_request *elem);
 
 int send_errprob_update_response(int sock, const errprob_update_response *elem);
 
+size_t encode_errprob_update_response(void *buf, const errprob_update_response *elem);
+
 int send_specprob_update_request(int sock, const specprob_update_request *elem);
 
 int send_specprob_update_response(int sock, const specprob_update_response *elem);
 
+size_t encode_specprob_update_response(void *buf, const specprob_update_response *elem);
+
 int send_station_del_by_mac_request(int sock, const station_del_by_mac_request *elem);
 
 int send_station_del_by_mac_response(int sock, const station_del_by_mac_response *elem);
 
+size_t encode_station_del_by_mac_response(void *buf, const station_del_by_mac_response *elem);
+
 int send_station_del_by_id_request(int sock, const station_del_by_id_request *elem);
 
 int send_station_del_by_id_response(int sock, const station_del_by_id_response *elem);
 
+size_t encode_station_del_by_id_response(void *buf, const station_del_by_id_response *elem);
+
 int send_station_add_request(int sock, const station_add_request *elem);
 
 int send_station_add_response(int sock, const station_add_response *elem);
 
+size_t encode_station_add_response(void *buf, const station_add_response *elem);
+
 int send_medium_update_request(int sock, const medium_update_request *elem);
 
 int send_medium_update_response(int sock, const medium_update_response *elem);
 
+size_t encode_medium_update_response(void *buf, const medium_update_response *elem);
+
 int recv_snr_update_request(int sock, snr_update_request *elem);
 
 int recv_snr_update_response(int sock, snr_update_response *elem);
@@ -370,6 +586,100 @@ int recv_medium_update_request(int sock, medium_update_request *elem);
 
 int recv_medium_update_response(int sock, medium_update_response *elem);
 
+/**
+ * Send a bulk add or delete request
+ * @param sock The socket file descriptor
+ * @param type WSERVER_BULK_ADD_REQUEST_TYPE or WSERVER_BULK_DEL_REQUEST_TYPE
+ * @param addrs The MAC addresses of the stations
+ * @param count The number of addresses, at most WSERVER_BULK_MAX_STATIONS
+ * @return 0 on success
+ */
+int send_station_bulk_request(int sock, u8 type, const u8 (*addrs)[ETH_ALEN], u32 count);
+
+/**
+ * Receive the rest of a bulk request after its wserver_msg
+ * @param sock The socket file descriptor
+ * @param elem Where to store the header
+ * @param addrs Where to store the addresses, to be freed by the caller
+ * @return A positive WACTION_* constant, or a negative errno value
+ */
+int recv_station_bulk_request(int sock, station_bulk_request *elem, u8 (**addrs)[ETH_ALEN]);
+
+int send_station_bulk_add_response(int sock, const station_bulk_add_entry *entries, u32 count);
+
+size_t encode_station_bulk_add_response(void *buf, const station_bulk_add_entry *entries, u32 count);
+
+int send_station_bulk_del_response(int sock, const station_bulk_del_entry *entries, u32 count);
+
+size_t encode_station_bulk_del_response(void *buf, const station_bulk_del_entry *entries, u32 count);
+
+/**
+ * Receive the rest of a bulk response after its wserver_msg
+ * @param sock The socket file descriptor
+ * @param elem Where to store the header
+ * @param entries Where to store the entries, to be freed by the caller
+ * @return A positive WACTION_* constant, or a negative errno value
+ */
+int recv_station_bulk_add_response(int sock, station_bulk_response *elem, station_bulk_add_entry **entries);
+
+int recv_station_bulk_del_response(int sock, station_bulk_response *elem, station_bulk_del_entry **entries);
+
+/**
+ * Send a link batch request
+ * @param sock The socket file descriptor
+ * @param records The records to apply
+ * @param count The number of records, at most WSERVER_LINK_BATCH_MAX_RECORDS
+ * @return 0 on success
+ */
+int send_link_update_batch_request(int sock, const link_update_record *records, u32 count);
+
+/**
+ * Receive the rest of a link batch request after its wserver_msg
+ * @param sock The socket file descriptor
+ * @param elem Where to store the header
+ * @param records Where to store the records, to be freed by the caller
+ * @return A positive WACTION_* constant, or a negative errno value
+ */
+int recv_link_update_batch_request(int sock, link_update_batch_request *elem, link_update_record **records);
+
+int send_link_update_batch_response(int sock, const link_update_batch_response *elem);
+
+size_t encode_link_update_batch_response(void *buf, const link_update_batch_response *elem);
+
+int recv_link_update_batch_response(int sock, link_update_batch_response *elem);
+
+int send_async_mode_request(int sock, const async_mode_request *elem);
+
+int send_async_mode_response(int sock, const async_mode_response *elem);
+
+size_t encode_async_mode_response(void *buf, const async_mode_response *elem);
+
+int send_async_ack(int sock, const async_ack *elem);
+
+size_t encode_async_ack(void *buf, const async_ack *elem);
+
+int send_async_error(int sock, const async_error *elem);
+
+size_t encode_async_error(void *buf, const async_error *elem);
+
+int recv_async_mode_request(int sock, async_mode_request *elem);
+
+int recv_async_mode_response(int sock, async_mode_response *elem);
+
+int recv_async_ack(int sock, async_ack *elem);
+
+int recv_async_error(int sock, async_error *elem);
+
+int send_latency_request(int sock, const latency_request *elem);
+
+int send_latency_response(int sock, const latency_response *elem);
+
+size_t encode_latency_response(void *buf, const latency_response *elem);
+
+int recv_latency_request(int sock, latency_request *elem);
+
+int recv_latency_response(int sock, latency_response *elem);
+
 double custom_fixed_point_to_floating_point(u32 fixed_point);
 
 u32 custom_floating_point_to_fixed_point(double floating_point);
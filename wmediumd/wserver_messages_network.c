@@ -19,6 +19,7 @@
  */
 
 #include <netinet/in.h>
+#include <endian.h>
 #include <errno.h>
 #include "wserver_messages_network.h"
 
@@ -195,6 +196,89 @@ void hton_medium_update_response(medium_update_response *elem) {
     hton_medium_update_request(&elem->request);
 }
 
+void hton_station_bulk_request(station_bulk_request *elem) {
+    hton_base(&elem->base);
+    // no field of the packed bulk messages is aligned, so no pointer wrappers
+    elem->count = htonl(elem->count);
+}
+
+void hton_station_bulk_response(station_bulk_response *elem) {
+    hton_base(&elem->base);
+    elem->count = htonl(elem->count);
+}
+
+void hton_station_bulk_add_entry(station_bulk_add_entry *elem) {
+    elem->created_id = htonl(elem->created_id);
+}
+
+void hton_station_bulk_del_entry(station_bulk_del_entry *elem) {
+    UNUSED(elem);
+}
+
+void hton_link_update_batch_request(link_update_batch_request *elem) {
+    hton_base(&elem->base);
+    elem->count = htonl(elem->count);
+}
+
+void hton_link_update_record(link_update_record *elem) {
+    // every value is 32 bits wide, floats travel like the other positions
+    for (int i = 0; i < 3; i++) {
+        elem->value.raw[i] = htonl(elem->value.raw[i]);
+    }
+}
+
+void hton_link_update_batch_response(link_update_batch_response *elem) {
+    hton_base(&elem->base);
+    elem->count = htonl(elem->count);
+    elem->applied = htonl(elem->applied);
+    elem->not_found = htonl(elem->not_found);
+    elem->wrong_mode = htonl(elem->wrong_mode);
+    elem->invalid = htonl(elem->invalid);
+}
+
+void hton_async_mode_request(async_mode_request *elem) {
+    hton_base(&elem->base);
+    elem->first_seq = htonl(elem->first_seq);
+    elem->ack_interval = htonl(elem->ack_interval);
+}
+
+void hton_async_mode_response(async_mode_response *elem) {
+    hton_base(&elem->base);
+    hton_async_mode_request(&elem->request);
+}
+
+void hton_async_ack(async_ack *elem) {
+    hton_base(&elem->base);
+    elem->seq = htonl(elem->seq);
+}
+
+void hton_async_error(async_error *elem) {
+    hton_base(&elem->base);
+    elem->seq = htonl(elem->seq);
+}
+
+void hton_latency_request(latency_request *elem) {
+    hton_base(&elem->base);
+}
+
+void hton_latency_stage(latency_stage *elem) {
+    elem->count = htobe64(elem->count);
+    elem->mean_ns = htobe64(elem->mean_ns);
+    elem->p50_ns = htobe64(elem->p50_ns);
+    elem->p90_ns = htobe64(elem->p90_ns);
+    elem->p99_ns = htobe64(elem->p99_ns);
+    elem->p999_ns = htobe64(elem->p999_ns);
+    elem->max_ns = htobe64(elem->max_ns);
+}
+
+void hton_latency_response(latency_response *elem) {
+    hton_base(&elem->base);
+    hton_latency_request(&elem->request);
+    for (int i = 0; i < WLAT_STAGES; i++) {
+        hton_latency_stage(&elem->stages[i]);
+    }
+}
+
 void ntoh_base(wserver_msg *elem) {
     UNUSED(elem);
 }
@@ -309,4 +393,85 @@ void ntoh_medium_update_request(medium_update_request *elem) {
 void ntoh_medium_update_response(medium_update_response *elem) {
     ntoh_base(&elem->base);
     ntoh_medium_update_request(&elem->request);
-}
\ No newline at end of file
+}
+
+void ntoh_station_bulk_request(station_bulk_request *elem) {
+    ntoh_base(&elem->base);
+    elem->count = ntohl(elem->count);
+}
+
+void ntoh_station_bulk_response(station_bulk_response *elem) {
+    ntoh_base(&elem->base);
+    elem->count = ntohl(elem->count);
+}
+
+void ntoh_station_bulk_add_entry(station_bulk_add_entry *elem) {
+    elem->created_id = ntohl(elem->created_id);
+}
+
+void ntoh_station_bulk_del_entry(station_bulk_del_entry *elem) {
+    UNUSED(elem);
+}
+
+void ntoh_link_update_batch_request(link_update_batch_request *elem) {
+    ntoh_base(&elem->base);
+    elem->count = ntohl(elem->count);
+}
+
+void ntoh_link_update_record(link_update_record *elem) {
+    for (int i = 0; i < 3; i++) {
+        elem->value.raw[i] = ntohl(elem->value.raw[i]);
+    }
+}
+
+void ntoh_link_update_batch_response(link_update_batch_response *elem) {
+    ntoh_base(&elem->base);
+    elem->count = ntohl(elem->count);
+    elem->applied = ntohl(elem->applied);
+    elem->not_found = ntohl(elem->not_found);
+    elem->wrong_mode = ntohl(elem->wrong_mode);
+    elem->invalid = ntohl(elem->invalid);
+}
+
+void ntoh_async_mode_request(async_mode_request *elem) {
+    ntoh_base(&elem->base);
+    elem->first_seq = ntohl(elem->first_seq);
+    elem->ack_interval = ntohl(elem->ack_interval);
+}
+
+void ntoh_async_mode_response(async_mode_response *elem) {
+    ntoh_base(&elem->base);
+    ntoh_async_mode_request(&elem->request);
+}
+
+void ntoh_async_ack(async_ack *elem) {
+    ntoh_base(&elem->base);
+    elem->seq = ntohl(elem->seq);
+}
+
+void ntoh_async_error(async_error *elem) {
+    ntoh_base(&elem->base);
+    elem->seq = ntohl(elem->seq);
+}
+
+void ntoh_latency_request(latency_request *elem) {
+    ntoh_base(&elem->base);
+}
+
+void ntoh_latency_stage(latency_stage *elem) {
+    elem->count = be64toh(elem->count);
+    elem->mean_ns = be64toh(elem->mean_ns);
+    elem->p50_ns = be64toh(elem->p50_ns);
+    elem->p90_ns = be64toh(elem->p90_ns);
+    elem->p99_ns = be64toh(elem->p99_ns);
+    elem->p999_ns = be64toh(elem->p999_ns);
+    elem->max_ns = be64toh(elem->max_ns);
+}
+
+void ntoh_latency_response(latency_response *elem) {
+    ntoh_base(&elem->base);
+    ntoh_latency_request(&elem->request);
+    for (int i = 0; i < WLAT_STAGES; i++) {
+        ntoh_latency_stage(&elem->stages[i]);
+    }
+}
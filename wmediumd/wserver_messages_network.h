@@ -21,6 +21,7 @@
 #ifndef WMEDIUMD_WSERVER_MESSAGES_NETWORK_H
 #define WMEDIUMD_WSERVER_MESSAGES_NETWORK_H
 
+#include <string.h>
 #include "wserver_messages.h"
 
 /**
@@ -61,6 +62,18 @@ int recvfull(int sock, void *buf, size_t len, size_t shift, int flags);
 #define ntoh_type(elem, type) \
     ntoh_##type(elem);
 
+/**
+ * Decode a wserver message received into a buffer
+ * @param buf The start of the message
+ * @param elem Where to store the msg
+ * @param type The struct type of the element
+ */
+#define wserver_decode_msg(buf, elem, type) \
+    do { \
+        memcpy(elem, buf, sizeof(type)); \
+        ntoh_type(elem, type); \
+    } while (0)
+
 void hton_base(wserver_msg *elem);
 
 void hton_snr_update_request(snr_update_request *elem);
@@ -107,6 +120,34 @@ void hton_medium_update_request(medium_update_request *elem);
 
 void hton_medium_update_response(medium_update_response *elem);
 
+void hton_station_bulk_request(station_bulk_request *elem);
+
+void hton_station_bulk_response(station_bulk_response *elem);
+
+void hton_station_bulk_add_entry(station_bulk_add_entry *elem);
+
+void hton_station_bulk_del_entry(station_bulk_del_entry *elem);
+
+void hton_link_update_batch_request(link_update_batch_request *elem);
+
+void hton_link_update_record(link_update_record *elem);
+
+void hton_link_update_batch_response(link_update_batch_response *elem);
+
+void hton_async_mode_request(async_mode_request *elem);
+
+void hton_async_mode_response(async_mode_response *elem);
+
+void hton_async_ack(async_ack *elem);
+
+void hton_async_error(async_error *elem);
+
+void hton_latency_request(latency_request *elem);
+
+void hton_latency_stage(latency_stage *elem);
+
+void hton_latency_response(latency_response *elem);
+
 void ntoh_base(wserver_msg *elem);
 
 void ntoh_snr_update_request(snr_update_request *elem);
@@ -153,4 +194,32 @@ void ntoh_medium_update_request(medium_update_request *elem);
 
 void ntoh_medium_update_response(medium_update_response *elem);
 
+void ntoh_station_bulk_request(station_bulk_request *elem);
+
+void ntoh_station_bulk_response(station_bulk_response *elem);
+
+void ntoh_station_bulk_add_entry(station_bulk_add_entry *elem);
+
+void ntoh_station_bulk_del_entry(station_bulk_del_entry *elem);
+
+void ntoh_link_update_batch_request(link_update_batch_request *elem);
+
+void ntoh_link_update_record(link_update_record *elem);
+
+void ntoh_link_update_batch_response(link_update_batch_response *elem);
+
+void ntoh_async_mode_request(async_mode_request *elem);
+
+void ntoh_async_mode_response(async_mode_response *elem);
+
+void ntoh_async_ack(async_ack *elem);
+
+void ntoh_async_error(async_error *elem);
+
+void ntoh_latency_request(latency_request *elem);
+
+void ntoh_latency_stage(latency_stage *elem);
+
+void ntoh_latency_response(latency_response *elem);
+
 #endif //WMEDIUMD_WSERVER_MESSAGES_NETWORK_H